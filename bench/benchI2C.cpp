@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <new>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+#include "images.h"
+
+// The I2C codec: encoding a code image into C2 records (with each segmentation strategy),
+// decoding the records back, walking them with the iterator, and finalising the image.
+//
+namespace {
+
+	typedef bench::Image (*ImageFunc)();
+
+	// Owns a Buffer for the duration of a benchmark.
+	//
+	struct ScopedBuffer {
+		Buffer buf;
+		explicit ScopedBuffer(size_t capacity) {
+			if ( bufInitialise(&buf, capacity, 0x00, NULL) != BUF_SUCCESS ) {
+				throw std::bad_alloc();
+			}
+		}
+		explicit ScopedBuffer(const std::vector<uint8> &contents) : ScopedBuffer(contents.size()) {
+			if ( bufAppendBlock(&buf, contents.data(), contents.size(), NULL) != BUF_SUCCESS ) {
+				throw std::bad_alloc();
+			}
+		}
+		~ScopedBuffer() {
+			bufDestroy(&buf);
+		}
+		ScopedBuffer(const ScopedBuffer &) = delete;
+		ScopedBuffer &operator=(const ScopedBuffer &) = delete;
+	};
+
+	// Encode an image into dest, leaving it ready for i2cFinalise().
+	//
+	bool encode(Buffer *dest, const Buffer *data, const Buffer *mask, I2CSegmentation seg) {
+		bufZeroLength(dest);
+		i2cInitialise(dest, 0x0000, 0x0000, 0x0000, CONFIG_BYTE_400KHZ);
+		return i2cWritePromRecordsEx(dest, data, mask, seg, NULL) == I2C_SUCCESS;
+	}
+
+	void BM_Encode(benchmark::State &state, ImageFunc makeImage, I2CSegmentation seg) {
+		const bench::Image image = makeImage();
+		ScopedBuffer data(image.data), mask(image.mask), i2c(0x10000);
+		for ( auto _ : state ) {
+			if ( !encode(&i2c.buf, &data.buf, &mask.buf, seg) ) {
+				state.SkipWithError("i2cWritePromRecordsEx() failed");
+				break;
+			}
+			benchmark::DoNotOptimize(i2c.buf.data);
+			benchmark::ClobberMemory();
+		}
+		state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)image.data.size());
+		state.counters["i2cBytes"] = (double)i2c.buf.length;
+	}
+
+	// Encode and finalise an image; if asked, pad it out with 0xFF to look like an EEPROM dump.
+	//
+	bool makeImage(Buffer *dest, ImageFunc makeImage, bool isDump) {
+		const bench::Image image = makeImage();
+		ScopedBuffer data(image.data), mask(image.mask);
+		if ( !encode(dest, &data.buf, &mask.buf, I2C_SEG_DEFAULT) ||
+		     i2cFinalise(dest, NULL) != I2C_SUCCESS )
+		{
+			return false;
+		}
+		if ( isDump ) {
+			const std::vector<uint8> erased(0x10000 - dest->length, 0xFF);
+			return bufAppendBlock(dest, erased.data(), erased.size(), NULL) == BUF_SUCCESS;
+		}
+		return true;
+	}
+
+	void BM_Decode(benchmark::State &state, ImageFunc imageFunc, bool isDump) {
+		ScopedBuffer i2c(0x10000), outData(0x10000), outMask(0x10000);
+		if ( !makeImage(&i2c.buf, imageFunc, isDump) ) {
+			state.SkipWithError("encode failed");
+			return;
+		}
+		for ( auto _ : state ) {
+			bufZeroLength(&outData.buf);
+			bufZeroLength(&outMask.buf);
+			if ( i2cReadPromRecords(&outData.buf, &outMask.buf, &i2c.buf, NULL) != I2C_SUCCESS ) {
+				state.SkipWithError("i2cReadPromRecords() failed");
+				break;
+			}
+			benchmark::DoNotOptimize(outData.buf.data);
+			benchmark::ClobberMemory();
+		}
+		state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)i2c.buf.length);
+	}
+
+	void BM_Iterate(benchmark::State &state, ImageFunc imageFunc, bool isDump) {
+		ScopedBuffer i2c(0x10000);
+		struct I2CRecordIter iter;
+		struct I2CRecord record;
+		if ( !makeImage(&i2c.buf, imageFunc, isDump) ) {
+			state.SkipWithError("encode failed");
+			return;
+		}
+		for ( auto _ : state ) {
+			uint32 sum = 0;
+			if ( i2cIterInit(&iter, i2c.buf.data, i2c.buf.length, NULL) != I2C_SUCCESS ) {
+				state.SkipWithError("i2cIterInit() failed");
+				break;
+			}
+			while ( i2cIterNext(&iter, &record) ) {
+				sum += record.length;
+			}
+			benchmark::DoNotOptimize(sum);
+		}
+		state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)i2c.buf.length);
+	}
+
+	void BM_Finalise(benchmark::State &state, ImageFunc makeImage) {
+		const bench::Image image = makeImage();
+		ScopedBuffer data(image.data), mask(image.mask), i2c(0x10000);
+		size_t length;
+		if ( !encode(&i2c.buf, &data.buf, &mask.buf, I2C_SEG_DEFAULT) ) {
+			state.SkipWithError("encode failed");
+			return;
+		}
+		length = i2c.buf.length;
+		for ( auto _ : state ) {
+			i2c.buf.length = length;  // drop the previous iteration's terminator
+			if ( i2cFinalise(&i2c.buf, NULL) != I2C_SUCCESS ) {
+				state.SkipWithError("i2cFinalise() failed");
+				break;
+			}
+			benchmark::ClobberMemory();
+		}
+	}
+}
+
+BENCHMARK_CAPTURE(BM_Encode, dense16k, bench::dense16k, I2C_SEG_DEFAULT);
+BENCHMARK_CAPTURE(BM_Encode, sdcc, bench::sdcc, I2C_SEG_DEFAULT);
+BENCHMARK_CAPTURE(BM_Encode, alternating, bench::alternating, I2C_SEG_DEFAULT);
+BENCHMARK_CAPTURE(BM_Encode, sdcc/minBytes, bench::sdcc, I2C_SEG_MIN_BYTES);
+BENCHMARK_CAPTURE(BM_Encode, alternating/minBytes, bench::alternating, I2C_SEG_MIN_BYTES);
+BENCHMARK_CAPTURE(BM_Encode, alternating/minRecords, bench::alternating, I2C_SEG_MIN_RECORDS);
+BENCHMARK_CAPTURE(BM_Encode, alternating/minBootTime, bench::alternating, I2C_SEG_MIN_BOOT_TIME);
+
+BENCHMARK_CAPTURE(BM_Decode, dense16k, bench::dense16k, false);
+BENCHMARK_CAPTURE(BM_Decode, sdcc, bench::sdcc, false);
+BENCHMARK_CAPTURE(BM_Decode, alternating, bench::alternating, false);
+BENCHMARK_CAPTURE(BM_Decode, eeprom64k/sdcc, bench::sdcc, true);
+
+BENCHMARK_CAPTURE(BM_Iterate, sdcc, bench::sdcc, false);
+BENCHMARK_CAPTURE(BM_Iterate, alternating, bench::alternating, false);
+BENCHMARK_CAPTURE(BM_Iterate, eeprom64k/dense16k, bench::dense16k, true);
+
+BENCHMARK_CAPTURE(BM_Finalise, sdcc, bench::sdcc);
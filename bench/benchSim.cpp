@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <new>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+#include "images.h"
+
+// The transfer paths against a simulated FX2LP. The reported time is the simulated device time
+// (from its timing model), so changes to chunking or to the firmware protocol show up as they
+// would on a board; the CPU column is the host-side cost of driving the simulation.
+//
+namespace {
+
+	struct ScopedSim {
+		struct FX2Sim *sim;
+		explicit ScopedSim(const struct FX2SimConfig *config) {
+			if ( fx2SimCreate(config, &sim, NULL) != FX2_SUCCESS ) {
+				throw std::bad_alloc();
+			}
+		}
+		~ScopedSim() {
+			fx2SimDestroy(sim);
+		}
+		ScopedSim(const ScopedSim &) = delete;
+		ScopedSim &operator=(const ScopedSim &) = delete;
+	};
+
+	// Report the simulated time of one iteration, and return false if it failed.
+	//
+	bool account(benchmark::State &state, struct FX2Sim *sim, FX2Status status) {
+		struct FX2SimStats stats;
+		if ( status != FX2_SUCCESS ) {
+			state.SkipWithError("transfer failed");
+			return false;
+		}
+		fx2SimGetStats(sim, &stats);
+		state.SetIterationTime((double)stats.elapsedNs / 1e9);
+		state.counters["transfers"] = stats.numTransfers;
+		state.counters["pageWrites"] = stats.numPageWrites;
+		fx2SimResetStats(sim);
+		return true;
+	}
+
+	void BM_SimWriteRAM(benchmark::State &state) {
+		const bench::Image image = bench::sdcc();
+		struct FX2SimConfig config;
+		fx2SimDefaultConfig(&config);
+		config.timing.renumerateNs = 0;  // just the transfers
+		ScopedSim s(&config);
+		for ( auto _ : state ) {
+			if ( !account(state, s.sim, fx2WriteRAM(
+				fx2SimDevice(s.sim), image.data.data(), (uint32)image.data.size(), NULL)) )
+			{
+				break;
+			}
+		}
+		state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)image.data.size());
+	}
+
+	// As above, uploading only the defined parts of the image.
+	//
+	void BM_SimWriteRAMMasked(benchmark::State &state) {
+		const bench::Image image = bench::sdcc();
+		struct FX2SimConfig config;
+		fx2SimDefaultConfig(&config);
+		config.timing.renumerateNs = 0;
+		ScopedSim s(&config);
+		for ( auto _ : state ) {
+			if ( !account(state, s.sim, fx2WriteRAMMasked(
+				fx2SimDevice(s.sim), image.data.data(), image.mask.data(),
+				(uint32)image.data.size(), NULL)) )
+			{
+				break;
+			}
+		}
+		state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)image.data.size());
+	}
+
+	// Write a whole 16KiB EEPROM with the firmware gathering state.range(0)-byte pages.
+	//
+	void BM_SimWriteEEPROM(benchmark::State &state) {
+		const std::vector<uint8> image = bench::eeprom64k();
+		ScopedSim s(NULL);
+		if ( fx2SetEEPROMPageSize(fx2SimDevice(s.sim), (uint16)state.range(0), NULL) ) {
+			state.SkipWithError("fx2SetEEPROMPageSize() failed");
+			return;
+		}
+		fx2SimResetStats(s.sim);
+		for ( auto _ : state ) {
+			if ( !account(state, s.sim, fx2WriteEEPROM(
+				fx2SimDevice(s.sim), image.data(), 0x4000, NULL)) )
+			{
+				break;
+			}
+		}
+		state.SetBytesProcessed((int64_t)state.iterations() * 0x4000);
+	}
+
+	// Rewrite a 16KiB EEPROM where one byte in every state.range(0) pages has changed.
+	//
+	void BM_SimWriteEEPROMDiff(benchmark::State &state) {
+		const std::vector<uint8> current = bench::eeprom64k();
+		std::vector<uint8> image = current;
+		const uint32 stride = (uint32)state.range(0) * FX2_DEFAULT_PAGE_SIZE;
+		uint32 bytesWritten = 0;
+		ScopedSim s(NULL);
+		for ( uint32 i = 0; i < 0x4000; i += stride ) {
+			image[i] ^= 0xFF;
+		}
+		for ( auto _ : state ) {
+			if ( !account(state, s.sim, fx2WriteEEPROMDiff(
+				fx2SimDevice(s.sim), image.data(), 0x4000, current.data(), 0, &bytesWritten, NULL)) )
+			{
+				break;
+			}
+		}
+		state.counters["bytesWritten"] = bytesWritten;
+	}
+
+	void BM_SimReadEEPROM(benchmark::State &state) {
+		struct Buffer readBack;
+		ScopedSim s(NULL);
+		if ( bufInitialise(&readBack, 0x4000, 0x00, NULL) != BUF_SUCCESS ) {
+			state.SkipWithError("bufInitialise() failed");
+			return;
+		}
+		for ( auto _ : state ) {
+			bufZeroLength(&readBack);
+			if ( !account(state, s.sim, fx2ReadEEPROM(fx2SimDevice(s.sim), 0x4000, &readBack, NULL)) ) {
+				break;
+			}
+		}
+		state.SetBytesProcessed((int64_t)state.iterations() * 0x4000);
+		bufDestroy(&readBack);
+	}
+}
+
+BENCHMARK(BM_SimWriteRAM)->UseManualTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SimWriteRAMMasked)->UseManualTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SimWriteEEPROM)->UseManualTime()->Unit(benchmark::kMillisecond)
+	->Arg(16)->Arg(32)->Arg(64);
+BENCHMARK(BM_SimWriteEEPROMDiff)->UseManualTime()->Unit(benchmark::kMillisecond)
+	->Arg(1)->Arg(4)->Arg(64);
+BENCHMARK(BM_SimReadEEPROM)->UseManualTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <makestuff/common.h>
+#include <makestuff/libfx2loader.h>
+#include "xfer.h"
+#include "images.h"
+
+// The transfer planners behind fx2WriteRAM(), fx2WriteRAMMasked(), fx2ReadEEPROM() and
+// fx2WriteEEPROMDiff(): carving a job into control-transfer chunks, finding the runs of a sparse
+// image worth uploading, and finding the EEPROM pages which need rewriting. No USB traffic is
+// involved; these measure the host-side bookkeeping only.
+//
+namespace {
+
+	// Walk a job of state.range(0) bytes starting at state.range(1), as xferNext() would.
+	//
+	void BM_Chunks(benchmark::State &state) {
+		const std::vector<uint8> image(state.range(0));
+		struct XferJob job;
+		for ( auto _ : state ) {
+			uint32 numChunks = 0;
+			xferInitWrite(&job, 0xA0, (uint32)state.range(1), image.data(), (uint32)image.size());
+			do {
+				xferAdvance(&job, xferChunkSize(&job, BLOCK_SIZE));
+				numChunks++;
+			} while ( !xferFinished(&job) );
+			benchmark::DoNotOptimize(numChunks);
+		}
+		state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)image.size());
+	}
+
+	// Plan the masked RAM upload of an image.
+	//
+	void BM_MaskRuns(benchmark::State &state, bench::Image (*make)()) {
+		const bench::Image image = make();
+		const uint32 numBytes = (uint32)image.mask.size();
+		for ( auto _ : state ) {
+			uint32 offset = 0, length = 0, numRuns = 0;
+			while ( xferNextMaskRun(image.mask.data(), numBytes, XFER_MERGE_GAP, &offset, &length) ) {
+				offset += length;
+				numRuns++;
+			}
+			benchmark::DoNotOptimize(numRuns);
+		}
+		state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)numBytes);
+	}
+
+	// Diff a 64KiB EEPROM dump against a new image in which one byte in every state.range(0)
+	// pages has changed (zero meaning no changes at all).
+	//
+	void BM_DirtyRuns(benchmark::State &state) {
+		const std::vector<uint8> oldData = bench::eeprom64k();
+		std::vector<uint8> newData = oldData;
+		const uint32 numBytes = (uint32)newData.size();
+		const uint32 stride = (uint32)state.range(0) * FX2_DEFAULT_PAGE_SIZE;
+		if ( stride ) {
+			for ( uint32 i = FX2_DEFAULT_PAGE_SIZE / 2; i < numBytes; i += stride ) {
+				newData[i] ^= 0xFF;
+			}
+		}
+		for ( auto _ : state ) {
+			uint32 offset = 0, length = 0, dirty = 0;
+			while (
+				xferNextDirtyRun(
+					newData.data(), oldData.data(), numBytes, FX2_DEFAULT_PAGE_SIZE,
+					&offset, &length) )
+			{
+				dirty += length;
+				offset += length;
+			}
+			benchmark::DoNotOptimize(dirty);
+		}
+		state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)numBytes);
+	}
+}
+
+BENCHMARK(BM_Chunks)
+	->Args({0x4000, 0x0000})   // a 16KiB RAM image
+	->Args({0x10000, 0x0000})  // a 64KiB EEPROM
+	->Args({0x10000, 0x0040}); // a 64KiB EEPROM write starting part-way through a block
+
+BENCHMARK(BM_DirtyRuns)
+	->Arg(0)    // unchanged: the common "nothing to do" reflash
+	->Arg(1)    // every page changed
+	->Arg(2)    // every other page changed: the most runs
+	->Arg(64);  // a small patch
+
+BENCHMARK_CAPTURE(BM_MaskRuns, sdcc, bench::sdcc);
+BENCHMARK_CAPTURE(BM_MaskRuns, alternating, bench::alternating);
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef IMAGES_H
+#define IMAGES_H
+
+#include <cstddef>
+#include <vector>
+#include <makestuff/common.h>
+
+// Input generators for the benchmarks, shaped like what fx2loader really sees. The data bytes are from a fixed LCG, so runs are comparable.
+//
+namespace bench {
+
+	struct Image {
+		std::vector<uint8> data;
+		std::vector<uint8> mask;
+	};
+
+	inline uint8 noise(uint32 &seed) {
+		seed = seed * 1103515245U + 12345U;
+		return (uint8)(seed >> 16);
+	}
+
+	inline void fill(Image &image, size_t address, size_t length, uint32 &seed) {
+		for ( size_t i = address; i < address + length; i++ ) {
+			image.data[i] = noise(seed);
+			image.mask[i] = 0x01;
+		}
+	}
+
+	// A firmware which fills the whole 16KiB of FX2LP code RAM.
+	//
+	inline Image dense16k() {
+		Image image{std::vector<uint8>(0x4000), std::vector<uint8>(0x4000)};
+		uint32 seed = 1;
+		fill(image, 0x0000, 0x4000, seed);
+		return image;
+	}
+
+	// What SDCC emits for a typical fx2lib firmware: a reset vector, a sparse interrupt vector
+	// table, the code, the constant tables and the xdata initialisers, with gaps between them.
+	//
+	inline Image sdcc() {
+		Image image{std::vector<uint8>(0x4000), std::vector<uint8>(0x4000)};
+		uint32 seed = 2;
+		fill(image, 0x0000, 3, seed);
+		for ( size_t vec = 0x0003; vec < 0x0070; vec += 8 ) {
+			if ( noise(seed) & 1 ) {
+				fill(image, vec, 3, seed);
+			}
+		}
+		fill(image, 0x0080, 0x1A37, seed);
+		fill(image, 0x1C00, 0x0311, seed);
+		fill(image, 0x2000, 0x0100, seed);  // USB descriptors
+		fill(image, 0x3E00, 0x0043, seed);
+		return image;
+	}
+
+	// The worst case for the encoder: one byte in every five, so every gap is just long enough to
+	// start a new record, over the whole 16KiB.
+	//
+	inline Image alternating() {
+		Image image{std::vector<uint8>(0x4000), std::vector<uint8>(0x4000)};
+		uint32 seed = 3;
+		for ( size_t i = 0; i < 0x4000; i += 5 ) {
+			fill(image, i, 1, seed);
+		}
+		return image;
+	}
+
+	// The raw contents of a full 64KiB EEPROM, as read back by "fx2loader eeprom:512 x.iic".
+	//
+	inline std::vector<uint8> eeprom64k() {
+		std::vector<uint8> dump(0x10000);
+		uint32 seed = 4;
+		for ( uint8 &byte : dump ) {
+			byte = noise(seed);
+		}
+		return dump;
+	}
+}
+
+#endif
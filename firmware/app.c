@@ -23,6 +23,64 @@
 #include "prom.h"
 #include "defs.h"
 
+// EEPROM writes are gathered here until a whole page is ready
+static xdata uint8 pageBuf[MAX_PAGE_SIZE];
+
+// State of the current EP2OUT bulk EEPROM write
+static xdata uint16 bulkAddress;
+static xdata uint8 bulkBank;
+static xdata uint32 bulkRemaining = 0;
+static xdata uint8 bulkError = 0;
+
+// State of the current sequential EEPROM read, which either streams out over EP4IN or feeds the
+// CRC calculation
+static xdata uint16 readAddress;
+static xdata uint8 readBank;
+static xdata uint32 readRemaining = 0;
+static xdata uint8 readIsCrc;
+
+// CRC32 (IEEE 802.3, reflected) of the bytes read so far, using a nibble-wide table to save space
+static xdata uint32 crc;
+static code uint32 crcTable[] = {
+	0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+	0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+// Start a sequential read of "length" bytes at the given bank and address.
+//
+static void readStart(uint16 address, uint8 bank, uint32 length, bool isCrc) {
+	if ( readRemaining ) {
+		promStopRead();  // abandon any previous read
+	}
+	readRemaining = length;
+	readIsCrc = isCrc;
+	crc = 0xFFFFFFFF;
+	if ( readRemaining ) {
+		readAddress = address;
+		readBank = bank;
+		promSetBank(readBank);
+		promStartRead(readAddress);
+	}
+}
+
+// Return the current byte of the sequential read, and move on to the next one.
+//
+static uint8 readNext(void) {
+	xdata uint8 byte = promPeekByte();
+	readAddress++;
+	if ( !--readRemaining ) {
+		promStopRead();
+	} else if ( !readAddress ) {
+		// Sequential reads stop at the end of a bank, so restart in the next one
+		promStopRead();
+		promSetBank(++readBank);
+		promStartRead(0x0000);
+	} else {
+		promNextByte();
+	}
+	return byte;
+}
+
 // Called once at startup
 //
 void mainInit(void) {
@@ -76,11 +134,64 @@ void mainInit(void) {
 	// Auto-commit 512-byte packets from EP8IN (master may commit early by asserting PKTEND)
 	SYNCDELAY; EP8AUTOINLENH = 0x02;
 	SYNCDELAY; EP8AUTOINLENL = 0x00;
+
+	// Drive the I2C bus at 400kHz
+	I2CTL = bm400KHZ;
 }
 
 // Called repeatedly while the device is idle
 //
-void mainLoop(void) { }
+void mainLoop(void) {
+	// Program the EEPROM straight from the EP2OUT buffers during a bulk write
+	if ( bulkRemaining && !(EP2468STAT & bmEP2EMPTY) ) {
+		xdata uint16 count = (EP2BCH << 8) | EP2BCL;
+		xdata uint16 offset = 0;
+		xdata uint8 chunkSize;
+		if ( count > bulkRemaining ) {
+			count = (uint16)bulkRemaining;
+		}
+		promSetBank(bulkBank);
+		while ( offset < count ) {
+			// Never straddle a MAX_PAGE_SIZE boundary, so no chunk crosses into the next bank
+			chunkSize = MAX_PAGE_SIZE - (uint8)(bulkAddress & (MAX_PAGE_SIZE - 1));
+			if ( chunkSize > count - offset ) {
+				chunkSize = (uint8)(count - offset);
+			}
+			if ( promWrite(bulkAddress, chunkSize, EP2FIFOBUF + offset) ) {
+				bulkError = 1;
+			}
+			bulkAddress += chunkSize;
+			offset += chunkSize;
+			if ( !bulkAddress ) {
+				promSetBank(++bulkBank);
+			}
+		}
+		bulkRemaining -= count;
+		SYNCDELAY; OUTPKTEND = bmSKIP | 2;  // give the buffer back to the host
+	}
+
+	if ( readRemaining ) {
+		if ( readIsCrc ) {
+			// Fold the next few bytes into the CRC, leaving time to answer status requests
+			xdata uint8 i = 64;
+			do {
+				crc ^= readNext();
+				crc = (crc >> 4) ^ crcTable[crc & 0x0F];
+				crc = (crc >> 4) ^ crcTable[crc & 0x0F];
+			} while ( --i && readRemaining );
+		} else if ( !(EP2468STAT & bmEP4FULL) ) {
+			// Fill the next EP4IN buffer from the sequential read
+			xdata uint16 count = (readRemaining > 512) ? 512 : (uint16)readRemaining;
+			xdata uint16 i;
+			for ( i = 0; i < count; i++ ) {
+				EP4FIFOBUF[i] = readNext();
+			}
+			EP4BCH = MSB(count);
+			SYNCDELAY;
+			EP4BCL = LSB(count);
+		}
+	}
+}
 
 // Called when a vendor command is received
 //
@@ -111,9 +222,11 @@ uint8 handleVendorCommand(uint8 cmd) {
 		if ( SETUP_TYPE == (REQDIR_DEVICETOHOST | REQTYPE_VENDOR) ) {
 			// It's an IN operation - read from prom and send to host
 			xdata uint16 address = SETUP_VALUE();
+			xdata uint8 bank = (uint8)SETUP_INDEX();
 			xdata uint16 length = SETUP_LENGTH();
 			xdata uint16 chunkSize;
 			xdata uint8 i;
+			promSetBank(bank);
 			while ( length ) {
 				while ( EP0CS & bmEPBUSY );
 				chunkSize = length < EP0BUF_SIZE ? length : EP0BUF_SIZE;
@@ -126,20 +239,137 @@ uint8 handleVendorCommand(uint8 cmd) {
 				EP0BCL = chunkSize;
 				address += chunkSize;
 				length -= chunkSize;
+				if ( !address ) {
+					promSetBank(++bank);
+				}
 			}
 		} else if ( SETUP_TYPE == (REQDIR_HOSTTODEVICE | REQTYPE_VENDOR) ) {
-			// It's an OUT operation - read from host and send to prom
+			// It's an OUT operation - read from host and send to prom. The EP0 packets are gathered
+			// into whole pages, so each page is programmed with exactly one write cycle.
 			xdata uint16 address = SETUP_VALUE();
+			xdata uint16 pageStart = address;
+			xdata uint8 bank = (uint8)SETUP_INDEX();
 			xdata uint16 length = SETUP_LENGTH();
-			xdata uint16 chunkSize;
+			xdata uint8 pageMask = promGetPageSize() - 1;
+			xdata uint8 fill = 0;
+			xdata uint8 chunkSize;
+			xdata uint8 i;
+			promSetBank(bank);
 			while ( length ) {
 				EP0BCL = 0x00; // allow pc transfer in
 				while ( EP0CS & bmEPBUSY ); // wait for data
 				chunkSize = EP0BCL;
-				promWrite(address, chunkSize, EP0BUF);
-				address += chunkSize;
+				for ( i = 0; i < chunkSize; i++ ) {
+					pageBuf[fill++] = EP0BUF[i];
+					address++;
+					if ( !(address & pageMask) ) {
+						// Reached a page boundary
+						promWrite(pageStart, fill, pageBuf);
+						pageStart = address;
+						fill = 0;
+						if ( !address ) {
+							promSetBank(++bank);
+						}
+					}
+				}
 				length -= chunkSize;
 			}
+			if ( fill ) {
+				promWrite(pageStart, fill, pageBuf);
+			}
+		}
+		return true;
+
+	// Command to query or set the EEPROM page size
+	//
+	case CMD_EEPROM_CONFIG:
+		if ( SETUP_TYPE == (REQDIR_DEVICETOHOST | REQTYPE_VENDOR) ) {
+			while ( EP0CS & bmEPBUSY );
+			EP0BUF[0] = promGetPageSize();
+			EP0BUF[1] = 0x00;
+			EP0BUF[2] = LSB(FEATURES);
+			EP0BUF[3] = MSB(FEATURES);
+			EP0BCH = 0;
+			SYNCDELAY;
+			EP0BCL = 4;
+		} else if ( SETUP_TYPE == (REQDIR_HOSTTODEVICE | REQTYPE_VENDOR) ) {
+			xdata uint16 size = SETUP_VALUE();
+			if ( size == 0 || size > MAX_PAGE_SIZE || (size & (size - 1)) ) {
+				return false;  // not a power of two we can buffer
+			}
+			promSetPageSize((uint8)size);
+		}
+		return true;
+
+	// Command to start a bulk EEPROM write, or check on its progress
+	//
+	case CMD_EEPROM_BULK_WRITE:
+		if ( SETUP_TYPE == (REQDIR_DEVICETOHOST | REQTYPE_VENDOR) ) {
+			// Report the number of bytes still to be programmed, and whether anything went wrong
+			while ( EP0CS & bmEPBUSY );
+			EP0BUF[0] = (uint8)bulkRemaining;
+			EP0BUF[1] = (uint8)(bulkRemaining >> 8);
+			EP0BUF[2] = (uint8)(bulkRemaining >> 16);
+			EP0BUF[3] = (uint8)(bulkRemaining >> 24);
+			EP0BUF[4] = bulkError;
+			EP0BCH = 0;
+			SYNCDELAY;
+			EP0BCL = 5;
+		} else if ( SETUP_TYPE == (REQDIR_HOSTTODEVICE | REQTYPE_VENDOR) ) {
+			// The data stage carries the total length; the data itself follows on EP2OUT
+			bulkAddress = SETUP_VALUE();
+			bulkBank = (uint8)SETUP_INDEX();
+			EP0BCL = 0x00; // allow pc transfer in
+			while ( EP0CS & bmEPBUSY ); // wait for data
+			bulkError = 0;
+			bulkRemaining =
+				EP0BUF[0] | ((uint32)EP0BUF[1] << 8) |
+				((uint32)EP0BUF[2] << 16) | ((uint32)EP0BUF[3] << 24);
+		}
+		return true;
+
+	// Command to start streaming EEPROM data out over EP4IN
+	//
+	case CMD_EEPROM_BULK_READ:
+		if ( SETUP_TYPE == (REQDIR_HOSTTODEVICE | REQTYPE_VENDOR) ) {
+			// The data stage carries the total length; the data itself is sent on EP4IN
+			EP0BCL = 0x00; // allow pc transfer in
+			while ( EP0CS & bmEPBUSY ); // wait for data
+			readStart(
+				SETUP_VALUE(), (uint8)SETUP_INDEX(),
+				EP0BUF[0] | ((uint32)EP0BUF[1] << 8) |
+				((uint32)EP0BUF[2] << 16) | ((uint32)EP0BUF[3] << 24),
+				false);
+		}
+		return true;
+
+	// Command to start a CRC32 calculation over a range of the EEPROM, or to get its result
+	//
+	case CMD_EEPROM_CRC32:
+		if ( SETUP_TYPE == (REQDIR_DEVICETOHOST | REQTYPE_VENDOR) ) {
+			// Report the number of bytes still to be read, and the CRC so far
+			xdata uint32 result = readRemaining ? crc : ~crc;
+			while ( EP0CS & bmEPBUSY );
+			EP0BUF[0] = (uint8)readRemaining;
+			EP0BUF[1] = (uint8)(readRemaining >> 8);
+			EP0BUF[2] = (uint8)(readRemaining >> 16);
+			EP0BUF[3] = (uint8)(readRemaining >> 24);
+			EP0BUF[4] = (uint8)result;
+			EP0BUF[5] = (uint8)(result >> 8);
+			EP0BUF[6] = (uint8)(result >> 16);
+			EP0BUF[7] = (uint8)(result >> 24);
+			EP0BCH = 0;
+			SYNCDELAY;
+			EP0BCL = 8;
+		} else if ( SETUP_TYPE == (REQDIR_HOSTTODEVICE | REQTYPE_VENDOR) ) {
+			// The data stage carries the number of bytes to include in the CRC
+			EP0BCL = 0x00; // allow pc transfer in
+			while ( EP0CS & bmEPBUSY ); // wait for data
+			readStart(
+				SETUP_VALUE(), (uint8)SETUP_INDEX(),
+				EP0BUF[0] | ((uint32)EP0BUF[1] << 8) |
+				((uint32)EP0BUF[2] << 16) | ((uint32)EP0BUF[3] << 24),
+				true);
 		}
 		return true;
 	}
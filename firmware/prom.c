@@ -19,6 +19,27 @@
 #include <makestuff.h>
 
 static xdata uint8 currentByte;
+static xdata uint8 pageSize = 64;  // 24LC128
+static xdata uint8 devAddr = 0xA2;  // I2C address byte (WRITE); OR with 1 for READ
+
+// Select the 64KiB bank used by subsequent operations. On 24LC1025-style parts the bank is chosen
+// by the block-select bit (bit 3) of the I2C address byte. Only banks 0 and 1 exist.
+//
+void promSetBank(uint8 bank) {
+	devAddr = 0xA2 | ((bank & 0x01) << 3);
+}
+
+// Set the EEPROM's page size. It must be a power of two.
+//
+void promSetPageSize(uint8 size) {
+	pageSize = size;
+}
+
+// Get the EEPROM's page size.
+//
+uint8 promGetPageSize(void) {
+	return pageSize;
+}
 
 // Wait for the I2C interface to complete the current send or receive operation. Return true if
 // there was a bus error, else return false if the operation completed successfully.
@@ -81,7 +102,7 @@ bool promStartRead(uint16 addr) {
 	// Send the WRITE command
 	//
 	I2CS = bmSTART;
-	I2DAT = 0xA2;  // Write I2C address byte (WRITE)
+	I2DAT = devAddr;  // Write I2C address byte (WRITE)
 	if ( promWaitForAck() ) {
 		return true;
 	}
@@ -100,7 +121,7 @@ bool promStartRead(uint16 addr) {
 	// Send the READ command
 	//
 	I2CS = bmSTART;
-	I2DAT = 0xA3;  // Write I2C address byte (READ)
+	I2DAT = devAddr | 0x01;  // Write I2C address byte (READ)
 	if ( promWaitForDone() ) {
 		return true;
 	}
@@ -146,7 +167,7 @@ bool promRead(uint16 addr, uint8 length, xdata uint8 *buf) {
 	// Send the WRITE command
 	//
 	I2CS = bmSTART;
-	I2DAT = 0xA2;  // Write I2C address byte (WRITE)
+	I2DAT = devAddr;  // Write I2C address byte (WRITE)
 	if ( promWaitForAck() ) {
 		return true;
 	}
@@ -165,7 +186,7 @@ bool promRead(uint16 addr, uint8 length, xdata uint8 *buf) {
 	// Send the READ command
 	//
 	I2CS = bmSTART;
-	I2DAT = 0xA3;  // Write I2C address byte (READ)
+	I2DAT = devAddr | 0x01;  // Write I2C address byte (READ)
 	if ( promWaitForDone() ) {
 		return true;
 	}
@@ -202,9 +223,10 @@ bool promRead(uint16 addr, uint8 length, xdata uint8 *buf) {
 	return false;
 }
 
-// Read "length" bytes from RAM at "buf", and write them to the attached EEPROM at address "addr".
+// Write "length" bytes from RAM at "buf" to the attached EEPROM at address "addr", in a single
+// write cycle. The caller must ensure the range does not cross a page boundary.
 //
-bool promWrite(uint16 addr, uint8 length, const xdata uint8 *buf) {
+static bool promWritePage(uint16 addr, uint8 length, const xdata uint8 *buf) {
 	xdata uint8 i;
 
 	// Wait for I2C idle
@@ -214,7 +236,7 @@ bool promWrite(uint16 addr, uint8 length, const xdata uint8 *buf) {
 	// Send the WRITE command
 	//
 	I2CS = bmSTART;
-	I2DAT = 0xA2;  // Write I2C address byte (WRITE)
+	I2DAT = devAddr;  // Write I2C address byte (WRITE)
 	if ( promWaitForAck() ) {
 		return true;
 	}
@@ -246,7 +268,7 @@ bool promWrite(uint16 addr, uint8 length, const xdata uint8 *buf) {
 
 	do {
 		I2CS = bmSTART;
-		I2DAT = 0xA2;  // Write I2C address byte (WRITE)
+		I2DAT = devAddr;  // Write I2C address byte (WRITE)
 		if ( promWaitForDone() ) {
 			return true;
 		}
@@ -256,3 +278,24 @@ bool promWrite(uint16 addr, uint8 length, const xdata uint8 *buf) {
 	
 	return false;
 }
+
+// Read "length" bytes from RAM at "buf", and write them to the attached EEPROM at address "addr".
+// The data is split on page boundaries, so each page costs exactly one write cycle and nothing
+// wraps around within a page.
+//
+bool promWrite(uint16 addr, uint8 length, const xdata uint8 *buf) {
+	xdata uint8 chunkSize;
+	while ( length ) {
+		chunkSize = pageSize - (uint8)(addr & (pageSize - 1));
+		if ( chunkSize > length ) {
+			chunkSize = length;
+		}
+		if ( promWritePage(addr, chunkSize, buf) ) {
+			return true;
+		}
+		addr += chunkSize;
+		buf += chunkSize;
+		length -= chunkSize;
+	}
+	return false;
+}
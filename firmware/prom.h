@@ -19,6 +19,10 @@
 
 #include <makestuff.h>
 
+void promSetPageSize(uint8 size);
+uint8 promGetPageSize(void);
+void promSetBank(uint8 bank);
+
 bool promRead(uint16 addr, uint8 length, xdata uint8 *buf);
 bool promWrite(uint16 addr, uint8 length, const xdata uint8 *buf);
 
@@ -0,0 +1,345 @@
+/* 
+ * Copyright (C) 2009-2011 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glob.h>
+#include <makestuff/libfx2loader.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libbuffer.h>
+#include "fx2cli.h"
+
+struct ConvertJob {
+	char *srcName;
+	char *dstName;
+	int retVal;
+	const char *error;
+	double seconds;
+};
+
+// Each worker keeps its own buffers, reused from one file to the next.
+//
+struct WorkerBuffers {
+	struct Buffer data;
+	struct Buffer mask;
+	struct Buffer i2c;
+};
+
+struct BatchContext {
+	struct ConvertJob *jobs;
+	struct WorkerBuffers *workers;
+	I2CSegmentation seg;
+};
+
+static const char *extension(const char *name) {
+	const size_t len = strlen(name);
+	return len >= 4 ? name + len - 4 : "";
+}
+
+static Source fileSource(const char *name) {
+	const char *const ext = extension(name);
+	if ( !strcmp(".hex", ext) || !strcmp(".ihx", ext) ) {
+		return SRC_HEXFILE;
+	} else if ( !strcmp(".bix", ext) ) {
+		return SRC_BIXFILE;
+	} else if ( !strcmp(".iic", ext) ) {
+		return SRC_IICFILE;
+	}
+	return SRC_BAD;
+}
+
+static Destination fileDestination(const char *name) {
+	const char *const ext = extension(name);
+	if ( !strcmp(".hex", ext) || !strcmp(".ihx", ext) ) {
+		return DST_HEXFILE;
+	} else if ( !strcmp(".bix", ext) ) {
+		return DST_BIXFILE;
+	} else if ( !strcmp(".iic", ext) ) {
+		return DST_IICFILE;
+	}
+	return DST_BAD;
+}
+
+// Convert one file, using this worker's buffers.
+//
+static void runConversion(void *context, size_t worker, size_t index) {
+	const struct BatchContext *const ctx = (const struct BatchContext *)context;
+	struct ConvertJob *const job = ctx->jobs + index;
+	struct WorkerBuffers *const bufs = ctx->workers + worker;
+	const Source src = fileSource(job->srcName);
+	const Destination dst = fileDestination(job->dstName);
+	const char *error = NULL;
+	int retVal = 0;
+	const double start = poolNow();
+	if ( !bufs->data.data ) {
+		CHECK_STATUS(bufInitialise(&bufs->data, 1024, 0x00, &error), 8, cleanup);
+	}
+	if ( !bufs->mask.data ) {
+		CHECK_STATUS(bufInitialise(&bufs->mask, 1024, 0x00, &error), 9, cleanup);
+	}
+	if ( !bufs->i2c.data ) {
+		CHECK_STATUS(bufInitialise(&bufs->i2c, 1024, 0x00, &error), 10, cleanup);
+	}
+	// Sparse sources only write the bytes they define, so the gaps must read back as the fill byte
+	// rather than whatever the worker's previous file left there
+	//
+	bufZeroLength(&bufs->data);
+	bufZeroLength(&bufs->mask);
+	bufZeroLength(&bufs->i2c);
+	if ( src == SRC_HEXFILE ) {
+		CHECK_STATUS(hexReadFile(job->srcName, &bufs->data, &bufs->mask, &error), 11, cleanup);
+	} else if ( src == SRC_BIXFILE ) {
+		CHECK_STATUS(bufAppendFromBinaryFile(&bufs->data, job->srcName, &error), 12, cleanup);
+		CHECK_STATUS(bufAppendConst(&bufs->mask, 0x01, bufs->data.length, &error), 13, cleanup);
+	} else if ( src == SRC_IICFILE ) {
+		CHECK_STATUS(bufAppendFromBinaryFile(&bufs->i2c, job->srcName, &error), 14, cleanup);
+	} else {
+		errRender(&error, "Unrecognised source: %s", job->srcName);
+		FAIL_RET(3, cleanup);
+	}
+	if ( dst == DST_BAD ) {
+		errRender(&error, "Unrecognised destination: %s", job->dstName);
+		FAIL_RET(4, cleanup);
+	}
+	retVal = writeFile(dst, job->dstName, &bufs->data, &bufs->mask, &bufs->i2c, ctx->seg, &error);
+cleanup:
+	job->seconds = poolNow() - start;
+	job->retVal = retVal;
+	job->error = error;
+}
+
+// Append a job, taking ownership of the two names.
+//
+static int addJob(
+	struct ConvertJob **jobs, size_t *numJobs, size_t *capacity, char *srcName, char *dstName)
+{
+	if ( !srcName || !dstName ) {
+		free(srcName);
+		free(dstName);
+		return -1;
+	}
+	if ( *numJobs == *capacity ) {
+		const size_t newCapacity = *capacity ? 2 * *capacity : 64;
+		struct ConvertJob *const newJobs =
+			(struct ConvertJob *)realloc(*jobs, newCapacity * sizeof(struct ConvertJob));
+		if ( !newJobs ) {
+			free(srcName);
+			free(dstName);
+			return -1;
+		}
+		*jobs = newJobs;
+		*capacity = newCapacity;
+	}
+	memset(*jobs + *numJobs, 0, sizeof(struct ConvertJob));
+	(*jobs)[*numJobs].srcName = srcName;
+	(*jobs)[*numJobs].dstName = dstName;
+	(*numJobs)++;
+	return 0;
+}
+
+static char *copyString(const char *str, size_t len) {
+	char *const result = (char *)malloc(len + 1);
+	if ( result ) {
+		memcpy(result, str, len);
+		result[len] = '\0';
+	}
+	return result;
+}
+
+// Expand one manifest line. If the source is a glob pattern, every match becomes a job, with each
+// '*' in the destination replaced by the match's base name without its extension, so that
+// "fw/*.hex out/*.iic" converts fw/a.hex to out/a.iic and so on. A pattern which matches nothing
+// is an error, so a typo doesn't pass for a successful run.
+//
+static int addLine(
+	struct ConvertJob **jobs, size_t *numJobs, size_t *capacity, const char *srcName,
+	const char *dstName, const char **error)
+{
+	glob_t matches;
+	size_t i, stemLen;
+	const char *match, *base, *dot, *star;
+	char *dst;
+	int gStatus;
+	if ( !strpbrk(srcName, "*?[") ) {
+		if ( addJob(
+			jobs, numJobs, capacity,
+			copyString(srcName, strlen(srcName)), copyString(dstName, strlen(dstName))) )
+		{
+			errRender(error, "out of memory");
+			return -1;
+		}
+		return 0;
+	}
+	gStatus = glob(srcName, 0, NULL, &matches);
+	if ( gStatus ) {
+		if ( gStatus == GLOB_NOMATCH ) {
+			errRender(error, "no files match \"%s\"", srcName);
+		} else if ( gStatus == GLOB_ABORTED ) {
+			errRender(error, "cannot read the directories to match \"%s\"", srcName);
+		} else {
+			errRender(error, "out of memory");
+		}
+		globfree(&matches);
+		return -1;
+	}
+	for ( i = 0; i < matches.gl_pathc; i++ ) {
+		match = matches.gl_pathv[i];
+		base = strrchr(match, '/');
+		base = base ? base + 1 : match;
+		dot = strrchr(base, '.');
+		stemLen = dot ? (size_t)(dot - base) : strlen(base);
+		star = strchr(dstName, '*');
+		if ( star ) {
+			dst = (char *)malloc(strlen(dstName) + stemLen);
+			if ( dst ) {
+				sprintf(dst, "%.*s%.*s%s", (int)(star - dstName), dstName, (int)stemLen, base, star + 1);
+			}
+		} else {
+			dst = copyString(dstName, strlen(dstName));
+		}
+		if ( addJob(jobs, numJobs, capacity, copyString(match, strlen(match)), dst) ) {
+			globfree(&matches);
+			errRender(error, "out of memory");
+			return -1;
+		}
+	}
+	globfree(&matches);
+	return 0;
+}
+
+// Read the manifest: one "source destination" pair per line, blank lines and '#' comments ignored.
+//
+static int readManifest(
+	const char *manifest, struct ConvertJob **jobs, size_t *numJobs, const char **error)
+{
+	int retVal = 0;
+	struct Buffer text = {0};
+	size_t capacity = 0, line = 0;
+	char *ptr, *end, *eol, *srcName, *dstName;
+	CHECK_STATUS(bufInitialise(&text, 4096, 0x00, error), 36, cleanup);
+	CHECK_STATUS(bufAppendFromBinaryFile(&text, manifest, error), 36, cleanup);
+	CHECK_STATUS(bufAppendByte(&text, '\0', error), 36, cleanup);
+	ptr = (char *)text.data;
+	end = ptr + text.length - 1;
+	while ( ptr < end ) {
+		line++;
+		eol = strchr(ptr, '\n');
+		if ( !eol ) {
+			eol = end;
+		}
+		*eol = '\0';
+		if ( strchr(ptr, '#') ) {
+			*strchr(ptr, '#') = '\0';
+		}
+		srcName = strtok(ptr, " \t\r");
+		dstName = srcName ? strtok(NULL, " \t\r") : NULL;
+		if ( srcName ) {
+			if ( !dstName || strtok(NULL, " \t\r") ) {
+				errRender(error, "%s:%lu: expected \"<source> <destination>\"", manifest, (unsigned long)line);
+				FAIL_RET(36, cleanup);
+			}
+			if ( addLine(jobs, numJobs, &capacity, srcName, dstName, error) ) {
+				errPrefix(error, "%s:%lu", manifest, (unsigned long)line);
+				FAIL_RET(36, cleanup);
+			}
+		}
+		ptr = eol + 1;
+	}
+cleanup:
+	if ( text.data ) {
+		bufDestroy(&text);
+	}
+	return retVal;
+}
+
+int batchRun(const char *manifest, size_t numThreads, I2CSegmentation seg) {
+	int retVal = 0;
+	struct ConvertJob *jobs = NULL;
+	struct WorkerBuffers *workers = NULL;
+	struct BatchContext ctx;
+	size_t numJobs = 0, numFailed = 0, i;
+	const char *error = NULL;
+	double start;
+	retVal = readManifest(manifest, &jobs, &numJobs, &error);
+	if ( retVal ) {
+		fprintf(stderr, "%s\n", error);
+		errFree(error);
+		goto cleanup;
+	}
+	if ( numThreads > numJobs ) {
+		numThreads = numJobs;
+	}
+	workers = (struct WorkerBuffers *)calloc(numThreads ? numThreads : 1, sizeof(struct WorkerBuffers));
+	if ( !workers ) {
+		fprintf(stderr, "Unable to allocate worker buffers\n");
+		FAIL_RET(30, cleanup);
+	}
+	ctx.jobs = jobs;
+	ctx.workers = workers;
+	ctx.seg = seg;
+	start = poolNow();
+	if ( poolRun(numThreads, numJobs, runConversion, &ctx) ) {
+		fprintf(stderr, "Unable to start worker threads\n");
+		FAIL_RET(31, cleanup);
+	}
+
+	// Report each conversion's result in manifest order
+	//
+	for ( i = 0; i < numJobs; i++ ) {
+		if ( jobs[i].retVal ) {
+			printf(
+				"[%lu] %s -> %s: FAILED (%d) after %.3fs: %s\n", (unsigned long)i, jobs[i].srcName,
+				jobs[i].dstName, jobs[i].retVal, jobs[i].seconds,
+				jobs[i].error ? jobs[i].error : "unknown error");
+			numFailed++;
+		} else {
+			printf(
+				"[%lu] %s -> %s: OK in %.3fs\n", (unsigned long)i, jobs[i].srcName, jobs[i].dstName,
+				jobs[i].seconds);
+		}
+	}
+	printf(
+		"%lu of %lu conversions succeeded in %.3fs\n", (unsigned long)(numJobs - numFailed),
+		(unsigned long)numJobs, poolNow() - start);
+	if ( numFailed ) {
+		retVal = 35;
+	}
+cleanup:
+	for ( i = 0; i < numJobs; i++ ) {
+		if ( jobs[i].error ) {
+			errFree(jobs[i].error);
+		}
+		free(jobs[i].srcName);
+		free(jobs[i].dstName);
+	}
+	free(jobs);
+	if ( workers ) {
+		for ( i = 0; i < (numThreads ? numThreads : 1); i++ ) {
+			if ( workers[i].i2c.data ) {
+				bufDestroy(&workers[i].i2c);
+			}
+			if ( workers[i].mask.data ) {
+				bufDestroy(&workers[i].mask);
+			}
+			if ( workers[i].data.data ) {
+				bufDestroy(&workers[i].data);
+			}
+		}
+		free(workers);
+	}
+	return retVal;
+}
@@ -0,0 +1,164 @@
+/* 
+ * Copyright (C) 2009-2011 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <makestuff/libbuffer.h>
+#include "fx2cli.h"
+
+// Bump this whenever the entry layout or the encoder output changes, so stale entries miss.
+//
+#define CACHE_VERSION 2
+#define CACHE_MAGIC 0x43325846  // "FX2C"
+
+// Entry header, followed by the data bytes, the mask bytes, the C2 image and the source file
+// itself. The hash only names the entry, so a hit also needs the source bytes to match.
+//
+struct CacheHeader {
+	uint32 magic;
+	uint32 version;
+	uint64 hash;
+	uint64 sourceLength;
+	uint32 settings;
+	uint32 dataLength;
+	uint32 i2cLength;
+	uint32 reserved;
+};
+
+// FNV-1a, 64-bit.
+//
+static uint64 fnv1a(uint64 hash, const uint8 *ptr, size_t length) {
+	while ( length-- ) {
+		hash ^= *ptr++;
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+static void cacheHeader(
+	struct CacheHeader *hdr, const struct Buffer *source, uint32 settings)
+{
+	uint8 s[4];
+	s[0] = (uint8)settings;
+	s[1] = (uint8)(settings >> 8);
+	s[2] = (uint8)(settings >> 16);
+	s[3] = (uint8)(settings >> 24);
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = CACHE_MAGIC;
+	hdr->version = CACHE_VERSION;
+	hdr->hash = fnv1a(fnv1a(0xCBF29CE484222325ULL, source->data, source->length), s, 4);
+	hdr->sourceLength = source->length;
+	hdr->settings = settings;
+}
+
+static char *cachePath(const char *dir, uint64 hash, const char *suffix) {
+	char *const path = (char *)malloc(strlen(dir) + 48);
+	if ( path ) {
+		sprintf(
+			path, "%s/%08lx%08lx%s", dir,
+			(unsigned long)(hash >> 32), (unsigned long)(hash & 0xFFFFFFFFUL), suffix);
+	}
+	return path;
+}
+
+bool cacheLoad(
+	const char *dir, const struct Buffer *source, uint32 settings,
+	struct Buffer *data, struct Buffer *mask, struct Buffer *i2c)
+{
+	struct CacheHeader want, got;
+	struct Buffer entry = {0};
+	const uint8 *ptr;
+	char *path;
+	bool hit = false;
+	cacheHeader(&want, source, settings);
+	path = cachePath(dir, want.hash, ".fx2c");
+	if ( !path || bufInitialise(&entry, 4096, 0x00, NULL) != BUF_SUCCESS ) {
+		goto cleanup;
+	}
+	if ( bufAppendFromBinaryFile(&entry, path, NULL) != BUF_SUCCESS ||
+	     entry.length < sizeof(got) )
+	{
+		goto cleanup;  // no entry (or a truncated one)
+	}
+	memcpy(&got, entry.data, sizeof(got));
+	if ( got.magic != want.magic || got.version != want.version || got.hash != want.hash ||
+	     got.sourceLength != want.sourceLength || got.settings != want.settings ||
+	     entry.length != sizeof(got) + 2*(size_t)got.dataLength + got.i2cLength + source->length )
+	{
+		goto cleanup;
+	}
+	ptr = entry.data + sizeof(got);
+	if ( memcmp(ptr + 2*(size_t)got.dataLength + got.i2cLength, source->data, source->length) ) {
+		goto cleanup;  // a different file with the same hash
+	}
+	if ( bufAppendBlock(data, ptr, got.dataLength, NULL) != BUF_SUCCESS ||
+	     bufAppendBlock(mask, ptr + got.dataLength, got.dataLength, NULL) != BUF_SUCCESS ||
+	     bufAppendBlock(i2c, ptr + 2*got.dataLength, got.i2cLength, NULL) != BUF_SUCCESS )
+	{
+		data->length = mask->length = i2c->length = 0;
+		goto cleanup;
+	}
+	hit = true;
+cleanup:
+	if ( entry.data ) {
+		bufDestroy(&entry);
+	}
+	free(path);
+	return hit;
+}
+
+void cacheStore(
+	const char *dir, const struct Buffer *source, uint32 settings,
+	const struct Buffer *data, const struct Buffer *mask, const struct Buffer *i2c)
+{
+	struct CacheHeader hdr;
+	char *path, *tmpPath = NULL;
+	char suffix[32];
+	FILE *file = NULL;
+	bool ok;
+	cacheHeader(&hdr, source, settings);
+	hdr.dataLength = (uint32)data->length;
+	hdr.i2cLength = (uint32)i2c->length;
+	path = cachePath(dir, hdr.hash, ".fx2c");
+	sprintf(suffix, ".%lu.tmp", (unsigned long)getpid());
+	tmpPath = cachePath(dir, hdr.hash, suffix);
+	if ( !path || !tmpPath || mask->length != data->length ) {
+		goto cleanup;
+	}
+
+	// Write a private temporary file, then rename it into place: readers see either the old entry
+	// or the complete new one, never a partial write
+	//
+	file = fopen(tmpPath, "wb");
+	if ( !file ) {
+		goto cleanup;
+	}
+	ok =
+		fwrite(&hdr, sizeof(hdr), 1, file) == 1 &&
+		fwrite(data->data, 1, data->length, file) == data->length &&
+		fwrite(mask->data, 1, data->length, file) == data->length &&
+		fwrite(i2c->data, 1, i2c->length, file) == i2c->length &&
+		fwrite(source->data, 1, source->length, file) == source->length;
+	ok = (fclose(file) == 0) && ok;
+	if ( !ok || rename(tmpPath, path) != 0 ) {
+		remove(tmpPath);
+	}
+cleanup:
+	free(tmpPath);
+	free(path);
+}
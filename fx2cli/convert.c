@@ -0,0 +1,140 @@
+/* 
+ * Copyright (C) 2009-2011 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <makestuff/libfx2loader.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libbuffer.h>
+#include "fx2cli.h"
+
+int writeRAM(
+	struct USBDevice *device, const struct Buffer *sourceData, const struct Buffer *sourceMask,
+	const char **error)
+{
+	int retVal = 0;
+	if ( sourceMask && sourceMask->length >= sourceData->length ) {
+		CHECK_STATUS(
+			fx2WriteRAMMasked(
+				device, sourceData->data, sourceMask->data, (uint32)sourceData->length, error),
+			18, cleanup);
+	} else {
+		CHECK_STATUS(
+			fx2WriteRAM(device, sourceData->data, (uint32)sourceData->length, error), 18, cleanup);
+	}
+cleanup:
+	return retVal;
+}
+
+int writeEEPROM(
+	struct USBDevice *device, const struct Buffer *i2cBuffer, const struct EEPROMOptions *opts,
+	const char **error)
+{
+	int retVal = 0;
+	if ( opts->pageSize ) {
+		CHECK_STATUS(fx2SetEEPROMPageSize(device, opts->pageSize, error), 21, cleanup);
+	}
+	if ( opts->diff ) {
+		CHECK_STATUS(
+			fx2WriteEEPROMDiff(
+				device, i2cBuffer->data, (uint32)i2cBuffer->length, NULL, opts->pageSize, NULL, error),
+			21, cleanup);
+	} else {
+		CHECK_STATUS(
+			fx2WriteEEPROMBulk(device, i2cBuffer->data, (uint32)i2cBuffer->length, error), 21, cleanup);
+	}
+	if ( opts->verify ) {
+		bool isMatch;
+		CHECK_STATUS(
+			fx2VerifyEEPROM(device, i2cBuffer->data, (uint32)i2cBuffer->length, &isMatch, error),
+			21, cleanup);
+		if ( !isMatch ) {
+			errRender(error, "EEPROM verification failed: CRC mismatch");
+			FAIL_RET(33, cleanup);
+		}
+	}
+cleanup:
+	return retVal;
+}
+
+int writeFile(
+	Destination dst, const char *fileName, struct Buffer *sourceData, struct Buffer *sourceMask,
+	struct Buffer *i2cBuffer, I2CSegmentation seg, const char **error)
+{
+	int retVal = 0;
+	if ( dst == DST_HEXFILE ) {
+		// If the source data was I2C, write it to data/mask buffers
+		//
+		if ( sourceData->length == 0 && i2cBuffer->length > 0 ) {
+			CHECK_STATUS(i2cReadPromRecords(sourceData, sourceMask, i2cBuffer, error), 22, cleanup);
+		}
+
+		// Write the data/mask buffers out as an I8HEX file
+		//
+		CHECK_STATUS(
+			hexWriteFile(sourceData, sourceMask, fileName, 16, error),
+			23, cleanup);
+	} else if ( dst == DST_BIXFILE ) {
+		// If the source data was I2C, write it to data/mask buffers
+		//
+		if ( sourceData->length == 0 && i2cBuffer->length > 0 ) {
+			CHECK_STATUS(i2cReadPromRecords(sourceData, sourceMask, i2cBuffer, error), 24, cleanup);
+		}
+
+		// Write the data buffer out as a binary file
+		//
+		CHECK_STATUS(
+			bufWriteBinaryFile(sourceData, fileName, 0x00000000, sourceData->length, error),
+			25, cleanup);
+	} else if ( dst == DST_IICFILE ) {
+		// If the source data was *not* I2C, construct I2C data from the raw data/mask buffers
+		//
+		if ( i2cBuffer->length == 0 ) {
+			i2cInitialise(i2cBuffer, 0x0000, 0x0000, 0x0000, CONFIG_BYTE_400KHZ);
+			CHECK_STATUS(
+				i2cWritePromRecordsEx(i2cBuffer, sourceData, sourceMask, seg, error), 26, cleanup);
+			CHECK_STATUS(i2cFinalise(i2cBuffer, error), 27, cleanup);
+		}
+
+		// Write the I2C data out as a binary file
+		//
+		CHECK_STATUS(
+			bufWriteBinaryFile(i2cBuffer, fileName, 0x00000000, i2cBuffer->length, error),
+			28, cleanup);
+	} else {
+		retVal = 29;
+	}
+cleanup:
+	return retVal;
+}
+
+int reportBootTime(const struct Buffer *i2cBuffer, const char **error) {
+	int retVal = 0;
+	struct I2CBootModel model;
+	struct I2CRecordIter iter;
+	uint64 bootNs;
+	i2cDefaultBootModel(&model);
+	CHECK_STATUS(
+		i2cEstimateBootTime(&model, i2cBuffer->data, i2cBuffer->length, &bootNs, error),
+		34, cleanup);
+	CHECK_STATUS(i2cIterInit(&iter, i2cBuffer->data, i2cBuffer->length, error), 34, cleanup);
+	printf(
+		"Estimated boot time: %.2fms (%lu records, %lu bytes at %skHz)\n",
+		(double)bootNs / 1e6, (unsigned long)iter.numRecords + 1,
+		(unsigned long)(iter.trailing - i2cBuffer->data),
+		(iter.configByte & CONFIG_BYTE_400KHZ) ? "400" : "100");
+cleanup:
+	return retVal;
+}
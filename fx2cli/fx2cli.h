@@ -0,0 +1,146 @@
+/* 
+ * Copyright (C) 2009-2011 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef FX2CLI_H
+#define FX2CLI_H
+
+#include <makestuff/common.h>
+#include <makestuff/libfx2loader.h>
+
+struct Buffer;
+struct USBDevice;
+
+typedef enum {
+	SRC_BAD,
+	SRC_EEPROM,
+	SRC_HEXFILE,
+	SRC_BIXFILE,
+	SRC_IICFILE
+} Source;
+
+typedef enum {
+	DST_BAD,
+	DST_RAM,
+	DST_EEPROM,
+	DST_HEXFILE,
+	DST_IICFILE,
+	DST_BIXFILE
+} Destination;
+
+// How EEPROM destinations should be written
+//
+struct EEPROMOptions {
+	bool diff;        // only rewrite the pages which have changed
+	uint16 pageSize;  // EEPROM page size to configure, or zero to leave the firmware's default
+	bool verify;      // compare CRCs after writing
+};
+
+// Write an image to the device's RAM, skipping the long holes in it if there is a mask to say
+// where they are. Returns zero on success, or the process exit code on failure.
+//
+int writeRAM(
+	struct USBDevice *device, const struct Buffer *sourceData, const struct Buffer *sourceMask,
+	const char **error
+);
+
+// Write an I2C image to the device's EEPROM, honouring the options. Returns zero on success, or
+// the process exit code on failure.
+//
+int writeEEPROM(
+	struct USBDevice *device, const struct Buffer *i2cBuffer, const struct EEPROMOptions *opts,
+	const char **error
+);
+
+// Write the data/mask buffers (or the I2C buffer, whichever is populated) to a file, converting as
+// necessary, with I2C records laid out according to seg. Returns zero on success, or the process
+// exit code on failure.
+//
+int writeFile(
+	Destination dst, const char *fileName, struct Buffer *sourceData, struct Buffer *sourceMask,
+	struct Buffer *i2cBuffer, I2CSegmentation seg, const char **error
+);
+
+// Print the estimated time the FX2LP would take to boot from the I2C buffer, using the nominal
+// boot model. Returns zero on success, or the process exit code on failure.
+//
+int reportBootTime(const struct Buffer *i2cBuffer, const char **error);
+
+// Look in the cache directory for the converted forms of a source file, keyed by a hash of its
+// contents and the conversion settings. The entry holds a copy of the source file, so a hash
+// collision is a miss rather than the wrong image. On a hit, the (empty) data, mask and I2C
+// buffers are populated and true is returned.
+//
+bool cacheLoad(
+	const char *dir, const struct Buffer *source, uint32 settings,
+	struct Buffer *data, struct Buffer *mask, struct Buffer *i2c
+);
+
+// Save the converted forms of a source file in the cache directory. The entry is renamed into
+// place once complete, so concurrent runs can share the directory. Failures are ignored: the
+// cache is only an optimisation.
+//
+void cacheStore(
+	const char *dir, const struct Buffer *source, uint32 settings,
+	const struct Buffer *data, const struct Buffer *mask, const struct Buffer *i2c
+);
+
+// Run func(context, worker, i) for each i in [0, numJobs) on a pool of numThreads worker threads,
+// and wait for them all to finish. Each call also gets the index of the worker running it, in
+// [0, numThreads), so per-worker state can be kept without locking. Returns zero on success,
+// nonzero if the threads could not be started.
+//
+typedef void (*PoolFunc)(void *context, size_t worker, size_t index);
+int poolRun(size_t numThreads, size_t numJobs, PoolFunc func, void *context);
+
+// Seconds on a monotonic clock, for timing jobs.
+//
+double poolNow(void);
+
+// Write the transfer statistics gathered from each device as JSON, to fileName or to stdout if
+// it is "-". Each device has FX2_TRANSFER_NUM_KINDS entries in tuning, giving the transfer
+// settings it ended up with. Returns zero on success, or the process exit code on failure.
+//
+int statsWrite(
+	const char *fileName, const char *const *names, const struct FX2Stats *stats,
+	const struct FX2TransferTuning *tuning, size_t numDevices
+);
+
+// Convert each source file to its destination file as listed in the manifest, on a pool of
+// numThreads worker threads, and print each result. Returns zero on success, or the process exit
+// code on failure.
+//
+int batchRun(const char *manifest, size_t numThreads, I2CSegmentation seg);
+
+// Each device is opened by its selector alone, so the selectors given to multiRun() must each pick
+// out a different board. Returns zero if no two of them could match the same board, else prints
+// the offending pair and returns the process exit code.
+//
+int multiCheck(const char *const *vps, size_t numDevices);
+
+// Flash the prepared image to (or dump the EEPROM of) each of the listed devices in parallel.
+// Each device gets its own result line; a failing device does not stop the others. Each device's
+// transfers are sized and timed according to xferConfig. If statsFile is not NULL, each device's
+// transfer statistics are written to it. Returns zero if every device succeeded, else the process
+// exit code.
+//
+int multiRun(
+	Source src, Destination dst, const char *const *vps, size_t numDevices, size_t numThreads,
+	const struct Buffer *sourceData, const struct Buffer *sourceMask,
+	const struct Buffer *i2cBuffer, uint32 eepromSize, const char *dstName, const struct EEPROMOptions *opts,
+	const struct FX2TransferConfig *xferConfig, const char *statsFile
+);
+
+#endif
@@ -17,34 +17,41 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include <sheitmann/libargtable2.h>
 #include <makestuff/libusbwrap.h>
 #include <makestuff/libfx2loader.h>
 #include <makestuff/liberror.h>
 #include <makestuff/libbuffer.h>
-
-typedef enum {
-	SRC_BAD,
-	SRC_EEPROM,
-	SRC_HEXFILE,
-	SRC_BIXFILE,
-	SRC_IICFILE
-} Source;
-
-typedef enum {
-	DST_RAM,
-	DST_EEPROM,
-	DST_HEXFILE,
-	DST_IICFILE,
-	DST_BIXFILE
-} Destination;
+#include "fx2cli.h"
 
 #define INDENT "                              "
 
 int main(int argc, char *argv[]) {
-	struct arg_str *vpOpt   = arg_str0("v", "vidpid", "<VID:PID>", " vendor ID and product ID (e.g 04B4:8613)");
+	struct arg_str *vpOpt   = arg_strn("v", "vidpid", "<VID:PID>", 0, 256, " vendor ID and product ID (e.g 04B4:8613); repeat to\n"
+		INDENT"flash or dump several devices in parallel");
+	struct arg_int *jobsOpt = arg_int0("j", "jobs", "<n>", "        max devices or batch conversions to work on at\n"
+		INDENT"once (default: all)");
+	struct arg_lit *diffOpt = arg_lit0("d", "diff", "             only rewrite EEPROM pages which have changed");
+	struct arg_int *pageOpt = arg_int0(NULL, "page-size", "<bytes>", " EEPROM page size (e.g 32, 64 or 128)");
+	struct arg_str *optOpt  = arg_str0(NULL, "optimise", "<goal>", "  lay out .iic records for \"bytes\" (smallest image),\n"
+		INDENT"\"records\" (fewest records) or \"boot\" (fastest boot)");
+	struct arg_lit *bootOpt = arg_lit0(NULL, "boot-report", "      estimate the C2 boot time of the .iic image");
+	struct arg_str *cacheOpt = arg_str0(NULL, "cache", "<dir>", "      reuse conversions of identical source files\n"
+		INDENT"from this directory");
+	struct arg_str *batchOpt = arg_str0(NULL, "batch", "<manifest>", " convert each \"<source> <destination>\" file pair\n"
+		INDENT"listed in the manifest (sources may be globs)");
+	struct arg_lit *verifyOpt = arg_lit0(NULL, "verify", "           check the EEPROM CRC32 after writing");
+	struct arg_str *statsOpt = arg_str0(NULL, "stats", "<file>", "     write per-device transfer statistics as JSON\n"
+		INDENT"to this file (\"-\" for stdout)");
+	struct arg_int *chunkOpt = arg_int0(NULL, "chunk-size", "<bytes>", " fix the transfer chunk size (a power of two from\n"
+		INDENT"512 to 4096) instead of tuning it");
+	struct arg_int *timeoutOpt = arg_int0(NULL, "timeout", "<ms>", "    fix the per-chunk transfer timeout instead of\n"
+		INDENT"deriving it from the measured rate");
+	struct arg_str *awaitOpt = arg_str0(NULL, "await", "<VID:PID>", " after loading RAM, wait for the new firmware to\n"
+		INDENT"enumerate as VID:PID (fails after 5s)");
 	struct arg_lit *helpOpt = arg_lit0("h", "help", "             print this help and exit");
-	struct arg_str *srcOpt = arg_str1(
+	struct arg_str *srcOpt = arg_str0(
 		NULL, NULL, "<source>",
 		"             where to read from:\n"
 		INDENT"eeprom:<size>: external EEPROM (size in kbits)\n"
@@ -59,7 +66,7 @@ int main(int argc, char *argv[]) {
 		INDENT"fileName.bix: binary .bix file\n"
 		INDENT"fileName.iic: Cypress .iic-format file");
 	struct arg_end *endOpt = arg_end(20);
-	void* argTable[] = {vpOpt, helpOpt, srcOpt, dstOpt, endOpt};
+	void* argTable[] = {vpOpt, jobsOpt, diffOpt, pageOpt, optOpt, bootOpt, cacheOpt, batchOpt, verifyOpt, statsOpt, chunkOpt, timeoutOpt, awaitOpt, helpOpt, srcOpt, dstOpt, endOpt};
 	const char *progName = "fx2loader";
 	int retVal = 0;
 	int numErrors;
@@ -68,10 +75,19 @@ int main(int argc, char *argv[]) {
 	struct Buffer sourceData = {0};
 	struct Buffer sourceMask = {0};
 	struct Buffer i2cBuffer = {0};
+	struct Buffer sourceFile = {0};
+	const char *cacheDir = NULL;
+	uint32 cacheSettings = 0;
+	bool cacheHit = false;
 	const char *srcExt, *dstExt;
 	uint32 eepromSize = 0;
 	struct USBDevice *device = NULL;
 	const char *error = NULL;
+	bool multi;
+	struct EEPROMOptions eepromOpts;
+	struct FX2TransferConfig xferConfig = {0, 0};
+	const char *statsFile = NULL;
+	I2CSegmentation seg = I2C_SEG_DEFAULT;
 
 	// Parse arguments...
 	//
@@ -96,6 +112,34 @@ int main(int argc, char *argv[]) {
 		FAIL_RET(1, cleanup);
 	}
 
+	if ( optOpt->count ) {
+		if ( !strcmp("bytes", optOpt->sval[0]) ) {
+			seg = I2C_SEG_MIN_BYTES;
+		} else if ( !strcmp("records", optOpt->sval[0]) ) {
+			seg = I2C_SEG_MIN_RECORDS;
+		} else if ( !strcmp("boot", optOpt->sval[0]) ) {
+			seg = I2C_SEG_MIN_BOOT_TIME;
+		} else {
+			fprintf(stderr, "Unrecognised optimisation goal: %s\n", optOpt->sval[0]);
+			FAIL_RET(4, cleanup);
+		}
+	}
+
+	// Batch conversions don't need a source or destination on the command line...
+	//
+	if ( batchOpt->count ) {
+		retVal = batchRun(
+			batchOpt->sval[0],
+			jobsOpt->count ? (size_t)jobsOpt->ival[0] : (size_t)sysconf(_SC_NPROCESSORS_ONLN),
+			seg);
+		goto cleanup;
+	}
+	if ( !srcOpt->count ) {
+		fprintf(stderr, "%s: missing <source>\n", progName);
+		printf("Try '%s --help' for more information.\n", progName);
+		FAIL_RET(1, cleanup);
+	}
+
 	srcExt = srcOpt->sval[0] + strlen(srcOpt->sval[0]) - 4;
 	if ( !strcmp(".hex", srcExt) || !strcmp(".ihx", srcExt) ) {
 		src = SRC_HEXFILE;
@@ -138,13 +182,56 @@ int main(int argc, char *argv[]) {
 		dst = DST_RAM;
 	}
 
+	eepromOpts.diff = diffOpt->count > 0;
+	eepromOpts.pageSize = pageOpt->count ? (uint16)pageOpt->ival[0] : 0;
+	eepromOpts.verify = verifyOpt->count > 0;
+	if ( chunkOpt->count ) {
+		const int size = chunkOpt->ival[0];
+		if ( size < FX2_CHUNK_MIN || size > FX2_CHUNK_MAX || (size & (size - 1)) ) {
+			fprintf(stderr, "The chunk size must be a power of two from %d to %d\n", FX2_CHUNK_MIN, FX2_CHUNK_MAX);
+			FAIL_RET(38, cleanup);
+		}
+		xferConfig.chunkSize = (uint32)size;
+	}
+	if ( timeoutOpt->count ) {
+		if ( timeoutOpt->ival[0] <= 0 ) {
+			fprintf(stderr, "The timeout must be a positive number of milliseconds\n");
+			FAIL_RET(38, cleanup);
+		}
+		xferConfig.timeout = (uint32)timeoutOpt->ival[0];
+	}
+	if ( awaitOpt->count && (vpOpt->count > 1 || dst != DST_RAM) ) {
+		fprintf(stderr, "The --await option needs a single device and a RAM destination\n");
+		FAIL_RET(5, cleanup);
+	}
+	multi = false;
 	if ( src == SRC_EEPROM || dst == DST_EEPROM || dst == DST_RAM ) {
 		if ( !vpOpt->count ) {
 			fprintf(stderr, "Missing VID:PID - try something like \"-v 04b4:8613\"\n");
 			FAIL_RET(5, cleanup);
 		}
+		multi = (vpOpt->count > 1);
+		if ( multi ) {
+			retVal = multiCheck(vpOpt->sval, (size_t)vpOpt->count);
+			if ( retVal ) {
+				goto cleanup;
+			}
+		}
+		if ( multi && src == SRC_EEPROM && (dst == DST_EEPROM || dst == DST_RAM) ) {
+			fprintf(stderr, "When dumping several EEPROMs the destination must be a file\n");
+			FAIL_RET(5, cleanup);
+		}
+		if ( statsOpt->count ) {
+			statsFile = statsOpt->sval[0];
+		}
 		CHECK_STATUS(usbInitialise(0, &error), 6, cleanup);
-		CHECK_STATUS(usbOpenDevice(vpOpt->sval[0], 1, 0, 0, &device, &error), 7, cleanup);
+		if ( !multi ) {
+			CHECK_STATUS(usbOpenDevice(vpOpt->sval[0], 1, 0, 0, &device, &error), 7, cleanup);
+			CHECK_STATUS(fx2SetTransferConfig(device, &xferConfig, &error), 38, cleanup);
+			if ( statsFile ) {
+				CHECK_STATUS(fx2StatsEnable(device, &error), 37, cleanup);
+			}
+		}
 	}
 
 	// Initialise buffers...
@@ -153,95 +240,155 @@ int main(int argc, char *argv[]) {
 	CHECK_STATUS(bufInitialise(&sourceMask, 1024, 0x00, &error), 9, cleanup);
 	CHECK_STATUS(bufInitialise(&i2cBuffer, 1024, 0x00, &error), 10, cleanup);
 
+	// Dump several EEPROMs in parallel, one file per device...
+	//
+	if ( multi && src == SRC_EEPROM ) {
+		retVal = multiRun(
+			src, dst, vpOpt->sval, (size_t)vpOpt->count,
+			jobsOpt->count ? (size_t)jobsOpt->ival[0] : (size_t)vpOpt->count,
+			NULL, NULL, NULL, eepromSize, dstOpt->sval[0], &eepromOpts, &xferConfig, statsFile);
+		goto cleanup;
+	}
+
+	// Straight .bix <-> .iic conversions run directly between memory-mapped files...
+	//
+	if ( !cacheOpt->count && !bootOpt->count ) {
+		if ( src == SRC_IICFILE && dst == DST_BIXFILE ) {
+			CHECK_STATUS(i2cConvertIicToBix(srcOpt->sval[0], dstOpt->sval[0], &error), 25, cleanup);
+			goto cleanup;
+		} else if ( src == SRC_BIXFILE && dst == DST_IICFILE ) {
+			CHECK_STATUS(
+				i2cConvertBixToIic(srcOpt->sval[0], dstOpt->sval[0], CONFIG_BYTE_400KHZ, &error),
+				28, cleanup);
+			goto cleanup;
+		}
+	}
+
+	// Maybe the cache already has this file converted, with these settings...
+	//
+	if ( cacheOpt->count && src != SRC_EEPROM ) {
+		cacheDir = cacheOpt->sval[0];
+		cacheSettings = (uint32)(src | (seg << 8) | (CONFIG_BYTE_400KHZ << 16));
+		CHECK_STATUS(bufInitialise(&sourceFile, 1024, 0x00, &error), 10, cleanup);
+		CHECK_STATUS(bufAppendFromBinaryFile(&sourceFile, srcOpt->sval[0], &error), 12, cleanup);
+		cacheHit = cacheLoad(
+			cacheDir, &sourceFile, cacheSettings, &sourceData, &sourceMask, &i2cBuffer);
+	}
+
 	// Read from source...
 	//
-	if ( src == SRC_HEXFILE ) {
-		CHECK_STATUS(bufReadFromIntelHexFile(&sourceData, &sourceMask, srcOpt->sval[0], &error), 11, cleanup);
+	if ( cacheHit ) {
+		// Both forms came from the cache
+	} else if ( src == SRC_HEXFILE ) {
+		CHECK_STATUS(hexReadFile(srcOpt->sval[0], &sourceData, &sourceMask, &error), 11, cleanup);
 	} else if ( src == SRC_BIXFILE ) {
 		CHECK_STATUS(bufAppendFromBinaryFile(&sourceData, srcOpt->sval[0], &error), 12, cleanup);
 		CHECK_STATUS(bufAppendConst(&sourceMask, 0x01, sourceData.length, &error), 13, cleanup);
 	} else if ( src == SRC_IICFILE ) {
 		CHECK_STATUS(bufAppendFromBinaryFile(&i2cBuffer, srcOpt->sval[0], &error), 14, cleanup);
 	} else if ( src == SRC_EEPROM ) {
-		CHECK_STATUS(fx2ReadEEPROM(device, eepromSize, &i2cBuffer, &error), 15, cleanup);
+		CHECK_STATUS(fx2ReadEEPROMBulk(device, eepromSize, &i2cBuffer, &error), 15, cleanup);
 	} else {
 		fprintf(stderr, "Internal error UNHANDLED_SRC\n");
 		FAIL_RET(16, cleanup);
 	}
 
-	// Write to destination...
+	// ...and if it wasn't cached, convert it both ways and save it for next time
 	//
-	if ( dst == DST_RAM ) {
-		// If the source data was I2C, write it to data/mask buffers
-		//
-		if ( i2cBuffer.length > 0 ) {
+	if ( cacheDir && !cacheHit ) {
+		if ( i2cBuffer.length == 0 ) {
+			i2cInitialise(&i2cBuffer, 0x0000, 0x0000, 0x0000, CONFIG_BYTE_400KHZ);
+			CHECK_STATUS(i2cWritePromRecordsEx(&i2cBuffer, &sourceData, &sourceMask, seg, &error), 19, cleanup);
+			CHECK_STATUS(i2cFinalise(&i2cBuffer, &error), 20, cleanup);
+		} else {
 			CHECK_STATUS(i2cReadPromRecords(&sourceData, &sourceMask, &i2cBuffer, &error), 17, cleanup);
 		}
+		cacheStore(cacheDir, &sourceFile, cacheSettings, &sourceData, &sourceMask, &i2cBuffer);
+	}
 
-		// Write the data to RAM
-		//
-		CHECK_STATUS(fx2WriteRAM(device, sourceData.data, (uint32)sourceData.length, &error), 18, cleanup);
-	} else if ( dst == DST_EEPROM ) {
-		// If the source data was *not* I2C, construct I2C data from the raw data/mask buffers
-		//
-		if ( i2cBuffer.length == 0 ) {
+	// Flash several devices in parallel, with the image converted just once...
+	//
+	if ( multi ) {
+		if ( dst == DST_RAM && sourceData.length == 0 && i2cBuffer.length > 0 ) {
+			CHECK_STATUS(i2cReadPromRecords(&sourceData, &sourceMask, &i2cBuffer, &error), 17, cleanup);
+		} else if ( dst == DST_EEPROM && i2cBuffer.length == 0 ) {
 			i2cInitialise(&i2cBuffer, 0x0000, 0x0000, 0x0000, CONFIG_BYTE_400KHZ);
-			CHECK_STATUS(i2cWritePromRecords(&i2cBuffer, &sourceData, &sourceMask, &error), 19, cleanup);
+			CHECK_STATUS(i2cWritePromRecordsEx(&i2cBuffer, &sourceData, &sourceMask, seg, &error), 19, cleanup);
 			CHECK_STATUS(i2cFinalise(&i2cBuffer, &error), 20, cleanup);
 		}
+		retVal = multiRun(
+			src, dst, vpOpt->sval, (size_t)vpOpt->count,
+			jobsOpt->count ? (size_t)jobsOpt->ival[0] : (size_t)vpOpt->count,
+			&sourceData, &sourceMask, &i2cBuffer, 0, NULL, &eepromOpts, &xferConfig, statsFile);
+		goto cleanup;
+	}
 
-		// Write the I2C data to the EEPROM
-		//
-		CHECK_STATUS(fx2WriteEEPROM(device, i2cBuffer.data, (uint32)i2cBuffer.length, &error), 21, cleanup);
-	} else if ( dst == DST_HEXFILE ) {
+	// Write to destination...
+	//
+	if ( dst == DST_RAM ) {
 		// If the source data was I2C, write it to data/mask buffers
 		//
-		if ( i2cBuffer.length > 0 ) {
-			CHECK_STATUS(i2cReadPromRecords(&sourceData, &sourceMask, &i2cBuffer, &error), 22, cleanup);
+		if ( sourceData.length == 0 && i2cBuffer.length > 0 ) {
+			CHECK_STATUS(i2cReadPromRecords(&sourceData, &sourceMask, &i2cBuffer, &error), 17, cleanup);
 		}
 
-		// Write the data/mask buffers out as an I8HEX file
-		//
-		//dump(0x00000000, sourceMask.data, sourceMask.length);
-		CHECK_STATUS(
-			bufWriteToIntelHexFile(&sourceData, &sourceMask, dstOpt->sval[0], 16, false, &error),
-			23, cleanup);
-	} else if ( dst == DST_BIXFILE ) {
-		// If the source data was I2C, write it to data/mask buffers
+		// Write the data to RAM, skipping the holes
 		//
-		if ( i2cBuffer.length > 0 ) {
-			CHECK_STATUS(i2cReadPromRecords(&sourceData, &sourceMask, &i2cBuffer, &error), 24, cleanup);
-		}
+		retVal = writeRAM(device, &sourceData, &sourceMask, &error);
 
-		// Write the data buffer out as a binary file
+		// Optionally wait for the new firmware to come up, so scripts can use it straight away
 		//
-		CHECK_STATUS(
-			bufWriteBinaryFile(&sourceData, dstOpt->sval[0], 0x00000000, sourceData.length, &error),
-			25, cleanup);
-	} else if ( dst == DST_IICFILE ) {
+		if ( !retVal && awaitOpt->count ) {
+			CHECK_STATUS(fx2AwaitRenumeration(&device, awaitOpt->sval[0], 5000, &error), 39, cleanup);
+		}
+	} else if ( dst == DST_EEPROM ) {
 		// If the source data was *not* I2C, construct I2C data from the raw data/mask buffers
 		//
 		if ( i2cBuffer.length == 0 ) {
 			i2cInitialise(&i2cBuffer, 0x0000, 0x0000, 0x0000, CONFIG_BYTE_400KHZ);
-			CHECK_STATUS(i2cWritePromRecords(&i2cBuffer, &sourceData, &sourceMask, &error), 26, cleanup);
-			CHECK_STATUS(i2cFinalise(&i2cBuffer, &error), 27, cleanup);
+			CHECK_STATUS(i2cWritePromRecordsEx(&i2cBuffer, &sourceData, &sourceMask, seg, &error), 19, cleanup);
+			CHECK_STATUS(i2cFinalise(&i2cBuffer, &error), 20, cleanup);
 		}
 
-		// Write the I2C data out as a binary file
+		// Write the I2C data to the EEPROM
+		//
+		retVal = writeEEPROM(device, &i2cBuffer, &eepromOpts, &error);
+	} else if ( dst == DST_HEXFILE || dst == DST_BIXFILE || dst == DST_IICFILE ) {
+		// Convert as necessary and write the file
 		//
-		CHECK_STATUS(
-			bufWriteBinaryFile(&i2cBuffer, dstOpt->sval[0], 0x00000000, i2cBuffer.length, &error),
-			28, cleanup);
+		retVal = writeFile(dst, dstOpt->sval[0], &sourceData, &sourceMask, &i2cBuffer, seg, &error);
 	} else {
 		fprintf(stderr, "Internal error UNHANDLED_DST\n");
 		FAIL_RET(29, cleanup);
 	}
+	if ( !retVal && bootOpt->count && i2cBuffer.length > 0 ) {
+		retVal = reportBootTime(&i2cBuffer, &error);
+	}
 
 cleanup:
 	if ( error ) {
 		fprintf(stderr, "%s: %s\n", argv[0], error);
 		errFree(error);
 	}
+	if ( statsFile && device ) {
+		// Written even if something failed, since that's when they're most interesting
+		struct FX2Stats stats;
+		struct FX2TransferTuning tuning[FX2_TRANSFER_NUM_KINDS];
+		int kind;
+		for ( kind = 0; kind < FX2_TRANSFER_NUM_KINDS; kind++ ) {
+			fx2GetTransferTuning(device, (FX2TransferKind)kind, tuning + kind);
+		}
+		if ( fx2StatsGet(device, &stats) ) {
+			const int sStatus = statsWrite(statsFile, vpOpt->sval, &stats, tuning, 1);
+			if ( sStatus && !retVal ) {
+				retVal = sStatus;
+			}
+			fx2StatsDisable(device);
+		}
+	}
+	if ( device ) {
+		fx2ClearTransferConfig(device);
+	}
 	usbCloseDevice(device, 0);
 	usbShutdown();
 	if ( i2cBuffer.data ) {
@@ -253,6 +400,9 @@ cleanup:
 	if ( sourceData.data ) {
 		bufDestroy(&sourceData);
 	}
+	if ( sourceFile.data ) {
+		bufDestroy(&sourceFile);
+	}
 	arg_freetable(argTable, sizeof(argTable)/sizeof(*argTable));
 	return retVal;
 }
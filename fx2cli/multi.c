@@ -0,0 +1,235 @@
+/* 
+ * Copyright (C) 2009-2011 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <makestuff/libusbwrap.h>
+#include <makestuff/libfx2loader.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libbuffer.h>
+#include "fx2cli.h"
+
+struct DeviceJob {
+	const char *vp;
+	char *dumpFile;
+	int retVal;
+	const char *error;
+	double seconds;
+	struct FX2Stats stats;
+	struct FX2TransferTuning tuning[FX2_TRANSFER_NUM_KINDS];
+};
+
+struct MultiContext {
+	Source src;
+	Destination dst;
+	const struct Buffer *sourceData;
+	const struct Buffer *sourceMask;
+	const struct Buffer *i2cBuffer;
+	uint32 eepromSize;
+	const struct EEPROMOptions *opts;
+	const struct FX2TransferConfig *xferConfig;
+	bool keepStats;
+	struct DeviceJob *jobs;
+};
+
+// Derive a per-device dump file name by inserting "-<index>" before the extension, so that
+// "backup.iic" becomes "backup-0.iic", "backup-1.iic" etc.
+//
+static char *dumpFileName(const char *dstName, size_t index) {
+	const size_t len = strlen(dstName);
+	const char *const dot = strrchr(dstName, '.');
+	const size_t stem = dot ? (size_t)(dot - dstName) : len;
+	char *const result = (char *)malloc(len + 24);
+	if ( result ) {
+		sprintf(result, "%.*s-%lu%s", (int)stem, dstName, (unsigned long)index, dstName + stem);
+	}
+	return result;
+}
+
+// Two selectors may pick the same board if they agree up to the end of the shorter one (e.g
+// "1d50:602b" and "1d50:602b:0001"), because the shorter one matches whatever the longer does.
+//
+static bool mayClash(const char *a, const char *b) {
+	while ( *a && *b ) {
+		if ( tolower((unsigned char)*a) != tolower((unsigned char)*b) ) {
+			return false;
+		}
+		a++;
+		b++;
+	}
+	return (*a == '\0' || *a == ':') && (*b == '\0' || *b == ':');
+}
+
+int multiCheck(const char *const *vps, size_t numDevices) {
+	size_t i, j;
+	for ( i = 0; i < numDevices; i++ ) {
+		for ( j = i + 1; j < numDevices; j++ ) {
+			if ( mayClash(vps[i], vps[j]) ) {
+				fprintf(
+					stderr, "Devices %s and %s may be the same board - give each one's VID:PID:DID\n",
+					vps[i], vps[j]);
+				return 5;
+			}
+		}
+	}
+	return 0;
+}
+
+// Do the whole job for one device: open it, flash or dump it, and close it again.
+//
+static void runDevice(void *context, size_t worker, size_t index) {
+	const struct MultiContext *const ctx = (const struct MultiContext *)context;
+	struct DeviceJob *const job = ctx->jobs + index;
+	struct USBDevice *device = NULL;
+	struct Buffer data = {0}, mask = {0}, i2c = {0};
+	const char *error = NULL;
+	int retVal = 0;
+	const double start = poolNow();
+	(void)worker;
+	CHECK_STATUS(usbOpenDevice(job->vp, 1, 0, 0, &device, &error), 7, cleanup);
+	CHECK_STATUS(fx2SetTransferConfig(device, ctx->xferConfig, &error), 38, cleanup);
+	if ( ctx->keepStats ) {
+		CHECK_STATUS(fx2StatsEnable(device, &error), 37, cleanup);
+	}
+	if ( ctx->src == SRC_EEPROM ) {
+		CHECK_STATUS(bufInitialise(&data, 1024, 0x00, &error), 8, cleanup);
+		CHECK_STATUS(bufInitialise(&mask, 1024, 0x00, &error), 9, cleanup);
+		CHECK_STATUS(bufInitialise(&i2c, 1024, 0x00, &error), 10, cleanup);
+		CHECK_STATUS(fx2ReadEEPROMBulk(device, ctx->eepromSize, &i2c, &error), 15, cleanup);
+		retVal = writeFile(ctx->dst, job->dumpFile, &data, &mask, &i2c, I2C_SEG_DEFAULT, &error);
+	} else if ( ctx->dst == DST_RAM ) {
+		retVal = writeRAM(device, ctx->sourceData, ctx->sourceMask, &error);
+	} else {
+		retVal = writeEEPROM(device, ctx->i2cBuffer, ctx->opts, &error);
+	}
+cleanup:
+	job->seconds = poolNow() - start;
+	job->retVal = retVal;
+	job->error = error;
+	if ( device && fx2StatsGet(device, &job->stats) ) {
+		fx2StatsDisable(device);
+	}
+	if ( device ) {
+		int kind;
+		for ( kind = 0; kind < FX2_TRANSFER_NUM_KINDS; kind++ ) {
+			fx2GetTransferTuning(device, (FX2TransferKind)kind, job->tuning + kind);
+		}
+		fx2ClearTransferConfig(device);
+	}
+	usbCloseDevice(device, 0);
+	if ( i2c.data ) {
+		bufDestroy(&i2c);
+	}
+	if ( mask.data ) {
+		bufDestroy(&mask);
+	}
+	if ( data.data ) {
+		bufDestroy(&data);
+	}
+}
+
+int multiRun(
+	Source src, Destination dst, const char *const *vps, size_t numDevices, size_t numThreads,
+	const struct Buffer *sourceData, const struct Buffer *sourceMask,
+	const struct Buffer *i2cBuffer, uint32 eepromSize, const char *dstName, const struct EEPROMOptions *opts,
+	const struct FX2TransferConfig *xferConfig, const char *statsFile)
+{
+	int retVal = 0;
+	size_t i, numFailed = 0;
+	struct MultiContext ctx;
+	struct DeviceJob *const jobs = (struct DeviceJob *)calloc(numDevices, sizeof(struct DeviceJob));
+	if ( !jobs ) {
+		fprintf(stderr, "Unable to allocate device jobs\n");
+		return 30;
+	}
+	for ( i = 0; i < numDevices; i++ ) {
+		jobs[i].vp = vps[i];
+		if ( src == SRC_EEPROM ) {
+			jobs[i].dumpFile = dumpFileName(dstName, i);
+			if ( !jobs[i].dumpFile ) {
+				fprintf(stderr, "Unable to allocate dump file name\n");
+				FAIL_RET(30, cleanup);
+			}
+		}
+	}
+	ctx.src = src;
+	ctx.dst = dst;
+	ctx.sourceData = sourceData;
+	ctx.sourceMask = sourceMask;
+	ctx.i2cBuffer = i2cBuffer;
+	ctx.eepromSize = eepromSize;
+	ctx.opts = opts;
+	ctx.xferConfig = xferConfig;
+	ctx.keepStats = statsFile != NULL;
+	ctx.jobs = jobs;
+	if ( poolRun(numThreads, numDevices, runDevice, &ctx) ) {
+		fprintf(stderr, "Unable to start worker threads\n");
+		FAIL_RET(31, cleanup);
+	}
+
+	// Report each device's result in the order they were given
+	//
+	for ( i = 0; i < numDevices; i++ ) {
+		if ( jobs[i].retVal ) {
+			printf(
+				"[%lu] %s: FAILED (%d) after %.3fs: %s\n", (unsigned long)i, jobs[i].vp,
+				jobs[i].retVal, jobs[i].seconds, jobs[i].error ? jobs[i].error : "unknown error");
+			numFailed++;
+		} else if ( jobs[i].dumpFile ) {
+			printf(
+				"[%lu] %s: OK in %.3fs -> %s\n", (unsigned long)i, jobs[i].vp, jobs[i].seconds,
+				jobs[i].dumpFile);
+		} else {
+			printf("[%lu] %s: OK in %.3fs\n", (unsigned long)i, jobs[i].vp, jobs[i].seconds);
+		}
+	}
+	printf("%lu of %lu devices succeeded\n", (unsigned long)(numDevices - numFailed), (unsigned long)numDevices);
+	if ( numFailed ) {
+		retVal = 32;
+	}
+	if ( statsFile ) {
+		const char **const names = (const char **)malloc(numDevices * sizeof(const char *));
+		struct FX2Stats *const stats = (struct FX2Stats *)malloc(numDevices * sizeof(struct FX2Stats));
+		struct FX2TransferTuning *const tuning = (struct FX2TransferTuning *)malloc(
+			numDevices * FX2_TRANSFER_NUM_KINDS * sizeof(struct FX2TransferTuning));
+		int sStatus = 30;
+		if ( names && stats && tuning ) {
+			for ( i = 0; i < numDevices; i++ ) {
+				names[i] = jobs[i].vp;
+				stats[i] = jobs[i].stats;
+				memcpy(tuning + i * FX2_TRANSFER_NUM_KINDS, jobs[i].tuning, sizeof(jobs[i].tuning));
+			}
+			sStatus = statsWrite(statsFile, names, stats, tuning, numDevices);
+		}
+		free(tuning);
+		free(stats);
+		free(names);
+		if ( sStatus && !retVal ) {
+			retVal = sStatus;
+		}
+	}
+cleanup:
+	for ( i = 0; i < numDevices; i++ ) {
+		if ( jobs[i].error ) {
+			errFree(jobs[i].error);
+		}
+		free(jobs[i].dumpFile);
+	}
+	free(jobs);
+	return retVal;
+}
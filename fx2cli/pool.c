@@ -0,0 +1,95 @@
+/* 
+ * Copyright (C) 2009-2011 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "fx2cli.h"
+
+struct Pool {
+	pthread_mutex_t lock;
+	size_t next;
+	size_t nextWorker;
+	size_t numJobs;
+	PoolFunc func;
+	void *context;
+};
+
+// Each worker repeatedly claims the next unstarted job until there are none left.
+//
+static void *poolWorker(void *arg) {
+	struct Pool *const pool = (struct Pool *)arg;
+	size_t index, worker;
+	pthread_mutex_lock(&pool->lock);
+	worker = pool->nextWorker++;
+	pthread_mutex_unlock(&pool->lock);
+	for ( ;; ) {
+		pthread_mutex_lock(&pool->lock);
+		index = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		if ( index >= pool->numJobs ) {
+			break;
+		}
+		pool->func(pool->context, worker, index);
+	}
+	return NULL;
+}
+
+int poolRun(size_t numThreads, size_t numJobs, PoolFunc func, void *context) {
+	struct Pool pool;
+	pthread_t *threads;
+	size_t i, numStarted = 0;
+	if ( numThreads > numJobs ) {
+		numThreads = numJobs;
+	}
+	if ( numThreads <= 1 ) {
+		for ( i = 0; i < numJobs; i++ ) {
+			func(context, 0, i);
+		}
+		return 0;
+	}
+	threads = (pthread_t *)malloc(numThreads * sizeof(pthread_t));
+	if ( !threads ) {
+		return 1;
+	}
+	pthread_mutex_init(&pool.lock, NULL);
+	pool.next = 0;
+	pool.nextWorker = 0;
+	pool.numJobs = numJobs;
+	pool.func = func;
+	pool.context = context;
+	for ( i = 0; i < numThreads; i++ ) {
+		if ( pthread_create(&threads[i], NULL, poolWorker, &pool) ) {
+			break;
+		}
+		numStarted++;
+	}
+	if ( numStarted == 0 ) {
+		poolWorker(&pool);  // no threads at all, so do the work here
+	}
+	for ( i = 0; i < numStarted; i++ ) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&pool.lock);
+	free(threads);
+	return 0;
+}
+
+double poolNow(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
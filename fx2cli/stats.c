@@ -0,0 +1,91 @@
+/* 
+ * Copyright (C) 2009-2011 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <makestuff/libfx2loader.h>
+#include "fx2cli.h"
+
+static const char *const opNames[FX2_STATS_NUM_OPS] = {
+	"writeRAM", "writeEEPROM", "readEEPROM", "verifyEEPROM", "other"
+};
+
+static const char *const kindNames[FX2_TRANSFER_NUM_KINDS] = {
+	"ram", "eepromWrite", "eepromRead"
+};
+
+static void writeOp(FILE *file, const char *name, const struct FX2OpStats *op, bool isLast) {
+	int i;
+	fprintf(
+		file,
+		"        \"%s\": {\"ops\": %lu, \"failed\": %lu, \"seconds\": %.6f, \"transfers\": %llu, "
+		"\"bytes\": %llu, \"errors\": %lu, \"polls\": %lu, \"transferSeconds\": %.6f, "
+		"\"maxTransferUs\": %.1f, \"histogram\": [",
+		name, (unsigned long)op->numOps, (unsigned long)op->numFailed, (double)op->opNs / 1e9,
+		(unsigned long long)op->numTransfers, (unsigned long long)op->numBytes,
+		(unsigned long)op->numErrors, (unsigned long)op->numPolls,
+		(double)op->transferNs / 1e9, (double)op->maxTransferNs / 1e3);
+	for ( i = 0; i < FX2_STATS_BUCKETS; i++ ) {
+		fprintf(file, i ? ", %lu" : "%lu", (unsigned long)op->histogram[i]);
+	}
+	fprintf(file, "]}%s\n", isLast ? "" : ",");
+}
+
+int statsWrite(
+	const char *fileName, const char *const *names, const struct FX2Stats *stats,
+	const struct FX2TransferTuning *tuning, size_t numDevices)
+{
+	const bool toStdout = !strcmp(fileName, "-");
+	FILE *const file = toStdout ? stdout : fopen(fileName, "w");
+	size_t i;
+	int j, op;
+	if ( !file ) {
+		fprintf(stderr, "Unable to create %s\n", fileName);
+		return 37;
+	}
+
+	// Each histogram count goes with the bucket's upper bound in microseconds; the last bucket is
+	// open-ended
+	fprintf(file, "{\n  \"histogramBoundsUs\": [");
+	for ( j = 0; j < FX2_STATS_BUCKETS - 1; j++ ) {
+		fprintf(file, j ? ", %lu" : "%lu", 1UL << j);
+	}
+	fprintf(file, "],\n  \"devices\": [\n");
+	for ( i = 0; i < numDevices; i++ ) {
+		fprintf(file, "    {\n      \"device\": \"%s\",\n      \"operations\": {\n", names[i]);
+		for ( op = 0; op < FX2_STATS_NUM_OPS; op++ ) {
+			writeOp(file, opNames[op], stats[i].ops + op, op == FX2_STATS_NUM_OPS - 1);
+		}
+		fprintf(file, "      },\n      \"tuning\": {\n");
+		for ( j = 0; j < FX2_TRANSFER_NUM_KINDS; j++ ) {
+			const struct FX2TransferTuning *const t = tuning + i * FX2_TRANSFER_NUM_KINDS + j;
+			fprintf(
+				file,
+				"        \"%s\": {\"chunkSize\": %lu, \"timeoutMs\": %lu, \"bytesPerSecond\": %.0f}%s\n",
+				kindNames[j], (unsigned long)t->chunkSize, (unsigned long)t->timeout,
+				t->bytesPerSecond, j == FX2_TRANSFER_NUM_KINDS - 1 ? "" : ",");
+		}
+		fprintf(file, "      }\n    }%s\n", i + 1 < numDevices ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+	if ( toStdout ) {
+		fflush(file);
+	} else if ( fclose(file) ) {
+		fprintf(stderr, "Unable to write %s\n", fileName);
+		return 37;
+	}
+	return 0;
+}
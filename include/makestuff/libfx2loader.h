@@ -49,7 +49,9 @@ extern "C" {
 	typedef enum {
 		FX2_SUCCESS = 0,  ///< The operation completed successfully.
 		FX2_USB_ERR,      ///< A USB error occurred.
-		FX2_BUF_ERR       ///< A buffer error occurred, probably an allocation error.
+		FX2_BUF_ERR,      ///< A buffer error occurred, probably an allocation error.
+		FX2_SYS_ERR,      ///< An operating-system error occurred (e.g creating a thread or pipe).
+		FX2_CANCELLED     ///< The operation was stopped through its \c FX2CancelToken.
 	} FX2Status;
 
 	/**
@@ -59,8 +61,53 @@ extern "C" {
 		I2C_SUCCESS = 0,           ///< The operation completed successfully.
 		I2C_BUFFER_ERROR,          ///< A buffer error occurred, probably an allocation error.
 		I2C_NOT_INITIALISED,       ///< The operation expected an initialised I2C buffer.
-		I2C_DEST_BUFFER_NOT_EMPTY  ///< The destination buffer already has some data in it.
+		I2C_DEST_BUFFER_NOT_EMPTY, ///< The destination buffer already has some data in it.
+		I2C_FILE_ERROR             ///< A file could not be read, created or written.
 	} I2CStatus;
+
+	/**
+	 * Return codes from the Intel HEX functions.
+	 */
+	typedef enum {
+		HEX_SUCCESS = 0,    ///< The operation completed successfully.
+		HEX_BUFFER_ERROR,   ///< A buffer error occurred, probably an allocation error.
+		HEX_FILE_ERROR,     ///< A file could not be read, created or written.
+		HEX_SYNTAX_ERROR,   ///< The text is not valid Intel HEX.
+		HEX_CHECKSUM_ERROR  ///< A record's checksum did not match its contents.
+	} HexStatus;
+
+	/**
+	 * How \c i2cWritePromRecordsEx() divides the data into C2 records.
+	 */
+	typedef enum {
+		I2C_SEG_DEFAULT = 0,  ///< Split only on runs of four or more holes (as \c i2cWritePromRecords()).
+		I2C_SEG_MIN_BYTES,    ///< The smallest possible image, counting four bytes per record header.
+		I2C_SEG_MIN_RECORDS,  ///< The fewest possible records; ties are broken on image size.
+		I2C_SEG_MIN_BOOT_TIME ///< The shortest boot under the nominal \c I2CBootModel.
+	} I2CSegmentation;
+
+	/**
+	 * The kinds of operation \c fx2StatsGet() keeps separate statistics for.
+	 */
+	typedef enum {
+		FX2_STATS_WRITE_RAM = 0,  ///< \c fx2WriteRAM() and \c fx2WriteRAMAsync().
+		FX2_STATS_WRITE_EEPROM,   ///< The \c fx2WriteEEPROM*() functions.
+		FX2_STATS_READ_EEPROM,    ///< The \c fx2ReadEEPROM*() functions.
+		FX2_STATS_VERIFY_EEPROM,  ///< \c fx2CrcEEPROM() and \c fx2VerifyEEPROM().
+		FX2_STATS_OTHER,          ///< Transfers outside any of the above (e.g configuration).
+		FX2_STATS_NUM_OPS
+	} FX2StatsOp;
+
+	/**
+	 * The kinds of chunked transfer which \c fx2SetTransferConfig() tunes separately, since their
+	 * speeds differ by orders of magnitude.
+	 */
+	typedef enum {
+		FX2_TRANSFER_RAM = 0,         ///< Writes to the FX2LP's RAM through its built-in loader.
+		FX2_TRANSFER_EEPROM_WRITE,    ///< Writes to the EEPROM through the firmware.
+		FX2_TRANSFER_EEPROM_READ,     ///< Reads from the EEPROM through the firmware.
+		FX2_TRANSFER_NUM_KINDS
+	} FX2TransferKind;
 	//@}
 
 	/**
@@ -72,12 +119,243 @@ extern "C" {
 	 */
 	#define CONFIG_BYTE_400KHZ (1<<0)
 
+	/**
+	 * The EEPROM page size assumed when none is given: 64 bytes, as on the 24LC128.
+	 */
+	#define FX2_DEFAULT_PAGE_SIZE 64
+
+	/**
+	 * Feature flag from \c fx2GetEEPROMConfig(): the firmware gathers EEPROM writes into whole
+	 * pages, so each page is programmed in a single write cycle.
+	 */
+	#define FX2_FEATURE_PAGE_WRITE (1<<0)
+
+	/**
+	 * Feature flag from \c fx2GetEEPROMConfig(): the firmware can program the EEPROM from data
+	 * streamed over the EP2OUT bulk endpoint. See \c fx2WriteEEPROMBulk().
+	 */
+	#define FX2_FEATURE_BULK_WRITE (1<<1)
+
+	/**
+	 * Feature flag from \c fx2GetEEPROMConfig(): the firmware can stream EEPROM contents out over
+	 * the EP4IN bulk endpoint using one sequential read. See \c fx2ReadEEPROMBulk().
+	 */
+	#define FX2_FEATURE_BULK_READ (1<<2)
+
+	/**
+	 * Feature flag from \c fx2GetEEPROMConfig(): the firmware honours the bank number in
+	 * \c wIndex (the block-select bit on 24LC1025-style parts), so EEPROMs larger than 64KiB can
+	 * be read and written in full. Without it, transfers larger than 64KiB are refused.
+	 */
+	#define FX2_FEATURE_BANKS (1<<3)
+
+	/**
+	 * Feature flag from \c fx2GetEEPROMConfig(): the firmware can calculate a CRC32 over a range of
+	 * the EEPROM. See \c fx2CrcEEPROM().
+	 */
+	#define FX2_FEATURE_CRC32 (1<<4)
+
+	/**
+	 * The EEPROM configuration reported by the firmware.
+	 */
+	struct FX2EEPROMConfig {
+		uint16 pageSize;  ///< The EEPROM page size in bytes.
+		uint16 features;  ///< A bitwise OR of the \c FX2_FEATURE_* flags the firmware supports.
+	};
+
+	/**
+	 * One record of a C2 (\c .iic) image, pointing into the image rather than copying it.
+	 */
+	struct I2CRecord {
+		uint16 address;      ///< The FX2LP RAM address the record loads to.
+		uint16 length;       ///< The number of payload bytes (at most 1023).
+		const uint8 *data;   ///< The payload, within the image being iterated over.
+	};
+
+	/**
+	 * A cursor over the records of a C2 (\c .iic) image. Set up with \c i2cIterInit(); the public
+	 * fields are valid as soon as that returns successfully.
+	 */
+	struct I2CRecordIter {
+		uint16 vid;                 ///< The Vendor ID from the header.
+		uint16 pid;                 ///< The Product ID from the header.
+		uint16 did;                 ///< The Device ID from the header.
+		uint8 configByte;           ///< The configuration byte from the header.
+		bool hasTerminator;         ///< Whether the image has a terminating (reset) record.
+		struct I2CRecord terminator;  ///< The terminating record, if \c hasTerminator.
+		const uint8 *trailing;      ///< Any bytes after the terminating record (e.g unused EEPROM).
+		size_t trailingLength;      ///< The number of trailing bytes.
+		size_t numRecords;          ///< The number of data records (excluding the terminator).
+		const uint8 *next;          ///< Private: the next record to return.
+		const uint8 *end;           ///< Private: the end of the records.
+	};
+
+	/**
+	 * Timings used to estimate how long the FX2LP's C2 boot loader takes to load an image. The
+	 * defaults from \c i2cDefaultBootModel() are nominal; for a customer-facing figure, measure one
+	 * board with a scope and adjust \c startupNs and \c recordNs to match.
+	 */
+	struct I2CBootModel {
+		uint32 startupNs;   ///< Power-on to the first I2C transaction (RESET# hold, oscillator start).
+		uint32 byteNs100k;  ///< The time to read one byte at 100kHz (nine bit-times).
+		uint32 byteNs400k;  ///< The time to read one byte at 400kHz (nine bit-times).
+		uint32 recordNs;    ///< The loader's processing overhead per record, beyond the I2C reads.
+		bool fastI2C;       ///< Whether the board and EEPROM can run the bus at 400kHz.
+	};
+
+	/**
+	 * The timing model of a simulated FX2LP (see \c fx2SimCreate()). Each transfer advances the
+	 * simulated clock; nothing actually waits unless \c realTime is set.
+	 */
+	struct FX2SimTiming {
+		uint32 transferNs;    ///< Fixed cost of each USB transfer (setup, status and scheduling).
+		uint32 byteNs;        ///< USB cost of each byte in a transfer's data stage.
+		uint32 i2cClockHz;    ///< The I2C clock between the FX2LP and its EEPROM.
+		uint32 pageWriteNs;   ///< The EEPROM's internal write cycle (tWC), once per page write.
+		uint32 renumerateNs;  ///< Time from releasing the 8051 to the new firmware being usable.
+		bool realTime;        ///< Also sleep for each modelled delay, for wall-clock benchmarks.
+	};
+
+	/**
+	 * The configuration of a simulated FX2LP. Start from \c fx2SimDefaultConfig().
+	 */
+	struct FX2SimConfig {
+		uint32 eepromSize;      ///< The size of the emulated 24LCxx EEPROM in bytes.
+		uint16 eepromPageSize;  ///< The EEPROM's physical page size; longer writes wrap around.
+		bool firmwareRunning;   ///< Whether the EEPROM firmware is already running at creation.
+		struct FX2SimTiming timing;  ///< How long everything takes.
+	};
+
+	/**
+	 * What a simulated FX2LP has done since it was created, or since \c fx2SimResetStats().
+	 */
+	struct FX2SimStats {
+		uint64 elapsedNs;        ///< Simulated time spent in transfers, I2C and renumeration.
+		uint32 numTransfers;     ///< USB transfers handled, including stalled ones.
+		uint64 numBytes;         ///< Bytes carried by the transfers' data stages.
+		uint32 numPageWrites;    ///< EEPROM write cycles.
+		uint32 numRenumerations; ///< Times the 8051 was released from reset into new firmware.
+	};
+
+	/**
+	 * The number of buckets in an \c FX2OpStats latency histogram. Bucket zero counts transfers
+	 * under 1us, bucket \c i counts those taking [2<sup>i-1</sup>, 2<sup>i</sup>)us, and the last
+	 * bucket counts everything from 2<sup>FX2_STATS_BUCKETS-2</sup>us (262ms) up.
+	 */
+	#define FX2_STATS_BUCKETS 20
+
+	/**
+	 * Statistics for one kind of operation on one device. Times are wall-clock nanoseconds.
+	 */
+	struct FX2OpStats {
+		uint32 numOps;          ///< Operations completed.
+		uint32 numFailed;       ///< Operations which returned an error.
+		uint64 opNs;            ///< Total time spent in the operations.
+		uint64 numTransfers;    ///< USB transfers issued, including failed ones.
+		uint64 numBytes;        ///< Bytes carried by the successful transfers.
+		uint32 numErrors;       ///< Transfers which failed (timeouts, stalls, disconnects).
+		uint32 numPolls;        ///< Status polls while waiting for the firmware to finish.
+		uint64 transferNs;      ///< Total time spent in transfers.
+		uint64 maxTransferNs;   ///< The slowest single transfer.
+		uint32 histogram[FX2_STATS_BUCKETS];  ///< Transfer latencies; see \c FX2_STATS_BUCKETS.
+	};
+
+	/**
+	 * Statistics for one device, as returned by \c fx2StatsGet().
+	 */
+	struct FX2Stats {
+		struct FX2OpStats ops[FX2_STATS_NUM_OPS];  ///< Indexed by \c FX2StatsOp.
+	};
+
+	/**
+	 * Where a long-running operation has got to, as passed to an \c FX2ProgressFunc.
+	 */
+	struct FX2Progress {
+		uint32 bytesDone;       ///< Bytes transferred so far.
+		uint32 bytesTotal;      ///< Bytes in the whole operation.
+		double bytesPerSecond;  ///< Current throughput, smoothed over the last few chunks.
+		double secondsLeft;     ///< Estimated time to completion at the current throughput.
+	};
+
+	/**
+	 * Progress callback for the \c fx2*Ex() functions. It is invoked on the calling thread after
+	 * each chunk is transferred.
+	 *
+	 * @param progress Where the operation has got to.
+	 * @param context The \c context pointer from the \c FX2Monitor.
+	 */
+	typedef void (*FX2ProgressFunc)(const struct FX2Progress *progress, void *context);
+
+	// Opaque cancellation flag, shared between an operation and whoever may want to stop it
+	struct FX2CancelToken;
+
+	/**
+	 * How a caller watches and controls one of the \c fx2*Ex() functions. Any field may be zero.
+	 */
+	struct FX2Monitor {
+		FX2ProgressFunc progress;       ///< Called after each chunk, or \c NULL.
+		void *context;                  ///< Passed to \c progress.
+		struct FX2CancelToken *cancel;  ///< Checked before each chunk, or \c NULL.
+		uint32 timeout;                 ///< Per-chunk timeout in milliseconds, or zero for the device's.
+	};
+
+	/**
+	 * The smallest and largest chunks the library will transfer. Chunk sizes are always powers of
+	 * two, so chunks never straddle an EEPROM page or bank. Chunks are control transfers, and
+	 * Linux usbfs refuses any longer than 4KiB.
+	 */
+	#define FX2_CHUNK_MIN 512
+	#define FX2_CHUNK_MAX 4096
+
+	/**
+	 * How a device's chunked transfers are sized and timed, as given to \c fx2SetTransferConfig().
+	 */
+	struct FX2TransferConfig {
+		uint32 chunkSize;  ///< Bytes per chunk, or zero to tune it from the measured throughput.
+		uint32 timeout;    ///< Per-chunk timeout in milliseconds, or zero to derive it.
+	};
+
+	/**
+	 * The settings one kind of transfer to a device is currently using, from
+	 * \c fx2GetTransferTuning().
+	 */
+	struct FX2TransferTuning {
+		uint32 chunkSize;       ///< Bytes per chunk.
+		uint32 timeout;         ///< Per-chunk timeout in milliseconds.
+		double bytesPerSecond;  ///< Measured throughput at that chunk size, or zero if unknown.
+	};
+
+	/**
+	 * A contiguous piece of a firmware image, for \c fx2WriteRAMSegments().
+	 */
+	struct FX2Segment {
+		uint32 address;     ///< Where the segment goes in the FX2LP's RAM.
+		const uint8 *data;  ///< The segment's bytes.
+		uint32 length;      ///< The number of bytes.
+	};
+
 	// Forward-declaration of the LibUSB handle
 	struct USBDevice;
 
 	// Forward-declaration of the Buffer struct
 	struct Buffer;
 
+	// Opaque handle to an in-flight asynchronous operation
+	struct FX2Operation;
+
+	// Opaque handle to a simulated FX2LP
+	struct FX2Sim;
+
+	/**
+	 * Completion callback for the asynchronous operations. It is invoked exactly once, on the
+	 * caller's thread, from within \c fx2OpPoll() or \c fx2OpWait().
+	 *
+	 * @param op The operation which has just completed.
+	 * @param status The result of the operation.
+	 * @param context The context pointer supplied when the operation was submitted.
+	 */
+	typedef void (*FX2Callback)(struct FX2Operation *op, FX2Status status, void *context);
+
 	// ---------------------------------------------------------------------------------------------
 	// Firmware Operations
 	// ---------------------------------------------------------------------------------------------
@@ -107,12 +385,100 @@ extern "C" {
 		struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes, const char **error
 	) WARN_UNUSED_RESULT;
 
+	/**
+	 * @brief As \c fx2WriteRAM(), but uploading only the bytes the mask marks as defined.
+	 *
+	 * Runs of defined bytes separated by short gaps are uploaded together, gap and all, since a
+	 * short gap costs less than starting another control transfer; longer gaps are skipped. For a
+	 * sparse image, such as one read from an SDCC .hex file, this uploads far fewer bytes.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param bufPtr A pointer to the image, starting at address 0x0000.
+	 * @param maskPtr A pointer to the mask: nonzero for each defined byte of the image.
+	 * @param numBytes The length of the image and of the mask.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred.
+	 */
+	DLLEXPORT(FX2Status) fx2WriteRAMMasked(
+		struct USBDevice *device, const uint8 *bufPtr, const uint8 *maskPtr, uint32 numBytes,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief As \c fx2WriteRAM(), but gathering the firmware from a list of segments.
+	 *
+	 * The segments may be given in any order, but must not overlap or extend beyond 64KiB.
+	 * Segments separated by short gaps are uploaded together (the gaps being filled with zeros),
+	 * and the rest are uploaded separately, each straight from the caller's memory.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param segments The segments to upload.
+	 * @param numSegments The number of segments.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred.
+	 *     - \c FX2_BUF_ERR if the segments overlap or are out of range, or an allocation error
+	 *       occurred.
+	 */
+	DLLEXPORT(FX2Status) fx2WriteRAMSegments(
+		struct USBDevice *device, const struct FX2Segment *segments, uint32 numSegments,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Wait for the FX2LP to renumerate after a RAM load, and reopen it.
+	 *
+	 * After \c fx2WriteRAM() (or one of its variants) starts the new firmware, the device drops
+	 * off the bus and comes back with the new firmware's descriptors. This closes the old handle,
+	 * waits for the old device to disappear if the new firmware has the same VID:PID, then opens
+	 * the new device as soon as it appears, polling every few milliseconds rather than sleeping
+	 * for a guessed delay. The device is opened as by
+	 * <code>usbOpenDevice(vp, 1, 0, 0, ...)</code>. Any statistics or transfer configuration
+	 * follow the device to its new handle.
+	 *
+	 * The board is only ever identified by \c vp, because libusbwrap cannot select a device by
+	 * its bus and port, so the loaded board must be the only attached device which matches
+	 * \c vp. If another one matches (identical boards normally share a DID as well as a VID:PID,
+	 * so a VID:PID:DID selector does not help), the wait for the old device to disappear runs
+	 * out and whichever match libusbwrap finds first is opened, with the statistics and transfer
+	 * configuration moved onto it. A simulated device (see \c fx2SimDevice()) has already
+	 * renumerated by the time \c fx2WriteRAM() returns, so its handle is kept as it is.
+	 *
+	 * @param device A pointer to the handle of the device which was loaded. On success it is set
+	 *            to the new handle; on failure it is set to \c NULL.
+	 * @param vp The VID:PID (or VID:PID:DID) the new firmware enumerates as.
+	 * @param timeout How long to wait, in milliseconds.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if the device did not reappear in time, or could not be opened.
+	 */
+	DLLEXPORT(FX2Status) fx2AwaitRenumeration(
+		struct USBDevice **device, const char *vp, uint32 timeout, const char **error
+	) WARN_UNUSED_RESULT;
+
 	/**
 	 * @brief Write a block of data to the FX2LP's external EEPROM.
 	 *
 	 * Write a block of raw bytes to the FX2LP's external EEPROM (if present). Note that if you want
 	 * to write bootable code, it must conform to the FX2LP's C2 loader format. You can prepare such
-	 * an I2C buffer using \c i2cWritePromRecords().
+	 * an I2C buffer using \c i2cWritePromRecords(). Writes larger than 64KiB are only allowed if
+	 * the firmware advertises \c FX2_FEATURE_BANKS.
 	 *
 	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
 	 * @param bufPtr A pointer to the block of bytes to write to EEPROM.
@@ -154,123 +520,1133 @@ extern "C" {
 	DLLEXPORT(FX2Status) fx2ReadEEPROM(
 		struct USBDevice *device, uint32 numBytes, struct Buffer *i2cBuffer, const char **error
 	) WARN_UNUSED_RESULT;
-	//@}
 
-	// ---------------------------------------------------------------------------------------------
-	// I2C Operations
-	// ---------------------------------------------------------------------------------------------
-	/**
-	 * @name I2C Operations
-	 * @{
-	 */
 	/**
-	 * @brief Initialise an I2C buffer.
+	 * @brief Write a block of data to the FX2LP's external EEPROM, skipping unchanged pages.
 	 *
-	 * Prepare a <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
-	 * with the FX2LP \c 0xC2 header. See TRM section 3.4.3.
+	 * Compare the new data with the EEPROM's current contents a page at a time, and write only the
+	 * runs of pages which differ. The current contents may be supplied by the caller (e.g a copy
+	 * cached from a previous read or write); if not, they are read back from the EEPROM first.
+	 * Since unchanged pages are never rewritten, this also reduces EEPROM wear.
 	 *
-	 * @param buf The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
-	 *            to be initialised.
-	 * @param vid The Vendor ID to use in the header (usually \c 0x0000 for C2 loaders).
-	 * @param pid the Product ID to use in the header (usually \c 0x0000 for C2 loaders).
-	 * @param did the Device ID to use in the header (usually \c 0x0000 for C2 loaders).
-	 * @param configByte The configuration byte to use. See TRM section 3.5.
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param bufPtr A pointer to the block of bytes to write to EEPROM.
+	 * @param numBytes The number of bytes to write to EEPROM.
+	 * @param current A pointer to \c numBytes bytes known to match the EEPROM's current contents,
+	 *            or \c NULL to read them back from the EEPROM.
+	 * @param pageSize The EEPROM's page size in bytes, or zero for \c FX2_DEFAULT_PAGE_SIZE.
+	 * @param bytesWritten An optional pointer which will be set on exit to the number of bytes
+	 *            actually written.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
 	 */
-	DLLEXPORT(void) i2cInitialise(
-		struct Buffer *buf, uint16 vid, uint16 pid, uint16 did, uint8 configByte
-	);
+	DLLEXPORT(FX2Status) fx2WriteEEPROMDiff(
+		struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes, const uint8 *current,
+		uint32 pageSize, uint32 *bytesWritten, const char **error
+	) WARN_UNUSED_RESULT;
 
 	/**
-	 * @brief Populate an I2C buffer with supplied data, respecting the supplied mask.
-	 *
-	 * Given a data buffer and a mask buffer, this function will write I2C records to the
-	 * destination buffer ready for writing to EEPROM or to an i2c file. The mask buffer contains
-	 * \c 0x00 where there is useful data at the corresponding offset into the data buffer and
-	 * \c 0x01 where there is a corresponding "hole" (i.e undefined bytes) in the data buffer.
+	 * @brief Write a block of data to the FX2LP's external EEPROM over the EP2OUT bulk endpoint.
 	 *
-	 * The destination buffer should have been initialised with \c i2cInitialise() and should be
-	 * finalised with \c i2cFinalise() after this function completes.
+	 * This has the same effect as \c fx2WriteEEPROM(), but if the firmware advertises
+	 * \c FX2_FEATURE_BULK_WRITE the data is streamed in 512-byte bulk packets and programmed
+	 * straight from the endpoint buffers, avoiding the per-packet overhead of EP0. The function
+	 * returns when the firmware has finished programming. If the firmware does not support bulk
+	 * writes, this silently falls back to \c fx2WriteEEPROM().
 	 *
-	 * @param destination The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
-	 *            to write the I2C records to.
-	 * @param sourceData The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
-	 *            to read the data from.
-	 * @param sourceMask The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
-	 *            from which to read the mask for the source data.
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param bufPtr A pointer to the block of bytes to write to EEPROM.
+	 * @param numBytes The number of bytes to write to EEPROM.
 	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
 	 *            error message if something goes wrong. Responsibility for this allocated memory
 	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
 	 *            \c NULL, no allocation is done and no message is returned, but the return code
 	 *            will still be valid.
 	 * @returns
-	 *     - \c I2C_SUCCESS if the operation completed successfully.
-	 *     - \c I2C_NOT_INITIALISED if the supplied destination buffer was uninitialised.
-	 *     - \c I2C_BUFFER_ERROR if an allocation error occurred.
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred, or the firmware reported an I2C error.
 	 */
-	DLLEXPORT(I2CStatus) i2cWritePromRecords(
-		struct Buffer *destination, const struct Buffer *sourceData,
-		const struct Buffer *sourceMask, const char **error
+	DLLEXPORT(FX2Status) fx2WriteEEPROMBulk(
+		struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes, const char **error
 	) WARN_UNUSED_RESULT;
 
 	/**
-	 * @brief Extract linear data and mask buffers from a supplied I2C buffer.
+	 * @brief Read a block of data from the FX2LP's external EEPROM over the EP4IN bulk endpoint.
 	 *
-	 * Given a buffer containing I2C records (e.g from an i2c file or read from EEPROM), this
-	 * function will populate two buffers, a data buffer and a mask buffer.  The mask buffer
-	 * contains \c 0x00 where there is useful data at the corresponding offset into the data buffer
-	 * and \c 0x01 where there is a corresponding "hole" (i.e undefined bytes) in the data buffer.
+	 * This has the same effect as \c fx2ReadEEPROM(), but if the firmware advertises
+	 * \c FX2_FEATURE_BULK_READ it performs one continuous sequential I2C read and streams the
+	 * bytes out in 512-byte bulk packets, so the transfer is limited by the I2C clock rather than by
+	 * control-transfer overhead. If the firmware does not support streaming reads, this silently
+	 * falls back to \c fx2ReadEEPROM().
 	 *
-	 * @param destData The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
-	 *            to write the data bytes to.
-	 * @param destMask The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
-	 *            to write the mask bytes to.
-	 * @param source The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
-	 *            from which to read the I2C records.
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param numBytes The number of bytes to read from EEPROM.
+	 * @param i2cBuffer A <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to be populated with the data read from EEPROM.
 	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
 	 *            error message if something goes wrong. Responsibility for this allocated memory
 	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
 	 *            \c NULL, no allocation is done and no message is returned, but the return code
 	 *            will still be valid.
 	 * @returns
-	 *     - \c I2C_SUCCESS if the operation completed successfully.
-	 *     - \c I2C_NOT_INITIALISED if the supplied I2C buffer was invalid.
-	 *     - \c I2C_BUFFER_ERROR if an allocation error occurred.
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
 	 */
-	DLLEXPORT(I2CStatus) i2cReadPromRecords(
-		struct Buffer *destData, struct Buffer *destMask, const struct Buffer *source,
-		const char **error
+	DLLEXPORT(FX2Status) fx2ReadEEPROMBulk(
+		struct USBDevice *device, uint32 numBytes, struct Buffer *i2cBuffer, const char **error
 	) WARN_UNUSED_RESULT;
 
 	/**
-	 * @brief Append a termination record to the end of the supplied I2C buffer.
+	 * @brief As \c fx2ReadEEPROMBulk(), but into caller-provided memory rather than a \c Buffer.
 	 *
-	 * The TRM (section 3.4.3) defines a specific record terminator for the \c 0xC2 loader format,
-	 * which executes a write of \c 0x00 to the CPU reset register at -c 0xE600. This function
-	 * writes that record terminator, thus marking the end of the I2C records to be read on startup.
+	 * The bytes are written straight into \c bufPtr, so a caller dumping many EEPROMs can reuse
+	 * one arena (or read directly into a mapped output file) with no allocation or zero-filling.
 	 *
-	 * @param buf The I2C <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
-	 *            to finalise.
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param bufPtr Where to put the data; at least \c numBytes long.
+	 * @param numBytes The number of bytes to read from EEPROM.
 	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
 	 *            error message if something goes wrong. Responsibility for this allocated memory
 	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
 	 *            \c NULL, no allocation is done and no message is returned, but the return code
 	 *            will still be valid.
 	 * @returns
-	 *     - \c I2C_SUCCESS if the operation completed successfully.
-	 *     - \c I2C_NOT_INITIALISED if the supplied I2C buffer was invalid.
-	 *     - \c I2C_BUFFER_ERROR if an allocation error occurred.
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred.
 	 */
-	DLLEXPORT(I2CStatus) i2cFinalise(
-		struct Buffer *buf, const char **error
+	DLLEXPORT(FX2Status) fx2ReadEEPROMBulkInto(
+		struct USBDevice *device, uint8 *bufPtr, uint32 numBytes, const char **error
 	) WARN_UNUSED_RESULT;
-	//@}
 
-	// ---------------------------------------------------------------------------------------------
-	// Miscellaneous functions
-	// ---------------------------------------------------------------------------------------------
 	/**
-	 * @name Miscellaneous Functions
-	 * @{
+	 * @brief Calculate the CRC32 of a range of the FX2LP's external EEPROM.
+	 *
+	 * If the firmware advertises \c FX2_FEATURE_CRC32, the CRC is calculated on the device using
+	 * one sequential read, so only a few bytes cross the bus. Otherwise, for ranges starting at
+	 * address zero, the range is read back and the CRC is calculated on the host. The CRC is the
+	 * usual IEEE 802.3 one, as calculated by \c fx2Crc32().
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param address The EEPROM address to start at.
+	 * @param numBytes The number of bytes to include in the CRC.
+	 * @param crc A pointer to a \c uint32 which will be set on exit to the CRC.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred, or \c address is nonzero and the firmware
+	 *       cannot calculate CRCs.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
+	 */
+	DLLEXPORT(FX2Status) fx2CrcEEPROM(
+		struct USBDevice *device, uint32 address, uint32 numBytes, uint32 *crc, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Check that the FX2LP's external EEPROM starts with the supplied data.
+	 *
+	 * Compares the CRC32 of the first \c numBytes bytes of EEPROM (see \c fx2CrcEEPROM()) with
+	 * the CRC32 of the supplied data. This is cheap enough to run after every write.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param bufPtr A pointer to the data expected to be in the EEPROM (e.g an \c .iic image).
+	 * @param numBytes The number of bytes to compare.
+	 * @param isMatch A pointer to a \c bool which will be set on exit to \c true if the CRCs
+	 *            matched, else \c false.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the CRCs were compared (check \c isMatch for the result).
+	 *     - \c FX2_USB_ERR if a USB error occurred.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
+	 */
+	DLLEXPORT(FX2Status) fx2VerifyEEPROM(
+		struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes, bool *isMatch,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Query the firmware's EEPROM page size and supported features.
+	 *
+	 * Firmwares which predate this command (including the FX2LP's built-in boot firmware) will
+	 * fail with \c FX2_USB_ERR; callers should then assume \c FX2_DEFAULT_PAGE_SIZE and no
+	 * optional features.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param config A pointer to a struct to be populated with the firmware's configuration.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred, or the firmware does not support the command.
+	 */
+	DLLEXPORT(FX2Status) fx2GetEEPROMConfig(
+		struct USBDevice *device, struct FX2EEPROMConfig *config, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Tell the firmware what page size the attached EEPROM has.
+	 *
+	 * The page size must be a power of two no larger than 128 bytes (e.g 32 for a 24LC32, 64 for
+	 * a 24LC128, 128 for a 24LC512).
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param pageSize The EEPROM's page size in bytes.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred, or the firmware rejected the page size.
+	 */
+	DLLEXPORT(FX2Status) fx2SetEEPROMPageSize(
+		struct USBDevice *device, uint16 pageSize, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief As \c fx2WriteRAM(), but with progress reporting and cancellation.
+	 *
+	 * The data is written in chunks; before each one the cancellation token is checked, and after
+	 * each one the progress callback is invoked. If cancelled, the 8051 is left in reset, so a
+	 * partial firmware never runs.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param bufPtr A pointer to the block of bytes to write to RAM.
+	 * @param numBytes The number of bytes to write to RAM.
+	 * @param monitor The progress callback, cancellation token and timeout, or \c NULL.
+	 * @param bytesDone A pointer to a \c uint32 which will be set on exit to the number of bytes
+	 *            written, even on failure or cancellation, or \c NULL.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred.
+	 *     - \c FX2_CANCELLED if the operation was cancelled.
+	 */
+	DLLEXPORT(FX2Status) fx2WriteRAMEx(
+		struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes,
+		const struct FX2Monitor *monitor, uint32 *bytesDone, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief As \c fx2WriteEEPROM(), but with progress reporting and cancellation.
+	 *
+	 * The data is written in chunks; before each one the cancellation token is checked, and after
+	 * each one the progress callback is invoked. Cancellation only takes effect between chunks,
+	 * so a cancelled write leaves exactly the first \c *bytesDone bytes of the EEPROM programmed,
+	 * and writing the rest can resume from there. If a chunk fails, the first \c *bytesDone bytes
+	 * have been programmed but some of the failed chunk may have been too, so the contents beyond
+	 * \c *bytesDone are unknown.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param bufPtr A pointer to the block of bytes to write to EEPROM.
+	 * @param numBytes The number of bytes to write to EEPROM.
+	 * @param monitor The progress callback, cancellation token and timeout, or \c NULL.
+	 * @param bytesDone A pointer to a \c uint32 which will be set on exit to the number of bytes
+	 *            written, even on failure or cancellation, or \c NULL.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred.
+	 *     - \c FX2_CANCELLED if the operation was cancelled.
+	 */
+	DLLEXPORT(FX2Status) fx2WriteEEPROMEx(
+		struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes,
+		const struct FX2Monitor *monitor, uint32 *bytesDone, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief As \c fx2ReadEEPROM(), but with progress reporting and cancellation.
+	 *
+	 * If the read stops early, only the bytes actually read are appended to \c i2cBuffer.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param numBytes The number of bytes to read from the EEPROM.
+	 * @param i2cBuffer The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to append the EEPROM's contents to.
+	 * @param monitor The progress callback, cancellation token and timeout, or \c NULL.
+	 * @param bytesDone A pointer to a \c uint32 which will be set on exit to the number of bytes
+	 *            read, even on failure or cancellation, or \c NULL.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
+	 *     - \c FX2_CANCELLED if the operation was cancelled.
+	 */
+	DLLEXPORT(FX2Status) fx2ReadEEPROMEx(
+		struct USBDevice *device, uint32 numBytes, struct Buffer *i2cBuffer,
+		const struct FX2Monitor *monitor, uint32 *bytesDone, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief As \c fx2ReadEEPROMEx(), but into caller-provided memory rather than a \c Buffer.
+	 *
+	 * The bytes are written straight into \c bufPtr, with no allocation or zero-filling. If the
+	 * read stops early, only the first \c *bytesDone bytes of \c bufPtr are valid.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param bufPtr Where to put the data; at least \c numBytes long.
+	 * @param numBytes The number of bytes to read from the EEPROM.
+	 * @param monitor The progress callback, cancellation token and timeout, or \c NULL.
+	 * @param bytesDone A pointer to a \c uint32 which will be set on exit to the number of bytes
+	 *            read, even on failure or cancellation, or \c NULL.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_USB_ERR if a USB error occurred.
+	 *     - \c FX2_CANCELLED if the operation was cancelled.
+	 */
+	DLLEXPORT(FX2Status) fx2ReadEEPROMInto(
+		struct USBDevice *device, uint8 *bufPtr, uint32 numBytes,
+		const struct FX2Monitor *monitor, uint32 *bytesDone, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Create a cancellation token for the \c fx2*Ex() functions.
+	 *
+	 * A token may be shared by several operations, and cancelled from any thread (or from a
+	 * progress callback).
+	 *
+	 * @param token A pointer to an <code>FX2CancelToken*</code> which will be set on exit to the
+	 *            new token. Free it with \c fx2CancelFree().
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
+	 */
+	DLLEXPORT(FX2Status) fx2CancelCreate(
+		struct FX2CancelToken **token, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Ask every operation using the token to stop before its next chunk.
+	 *
+	 * @param token The token to cancel.
+	 */
+	DLLEXPORT(void) fx2CancelRequest(struct FX2CancelToken *token);
+
+	/**
+	 * @brief Find out whether the token has been cancelled.
+	 *
+	 * @param token The token to check.
+	 * @returns \c true if \c fx2CancelRequest() has been called since the token was created or
+	 *          last reset.
+	 */
+	DLLEXPORT(bool) fx2CancelRequested(struct FX2CancelToken *token);
+
+	/**
+	 * @brief Clear the token, so it can be used for another operation.
+	 *
+	 * @param token The token to reset.
+	 */
+	DLLEXPORT(void) fx2CancelReset(struct FX2CancelToken *token);
+
+	/**
+	 * @brief Free a token. No operation may still be using it.
+	 *
+	 * @param token The token to free, or \c NULL.
+	 */
+	DLLEXPORT(void) fx2CancelFree(struct FX2CancelToken *token);
+	//@}
+
+	// ---------------------------------------------------------------------------------------------
+	// Asynchronous Operations
+	// ---------------------------------------------------------------------------------------------
+	/**
+	 * @name Asynchronous Operations
+	 * @{
+	 */
+	/**
+	 * @brief Start writing a new firmware to the FX2LP's RAM without blocking.
+	 *
+	 * This does the same job as \c fx2WriteRAM(), but returns as soon as the operation has been
+	 * submitted. The usual synchronous chunk transfers run on a worker thread, one after another,
+	 * so the caller's thread is free to service other devices meanwhile. Completion is reported through
+	 * \c fx2OpPoll() (typically when \c fx2OpGetFd() becomes readable) or \c fx2OpWait(). Only one
+	 * operation may be in flight on a given device at a time, and the data must remain valid until
+	 * the operation completes.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param bufPtr A pointer to the block of bytes to write to RAM.
+	 * @param numBytes The number of bytes to write to RAM.
+	 * @param callback An optional function to call when the operation completes, or \c NULL.
+	 * @param context An arbitrary pointer passed back to \c callback.
+	 * @param op A pointer to a <code>struct FX2Operation*</code> which will be set on exit to the
+	 *            new operation. It must eventually be released with \c fx2OpFree().
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation was submitted successfully.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
+	 *     - \c FX2_SYS_ERR if the worker thread could not be started.
+	 */
+	DLLEXPORT(FX2Status) fx2WriteRAMAsync(
+		struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes,
+		FX2Callback callback, void *context, struct FX2Operation **op, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Start writing a block of data to the FX2LP's external EEPROM without blocking.
+	 *
+	 * This is the asynchronous counterpart of \c fx2WriteEEPROM(); see \c fx2WriteRAMAsync() for
+	 * the rules governing asynchronous operations.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param bufPtr A pointer to the block of bytes to write to EEPROM.
+	 * @param numBytes The number of bytes to write to EEPROM.
+	 * @param callback An optional function to call when the operation completes, or \c NULL.
+	 * @param context An arbitrary pointer passed back to \c callback.
+	 * @param op A pointer to a <code>struct FX2Operation*</code> which will be set on exit to the
+	 *            new operation. It must eventually be released with \c fx2OpFree().
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation was submitted successfully.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
+	 *     - \c FX2_USB_ERR if more than 64KiB was asked for but the firmware cannot address it.
+	 *     - \c FX2_SYS_ERR if the worker thread could not be started.
+	 */
+	DLLEXPORT(FX2Status) fx2WriteEEPROMAsync(
+		struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes,
+		FX2Callback callback, void *context, struct FX2Operation **op, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Start reading a block of data from the FX2LP's external EEPROM without blocking.
+	 *
+	 * This is the asynchronous counterpart of \c fx2ReadEEPROM(). The buffer must not be touched
+	 * until the operation completes; it is then extended by however many bytes were read, which
+	 * is \c numBytes unless the operation failed.
+	 *
+	 * @param device The FX2LP device, previously opened using <a href="http://www.swaton.ukfsn.org/apidocs/libusbwrap_8h.html">libusbwrap</a>.
+	 * @param numBytes The number of bytes to read from EEPROM.
+	 * @param i2cBuffer A <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to be populated with the data read from EEPROM.
+	 * @param callback An optional function to call when the operation completes, or \c NULL.
+	 * @param context An arbitrary pointer passed back to \c callback.
+	 * @param op A pointer to a <code>struct FX2Operation*</code> which will be set on exit to the
+	 *            new operation. It must eventually be released with \c fx2OpFree().
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation was submitted successfully.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
+	 *     - \c FX2_USB_ERR if more than 64KiB was asked for but the firmware cannot address it.
+	 *     - \c FX2_SYS_ERR if the worker thread could not be started.
+	 */
+	DLLEXPORT(FX2Status) fx2ReadEEPROMAsync(
+		struct USBDevice *device, uint32 numBytes, struct Buffer *i2cBuffer,
+		FX2Callback callback, void *context, struct FX2Operation **op, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Get a file descriptor which becomes readable whenever the operation makes progress.
+	 *
+	 * Add this to your \c poll()/\c select()/epoll set, and call \c fx2OpPoll() when it fires.
+	 *
+	 * @param op The operation.
+	 * @returns The read end of the operation's notification pipe.
+	 */
+	DLLEXPORT(int) fx2OpGetFd(const struct FX2Operation *op);
+
+	/**
+	 * @brief Check an operation's progress without blocking.
+	 *
+	 * Drains the notification descriptor, and if the operation has completed, invokes its callback
+	 * (once only).
+	 *
+	 * @param op The operation.
+	 * @param bytesDone An optional pointer which will be set on exit to the number of bytes
+	 *            transferred so far.
+	 * @returns \c true if the operation has completed, else \c false.
+	 */
+	DLLEXPORT(bool) fx2OpPoll(struct FX2Operation *op, uint32 *bytesDone);
+
+	/**
+	 * @brief Block until an operation completes, and retrieve its result.
+	 *
+	 * @param op The operation.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if the operation failed. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns The status the equivalent blocking function would have returned.
+	 */
+	DLLEXPORT(FX2Status) fx2OpWait(struct FX2Operation *op, const char **error);
+
+	/**
+	 * @brief Release an operation, waiting for it to complete first if necessary.
+	 *
+	 * @param op The operation to release (may be \c NULL).
+	 */
+	DLLEXPORT(void) fx2OpFree(struct FX2Operation *op);
+	//@}
+
+	// ---------------------------------------------------------------------------------------------
+	// I2C Operations
+	// ---------------------------------------------------------------------------------------------
+	/**
+	 * @name I2C Operations
+	 * @{
+	 */
+	/**
+	 * @brief Initialise an I2C buffer.
+	 *
+	 * Prepare a <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 * with the FX2LP \c 0xC2 header. See TRM section 3.4.3.
+	 *
+	 * @param buf The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to be initialised.
+	 * @param vid The Vendor ID to use in the header (usually \c 0x0000 for C2 loaders).
+	 * @param pid the Product ID to use in the header (usually \c 0x0000 for C2 loaders).
+	 * @param did the Device ID to use in the header (usually \c 0x0000 for C2 loaders).
+	 * @param configByte The configuration byte to use. See TRM section 3.5.
+	 */
+	DLLEXPORT(void) i2cInitialise(
+		struct Buffer *buf, uint16 vid, uint16 pid, uint16 did, uint8 configByte
+	);
+
+	/**
+	 * @brief Populate an I2C buffer with supplied data, respecting the supplied mask.
+	 *
+	 * Given a data buffer and a mask buffer, this function will write I2C records to the
+	 * destination buffer ready for writing to EEPROM or to an i2c file. The mask buffer contains
+	 * \c 0x00 where there is useful data at the corresponding offset into the data buffer and
+	 * \c 0x01 where there is a corresponding "hole" (i.e undefined bytes) in the data buffer.
+	 *
+	 * The destination buffer should have been initialised with \c i2cInitialise() and should be
+	 * finalised with \c i2cFinalise() after this function completes.
+	 *
+	 * @param destination The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to write the I2C records to.
+	 * @param sourceData The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to read the data from.
+	 * @param sourceMask The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            from which to read the mask for the source data.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c I2C_SUCCESS if the operation completed successfully.
+	 *     - \c I2C_NOT_INITIALISED if the supplied destination buffer was uninitialised.
+	 *     - \c I2C_BUFFER_ERROR if an allocation error occurred.
+	 */
+	DLLEXPORT(I2CStatus) i2cWritePromRecords(
+		struct Buffer *destination, const struct Buffer *sourceData,
+		const struct Buffer *sourceMask, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Populate an I2C buffer with supplied data, using the chosen segmentation strategy.
+	 *
+	 * As \c i2cWritePromRecords(), but with control over where the record boundaries go. The
+	 * \c I2C_SEG_MIN_BYTES and \c I2C_SEG_MIN_RECORDS strategies compute an exact optimum over
+	 * every possible segmentation (including where the 1023-byte record limit forces a split),
+	 * in time linear in the size of the data. Holes which end up inside a record are written as
+	 * \c 0x00, as usual.
+	 *
+	 * @param destination The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to write the I2C records to.
+	 * @param sourceData The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to read the data from.
+	 * @param sourceMask The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            from which to read the mask for the source data.
+	 * @param strategy How to divide the data into records.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c I2C_SUCCESS if the operation completed successfully.
+	 *     - \c I2C_NOT_INITIALISED if the supplied destination buffer was uninitialised.
+	 *     - \c I2C_BUFFER_ERROR if an allocation error occurred.
+	 */
+	DLLEXPORT(I2CStatus) i2cWritePromRecordsEx(
+		struct Buffer *destination, const struct Buffer *sourceData,
+		const struct Buffer *sourceMask, I2CSegmentation strategy, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Fill in the nominal C2 boot timings.
+	 *
+	 * @param model The model to populate.
+	 */
+	DLLEXPORT(void) i2cDefaultBootModel(struct I2CBootModel *model);
+
+	/**
+	 * @brief Estimate the time the FX2LP takes to boot from a C2 image.
+	 *
+	 * The estimate runs from power-on to the terminating record releasing the CPU from reset. It
+	 * counts the EEPROM addressing and the eight-byte header at 100kHz. Then it counts the record
+	 * headers and payloads at the speed selected by the config byte. Finally it adds the loader's
+	 * overhead for each record.
+	 *
+	 * @param model The timings to use (see \c i2cDefaultBootModel()).
+	 * @param image A pointer to the C2 image.
+	 * @param length The number of bytes in the image.
+	 * @param bootNs A pointer to a \c uint64 which will be set on exit to the estimate, in
+	 *            nanoseconds.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c I2C_SUCCESS if the operation completed successfully.
+	 *     - \c I2C_NOT_INITIALISED if the image is corrupt or has no terminating record.
+	 */
+	DLLEXPORT(I2CStatus) i2cEstimateBootTime(
+		const struct I2CBootModel *model, const uint8 *image, size_t length, uint64 *bootNs,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Populate an I2C buffer with supplied data, laid out for the fastest boot.
+	 *
+	 * Sets the config byte's 400kHz bit if \c model->fastI2C allows it, and clears it otherwise.
+	 * Then it writes the records whose layout minimises \c i2cEstimateBootTime() under
+	 * \c model. The choice is exact; see \c i2cWritePromRecordsEx().
+	 *
+	 * @param destination The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to write the I2C records to, initialised with \c i2cInitialise().
+	 * @param sourceData The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to read the data from.
+	 * @param sourceMask The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            from which to read the mask for the source data.
+	 * @param model The timings to optimise for.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c I2C_SUCCESS if the operation completed successfully.
+	 *     - \c I2C_NOT_INITIALISED if the supplied destination buffer was uninitialised.
+	 *     - \c I2C_BUFFER_ERROR if an allocation error occurred.
+	 */
+	DLLEXPORT(I2CStatus) i2cWritePromRecordsBoot(
+		struct Buffer *destination, const struct Buffer *sourceData,
+		const struct Buffer *sourceMask, const struct I2CBootModel *model, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Extract linear data and mask buffers from a supplied I2C buffer.
+	 *
+	 * Given a buffer containing I2C records (e.g from an i2c file or read from EEPROM), this
+	 * function will populate two buffers, a data buffer and a mask buffer.  The mask buffer
+	 * contains \c 0x00 where there is useful data at the corresponding offset into the data buffer
+	 * and \c 0x01 where there is a corresponding "hole" (i.e undefined bytes) in the data buffer.
+	 *
+	 * @param destData The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to write the data bytes to.
+	 * @param destMask The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to write the mask bytes to.
+	 * @param source The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            from which to read the I2C records.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c I2C_SUCCESS if the operation completed successfully.
+	 *     - \c I2C_NOT_INITIALISED if the supplied I2C buffer was invalid.
+	 *     - \c I2C_BUFFER_ERROR if an allocation error occurred.
+	 */
+	DLLEXPORT(I2CStatus) i2cReadPromRecords(
+		struct Buffer *destData, struct Buffer *destMask, const struct Buffer *source,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Prepare to walk the records of a C2 image without copying them.
+	 *
+	 * The whole record chain is validated up-front, so once this returns successfully the header
+	 * fields, terminator, trailing bytes and record count in \c iter are all valid, and
+	 * \c i2cIterNext() cannot fail. Nothing is allocated; the image must outlive the iterator.
+	 *
+	 * @param iter The iterator to initialise.
+	 * @param image A pointer to the C2 image (e.g the contents of an \c .iic file or an EEPROM
+	 *            dump).
+	 * @param length The number of bytes in the image.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c I2C_SUCCESS if the image is well-formed.
+	 *     - \c I2C_NOT_INITIALISED if the header is missing or a record runs off the end.
+	 */
+	DLLEXPORT(I2CStatus) i2cIterInit(
+		struct I2CRecordIter *iter, const uint8 *image, size_t length, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Get the next data record from a C2 image.
+	 *
+	 * @param iter An iterator previously initialised with \c i2cIterInit().
+	 * @param record The record to populate. Its \c data pointer points into the image.
+	 * @returns \c true if a record was returned, or \c false if there are no more data records.
+	 */
+	DLLEXPORT(bool) i2cIterNext(struct I2CRecordIter *iter, struct I2CRecord *record);
+
+	/**
+	 * @brief Convert an \c .iic file to a \c .bix file.
+	 *
+	 * The input file is memory-mapped and its records are copied straight into the memory-mapped
+	 * output file, which is sized up-front to end at the highest record. Holes are left as
+	 * \c 0x00. Nothing after the terminating record is read, so oversized EEPROM dumps cost no
+	 * more than the records they contain.
+	 *
+	 * @param iicFile The name of the \c .iic file to read.
+	 * @param bixFile The name of the \c .bix file to create (or overwrite).
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c I2C_SUCCESS if the operation completed successfully.
+	 *     - \c I2C_NOT_INITIALISED if the \c .iic file is corrupt.
+	 *     - \c I2C_FILE_ERROR if a file could not be read, created or written.
+	 */
+	DLLEXPORT(I2CStatus) i2cConvertIicToBix(
+		const char *iicFile, const char *bixFile, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Convert a \c .bix file to an \c .iic file.
+	 *
+	 * The input file is memory-mapped and encoded straight into the memory-mapped output file.
+	 * The output has exactly the layout \c i2cInitialise(), \c i2cWritePromRecords() and
+	 * \c i2cFinalise() produce for it (with zero VID, PID and DID), without building any
+	 * intermediate buffers.
+	 *
+	 * @param bixFile The name of the \c .bix file to read (at most 64KiB).
+	 * @param iicFile The name of the \c .iic file to create (or overwrite).
+	 * @param configByte The configuration byte to use. See TRM section 3.5.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c I2C_SUCCESS if the operation completed successfully.
+	 *     - \c I2C_FILE_ERROR if a file could not be read, created or written, or was too large.
+	 */
+	DLLEXPORT(I2CStatus) i2cConvertBixToIic(
+		const char *bixFile, const char *iicFile, uint8 configByte, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Append a termination record to the end of the supplied I2C buffer.
+	 *
+	 * The TRM (section 3.4.3) defines a specific record terminator for the \c 0xC2 loader format,
+	 * which executes a write of \c 0x00 to the CPU reset register at -c 0xE600. This function
+	 * writes that record terminator, thus marking the end of the I2C records to be read on startup.
+	 *
+	 * @param buf The I2C <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to finalise.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c I2C_SUCCESS if the operation completed successfully.
+	 *     - \c I2C_NOT_INITIALISED if the supplied I2C buffer was invalid.
+	 *     - \c I2C_BUFFER_ERROR if an allocation error occurred.
+	 */
+	DLLEXPORT(I2CStatus) i2cFinalise(
+		struct Buffer *buf, const char **error
+	) WARN_UNUSED_RESULT;
+	//@}
+
+	// ---------------------------------------------------------------------------------------------
+	// Intel HEX Operations
+	// ---------------------------------------------------------------------------------------------
+	/**
+	 * @name Intel HEX Operations
+	 * @{
+	 */
+	/**
+	 * @brief Parse Intel HEX text into data and mask buffers.
+	 *
+	 * Accepts the I8HEX records SDCC produces, plus the extended segment and extended linear
+	 * address records. Each record is decoded with a lookup table and its checksum is verified
+	 * before its data are written. Parsing stops at the end-of-file record. The mask buffer gets
+	 * \c 0x01 for every byte a record defines, so the results can go straight to
+	 * \c i2cWritePromRecords() or \c fx2WriteRAM().
+	 *
+	 * @param text The Intel HEX text (need not be NUL-terminated).
+	 * @param length The number of characters of text.
+	 * @param data The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to write the data bytes to.
+	 * @param mask The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to write the mask bytes to.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c HEX_SUCCESS if the operation completed successfully.
+	 *     - \c HEX_SYNTAX_ERROR if the text is malformed (the message gives the line number).
+	 *     - \c HEX_CHECKSUM_ERROR if a record's checksum is wrong.
+	 *     - \c HEX_BUFFER_ERROR if an allocation error occurred.
+	 */
+	DLLEXPORT(HexStatus) hexParse(
+		const char *text, size_t length, struct Buffer *data, struct Buffer *mask,
+		const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Parse an Intel HEX file into data and mask buffers.
+	 *
+	 * As \c hexParse(), reading the file through a memory mapping.
+	 *
+	 * @param fileName The name of the \c .hex or \c .ihx file to read.
+	 * @param data The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to write the data bytes to.
+	 * @param mask The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to write the mask bytes to.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c HEX_SUCCESS if the operation completed successfully.
+	 *     - \c HEX_FILE_ERROR if the file could not be read.
+	 *     - \c HEX_SYNTAX_ERROR if the text is malformed (the message gives the line number).
+	 *     - \c HEX_CHECKSUM_ERROR if a record's checksum is wrong.
+	 *     - \c HEX_BUFFER_ERROR if an allocation error occurred.
+	 */
+	DLLEXPORT(HexStatus) hexReadFile(
+		const char *fileName, struct Buffer *data, struct Buffer *mask, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Format data and mask buffers as Intel HEX text.
+	 *
+	 * Only bytes whose mask is nonzero are emitted. Records hold at most \c recordSize bytes
+	 * and never span a hole. Above 64KiB, extended linear address records are emitted.
+	 *
+	 * @param data The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to read the data bytes from.
+	 * @param mask The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to read the mask bytes from.
+	 * @param recordSize The maximum number of data bytes per record (1-255, or 0 for the usual 16).
+	 * @param text The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to append the text to.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c HEX_SUCCESS if the operation completed successfully.
+	 *     - \c HEX_BUFFER_ERROR if an allocation error occurred.
+	 */
+	DLLEXPORT(HexStatus) hexFormat(
+		const struct Buffer *data, const struct Buffer *mask, uint8 recordSize,
+		struct Buffer *text, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Write data and mask buffers to an Intel HEX file.
+	 *
+	 * As \c hexFormat(), with the text streamed to the file in 64KiB writes.
+	 *
+	 * @param data The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to read the data bytes from.
+	 * @param mask The <code><a href="http://www.swaton.ukfsn.org/apidocs/libbuffer_8h.html">Buffer</a></code>
+	 *            to read the mask bytes from.
+	 * @param fileName The name of the file to create (or overwrite).
+	 * @param recordSize The maximum number of data bytes per record (1-255, or 0 for the usual 16).
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c HEX_SUCCESS if the operation completed successfully.
+	 *     - \c HEX_FILE_ERROR if the file could not be created or written.
+	 *     - \c HEX_BUFFER_ERROR if an allocation error occurred.
+	 */
+	DLLEXPORT(HexStatus) hexWriteFile(
+		const struct Buffer *data, const struct Buffer *mask, const char *fileName,
+		uint8 recordSize, const char **error
+	) WARN_UNUSED_RESULT;
+	//@}
+
+	// ---------------------------------------------------------------------------------------------
+	// Transfer Tuning
+	// ---------------------------------------------------------------------------------------------
+	/**
+	 * @name Transfer Tuning
+	 * By default every chunked transfer is 4KiB with a 5000ms timeout. Once a device has a
+	 * transfer configuration, the library instead times each chunk and, for each
+	 * \c FX2TransferKind separately, moves the chunk size between \c FX2_CHUNK_MIN and
+	 * \c FX2_CHUNK_MAX towards whichever size gives the best throughput on this host. Unless
+	 * fixed, the timeout follows the chunk size and the measured rate, so a slow EEPROM gets a
+	 * generous timeout and a fast one fails promptly. A chunk which fails halves the chunk size.
+	 * @{
+	 */
+	/**
+	 * @brief Configure how a device's chunked transfers are sized and timed. Measurements made
+	 *        under any earlier configuration are discarded.
+	 *
+	 * A fixed \c chunkSize is rounded down to a power of two and clamped to
+	 * [\c FX2_CHUNK_MIN, \c FX2_CHUNK_MAX]. A per-call \c FX2Monitor timeout overrides the
+	 * device's timeout.
+	 *
+	 * @param device The device handle, from \c usbOpenDevice() or \c fx2SimDevice().
+	 * @param config The chunk size and timeout; zero fields are tuned automatically.
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
+	 */
+	DLLEXPORT(FX2Status) fx2SetTransferConfig(
+		struct USBDevice *device, const struct FX2TransferConfig *config, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Return a device to the fixed default chunk size and timeout. Call this before
+	 *        closing the device, since a later device may reuse the handle.
+	 *
+	 * @param device The device handle.
+	 */
+	DLLEXPORT(void) fx2ClearTransferConfig(struct USBDevice *device);
+
+	/**
+	 * @brief Get the chunk size and timeout the next transfer of the given kind will use.
+	 *
+	 * @param device The device handle.
+	 * @param kind The kind of transfer.
+	 * @param tuning The settings to populate; the defaults if the device has no configuration.
+	 * @returns \c true if the device has a transfer configuration, else \c false.
+	 */
+	DLLEXPORT(bool) fx2GetTransferTuning(
+		struct USBDevice *device, FX2TransferKind kind, struct FX2TransferTuning *tuning
+	);
+	//@}
+
+	// ---------------------------------------------------------------------------------------------
+	// Transfer Statistics
+	// ---------------------------------------------------------------------------------------------
+	/**
+	 * @name Transfer Statistics
+	 * Opt-in instrumentation of the transfers made to a device, to tell USB latency from EEPROM
+	 * write cycles when programming is slow. Statistics are kept per device handle, from
+	 * \c fx2StatsEnable() until \c fx2StatsDisable(). While disabled, each transfer costs only a
+	 * lookup which finds nothing.
+	 * @{
+	 */
+	/**
+	 * @brief Start keeping statistics for a device. Does nothing if they are already being kept.
+	 *
+	 * @param device The device handle, from \c usbOpenDevice() or \c fx2SimDevice().
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_BUF_ERR if an allocation error occurred.
+	 */
+	DLLEXPORT(FX2Status) fx2StatsEnable(
+		struct USBDevice *device, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Stop keeping statistics for a device and discard them. Call this before closing the
+	 *        device, since a later device may reuse the handle.
+	 *
+	 * @param device The device handle.
+	 */
+	DLLEXPORT(void) fx2StatsDisable(struct USBDevice *device);
+
+	/**
+	 * @brief Get a snapshot of a device's statistics.
+	 *
+	 * @param device The device handle.
+	 * @param stats The statistics to populate.
+	 * @returns \c true if statistics are being kept for the device, else \c false (and \c stats
+	 *          is untouched).
+	 */
+	DLLEXPORT(bool) fx2StatsGet(struct USBDevice *device, struct FX2Stats *stats);
+
+	/**
+	 * @brief Zero a device's statistics, leaving them enabled.
+	 *
+	 * @param device The device handle.
+	 */
+	DLLEXPORT(void) fx2StatsReset(struct USBDevice *device);
+	//@}
+
+	// ---------------------------------------------------------------------------------------------
+	// Simulated Device
+	// ---------------------------------------------------------------------------------------------
+	/**
+	 * @name Simulated Device
+	 * An in-process FX2LP which every \c fx2*() function accepts in place of a real device, so the
+	 * transfer paths can be tested and benchmarked without hardware. It implements the \c 0xA0
+	 * RAM request (with the CPUCS reset and renumeration behaviour) in the core, and the bundled
+	 * firmware's calculator, EEPROM read/write and EEPROM configuration commands against an
+	 * emulated 24LCxx EEPROM. It does not implement the bulk or CRC32 commands, so it reports only
+	 * \c FX2_FEATURE_PAGE_WRITE and \c FX2_FEATURE_BANKS and the library falls back accordingly.
+	 *
+	 * Until the 8051 is released from reset after a RAM load (or unless
+	 * \c FX2SimConfig::firmwareRunning is set), only the \c 0xA0 request works and the firmware
+	 * commands stall, as on a blank board. The device handle stays valid across renumeration.
+	 * @{
+	 */
+	/**
+	 * @brief Get the default simulation: a 24LC128 with 64-byte pages behind a high-speed link,
+	 *        with the firmware already running.
+	 *
+	 * @param config The configuration to populate.
+	 */
+	DLLEXPORT(void) fx2SimDefaultConfig(struct FX2SimConfig *config);
+
+	/**
+	 * @brief Create a simulated FX2LP.
+	 *
+	 * The EEPROM starts erased (all \c 0xFF) and the RAM starts zeroed. The simulation is safe to
+	 * use from one thread at a time, like a real device; separate simulations are independent.
+	 *
+	 * @param config The configuration to use, or \c NULL for \c fx2SimDefaultConfig().
+	 * @param simPtr A pointer to an <code>FX2Sim*</code> which will be set on exit to the new
+	 *            simulation. Destroy it with \c fx2SimDestroy().
+	 * @param error A pointer to a <code>char*</code> which will be set on exit to an allocated
+	 *            error message if something goes wrong. Responsibility for this allocated memory
+	 *            passes to the caller and must be freed with \c fx2FreeError(). If \c error is
+	 *            \c NULL, no allocation is done and no message is returned, but the return code
+	 *            will still be valid.
+	 * @returns
+	 *     - \c FX2_SUCCESS if the operation completed successfully.
+	 *     - \c FX2_BUF_ERR if the configuration is invalid or an allocation error occurred.
+	 */
+	DLLEXPORT(FX2Status) fx2SimCreate(
+		const struct FX2SimConfig *config, struct FX2Sim **simPtr, const char **error
+	) WARN_UNUSED_RESULT;
+
+	/**
+	 * @brief Destroy a simulated FX2LP. Its device handle must no longer be in use.
+	 *
+	 * @param sim The simulation to destroy, or \c NULL.
+	 */
+	DLLEXPORT(void) fx2SimDestroy(struct FX2Sim *sim);
+
+	/**
+	 * @brief Get the device handle to pass to the \c fx2*() functions in place of one from
+	 *        \c usbOpenDevice(). It must not be passed to \c usbCloseDevice().
+	 *
+	 * @param sim The simulation.
+	 * @returns The simulation's device handle.
+	 */
+	DLLEXPORT(struct USBDevice *) fx2SimDevice(struct FX2Sim *sim);
+
+	/**
+	 * @brief Get the emulated EEPROM's contents, to seed or inspect them directly.
+	 *
+	 * @param sim The simulation.
+	 * @param size A pointer to a \c uint32 which will be set on exit to the size of the EEPROM,
+	 *            or \c NULL.
+	 * @returns The EEPROM contents, valid until \c fx2SimDestroy().
+	 */
+	DLLEXPORT(uint8 *) fx2SimEEPROM(struct FX2Sim *sim, uint32 *size);
+
+	/**
+	 * @brief Get the 64KiB of 8051 address space the \c 0xA0 request reads and writes.
+	 *
+	 * @param sim The simulation.
+	 * @returns The RAM contents, valid until \c fx2SimDestroy().
+	 */
+	DLLEXPORT(uint8 *) fx2SimRAM(struct FX2Sim *sim);
+
+	/**
+	 * @brief Get what the simulation has done so far.
+	 *
+	 * @param sim The simulation.
+	 * @param stats The statistics to populate.
+	 */
+	DLLEXPORT(void) fx2SimGetStats(struct FX2Sim *sim, struct FX2SimStats *stats);
+
+	/**
+	 * @brief Zero the statistics, e.g between benchmark iterations.
+	 *
+	 * @param sim The simulation.
+	 */
+	DLLEXPORT(void) fx2SimResetStats(struct FX2Sim *sim);
+	//@}
+
+	// ---------------------------------------------------------------------------------------------
+	// Miscellaneous functions
+	// ---------------------------------------------------------------------------------------------
+	/**
+	 * @name Miscellaneous Functions
+	 * @{
 	 */
 	/**
 	 * @brief Free an error allocated when one of the other functions fails.
@@ -278,6 +1654,20 @@ extern "C" {
 	 * @param err An error message previously allocated by one of the other library functions.
 	 */
 	DLLEXPORT(void) fx2FreeError(const char *err);
+
+	/**
+	 * @brief Update a CRC32 with some more data.
+	 *
+	 * This is the usual IEEE 802.3 CRC32 (as used by zlib), which matches the one calculated by the
+	 * firmware. Pass zero as the initial CRC; the result of one call may be passed in to the next to
+	 * calculate the CRC of data in several pieces.
+	 *
+	 * @param crc The CRC of the data so far, or zero.
+	 * @param ptr A pointer to the data.
+	 * @param length The number of bytes of data.
+	 * @returns The updated CRC.
+	 */
+	DLLEXPORT(uint32) fx2Crc32(uint32 crc, const uint8 *ptr, size_t length);
 	//@}
 
 #ifdef __cplusplus
@@ -0,0 +1,218 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file libfx2loader.hpp
+ *
+ * Compile-time counterparts of the I2C functions in libfx2loader.h, for C++17 and later. They let a
+ * host application embed a firmware image (as a data array and a mask array) and have the
+ * compiler produce the finished C2 image, or the list of regions to upload to RAM, as a
+ * <code>constexpr std::array</code>, so nothing is parsed, allocated or encoded at run time.
+ *
+ * The C2 layout is exactly the one \c i2cWritePromRecords() produces. For example:
+ * @code
+ * constexpr std::array<uint8, 4096> fwData = { ... };
+ * constexpr std::array<uint8, 4096> fwMask = { ... };
+ * constexpr auto image = fx2::c2Image<fx2::c2ImageSize(fwMask)>(fwData, fwMask);
+ * @endcode
+ */
+#ifndef LIBFX2LOADER_HPP
+#define LIBFX2LOADER_HPP
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+#include <makestuff/libfx2loader.h>
+
+namespace fx2 {
+
+	/**
+	 * A contiguous region of a firmware image to be uploaded to RAM.
+	 */
+	struct RamSegment {
+		uint16 address;  ///< The RAM address of the first byte.
+		uint16 length;   ///< The number of bytes.
+	};
+
+	namespace detail {
+		// Call emit(address, length) for each record i2cWritePromRecords() would write for this
+		// mask. This mirrors its run-splitting heuristic and dumpChunk()'s 1023-byte split.
+		//
+		template<std::size_t N, typename Emit>
+		constexpr void forEachRecord(const std::array<uint8, N> &mask, Emit &&emit) {
+			auto dump = [&emit](std::size_t address, std::size_t length) {
+				if ( length == 0 ) {
+					return;
+				}
+				while ( length > 1023 ) {
+					emit(address, std::size_t(1023));
+					address += 1023;
+					length -= 1023;
+				}
+				emit(address, length);
+			};
+			std::size_t i = 0, chunkStart = 0;
+			while ( i < N && !mask[i] ) {
+				i++;
+			}
+			if ( i == N ) {
+				return;  // There are no data
+			}
+			chunkStart = i;
+			do {
+				while ( i < N && mask[i] ) {
+					i++;
+				}
+				if ( i == N ) {
+					dump(chunkStart, N - chunkStart);
+					break;
+				}
+				if ( i + 4 < N ) {
+					if ( !mask[i] && !mask[i+1] && !mask[i+2] && !mask[i+3] ) {
+						dump(chunkStart, i - chunkStart);
+						i += 4;
+						while ( i < N && !mask[i] ) {
+							i++;
+						}
+						chunkStart = i;
+					} else {
+						while ( !mask[i] ) {
+							i++;
+						}
+					}
+				} else {
+					dump(chunkStart, N - chunkStart);
+					break;
+				}
+			} while ( i < N );
+		}
+	}
+
+	/**
+	 * @brief The size in bytes of the C2 image \c c2Image() will build for this mask.
+	 *
+	 * @param mask The firmware mask: nonzero where the corresponding data byte is defined.
+	 * @returns The image size, including the header and the terminating record.
+	 */
+	template<std::size_t N>
+	constexpr std::size_t c2ImageSize(const std::array<uint8, N> &mask) {
+		std::size_t size = 8 + 5;
+		detail::forEachRecord(mask, [&size](std::size_t, std::size_t length) {
+			size += 4 + length;
+		});
+		return size;
+	}
+
+	/**
+	 * @brief Build a finished C2 image, as \c i2cInitialise(), \c i2cWritePromRecords() and
+	 * \c i2cFinalise() would.
+	 *
+	 * @tparam Size The image size, from \c c2ImageSize(). A wrong size fails to compile when the
+	 *            result is \c constexpr (or throws \c std::length_error at run time).
+	 * @param data The firmware bytes.
+	 * @param mask The firmware mask: nonzero where the corresponding data byte is defined.
+	 * @param vid The Vendor ID to use in the header.
+	 * @param pid The Product ID to use in the header.
+	 * @param did The Device ID to use in the header.
+	 * @param configByte The configuration byte to use. See TRM section 3.5.
+	 * @returns The C2 image.
+	 */
+	template<std::size_t Size, std::size_t N>
+	constexpr std::array<uint8, Size> c2Image(
+		const std::array<uint8, N> &data, const std::array<uint8, N> &mask,
+		uint16 vid = 0x0000, uint16 pid = 0x0000, uint16 did = 0x0000,
+		uint8 configByte = CONFIG_BYTE_400KHZ)
+	{
+		std::array<uint8, Size> image{};
+		std::size_t pos = 0;
+		auto put = [&image, &pos](std::size_t byte) {
+			if ( pos == Size ) {
+				throw std::length_error("fx2::c2Image(): Size is smaller than c2ImageSize()");
+			}
+			image[pos++] = static_cast<uint8>(byte);
+		};
+		put(0xC2);
+		put(vid & 0xFF); put(vid >> 8);
+		put(pid & 0xFF); put(pid >> 8);
+		put(did & 0xFF); put(did >> 8);
+		put(configByte);
+		detail::forEachRecord(mask, [&](std::size_t address, std::size_t length) {
+			put(length >> 8); put(length & 0xFF);
+			put(address >> 8); put(address & 0xFF);
+			for ( std::size_t i = address; i < address + length; i++ ) {
+				put(mask[i] ? data[i] : 0x00);
+			}
+		});
+		put(0x80); put(0x01); put(0xE6); put(0x00); put(0x00);
+		if ( pos != Size ) {
+			throw std::length_error("fx2::c2Image(): Size is larger than c2ImageSize()");
+		}
+		return image;
+	}
+
+	/**
+	 * @brief The number of regions \c ramPlan() will return for this mask.
+	 *
+	 * @param mask The firmware mask: nonzero where the corresponding data byte is defined.
+	 * @returns The number of runs of defined bytes.
+	 */
+	template<std::size_t N>
+	constexpr std::size_t ramPlanSize(const std::array<uint8, N> &mask) {
+		std::size_t count = 0;
+		for ( std::size_t i = 0; i < N; i++ ) {
+			if ( mask[i] && (i == 0 || !mask[i-1]) ) {
+				count++;
+			}
+		}
+		return count;
+	}
+
+	/**
+	 * @brief List the runs of defined bytes in a firmware image, for uploading to RAM.
+	 *
+	 * Upload each region with \c fx2WriteRAM() (after holding the CPU in reset), or merge them
+	 * first if the gaps between them are small.
+	 *
+	 * @tparam Count The number of regions, from \c ramPlanSize().
+	 * @param mask The firmware mask: nonzero where the corresponding data byte is defined.
+	 * @returns The regions, in address order.
+	 */
+	template<std::size_t Count, std::size_t N>
+	constexpr std::array<RamSegment, Count> ramPlan(const std::array<uint8, N> &mask) {
+		std::array<RamSegment, Count> plan{};
+		std::size_t count = 0;
+		for ( std::size_t i = 0; i < N; i++ ) {
+			if ( mask[i] && (i == 0 || !mask[i-1]) ) {
+				if ( count == Count ) {
+					throw std::length_error("fx2::ramPlan(): Count is smaller than ramPlanSize()");
+				}
+				plan[count].address = static_cast<uint16>(i);
+				plan[count].length = 0;
+				count++;
+			}
+			if ( mask[i] ) {
+				plan[count-1].length++;
+			}
+		}
+		if ( count != Count ) {
+			throw std::length_error("fx2::ramPlan(): Count is larger than ramPlanSize()");
+		}
+		return plan;
+	}
+}
+
+#endif
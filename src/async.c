@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <makestuff/common.h>
+#include <makestuff/libusbwrap.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+#include "vendorCommands.h"
+#include "xfer.h"
+#include "transport.h"
+#include "stats.h"
+#include "eeprom.h"
+
+typedef enum {
+	OP_WRITE_RAM,
+	OP_WRITE_EEPROM,
+	OP_READ_EEPROM
+} OpKind;
+
+// An in-flight operation. The usual synchronous chunk sequence runs on its own thread, so the
+// caller's thread is free to service other devices.
+// The worker signals progress by writing a byte to the pipe, so the read end can be handed to an
+// external event loop.
+//
+struct FX2Operation {
+	OpKind kind;
+	struct USBDevice *device;
+	struct XferJob job;
+	uint32 numBytes;
+	struct Buffer *buffer;  // for reads, extended by the worker once it finishes
+	FX2Callback callback;
+	void *context;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	int fds[2];
+	uint32 bytesDone;   // protected by lock
+	bool finished;      // protected by lock
+	bool reported;      // only touched by the caller's thread
+	bool joined;        // only touched by the caller's thread
+	FX2Status status;   // valid once finished
+	const char *error;  // valid once finished
+};
+
+// Tell the caller's event loop that something changed. If the pipe is full there is already a
+// wakeup pending, so a failed write can be ignored.
+//
+static void opNotify(struct FX2Operation *op) {
+	const uint8 byte = 0x00;
+	ssize_t written = write(op->fds[1], &byte, 1);
+	(void)written;
+}
+
+static const char *const opErrors[] = {
+	"fx2WriteRAMAsync(): Failed to write block of bytes",
+	"fx2WriteEEPROMAsync(): Failed to write block of bytes",
+	"fx2ReadEEPROMAsync(): Failed to read block of bytes"
+};
+
+static const FX2StatsOp opStats[] = {
+	FX2_STATS_WRITE_RAM,
+	FX2_STATS_WRITE_EEPROM,
+	FX2_STATS_READ_EEPROM
+};
+
+static void *opWorker(void *arg) {
+	struct FX2Operation *const op = (struct FX2Operation *)arg;
+	FX2Status retVal = FX2_SUCCESS;
+	USBStatus uStatus;
+	const char *errPtr = NULL;
+	const char **const error = &errPtr;
+	uint8 byte = 0x01;
+	statsBegin(op->device, opStats[op->kind]);
+	if ( op->kind == OP_WRITE_RAM ) {
+		uStatus = devControlWrite(
+			op->device, CMD_READ_WRITE_RAM, 0xE600, 0x0000, &byte, 1, XFER_TIMEOUT, error);
+		CHECK_STATUS(
+			uStatus, FX2_USB_ERR, cleanup, "fx2WriteRAMAsync(): Failed to put the CPU in reset");
+	}
+	do {
+		uStatus = xferNext(op->device, &op->job, error);
+		if ( uStatus ) {
+			errPrefix(error, opErrors[op->kind]);
+			FAIL_RET(FX2_USB_ERR, cleanup);
+		}
+		pthread_mutex_lock(&op->lock);
+		op->bytesDone = op->numBytes - op->job.remaining;
+		pthread_mutex_unlock(&op->lock);
+		opNotify(op);
+	} while ( !xferFinished(&op->job) );
+	if ( op->kind == OP_WRITE_RAM ) {
+		// As in fx2WriteRAM(), the device may drop off the bus before it acknowledges this
+		byte = 0x00;
+		uStatus = devControlWrite(
+			op->device, CMD_READ_WRITE_RAM, 0xE600, 0x0000, &byte, 1, XFER_TIMEOUT, NULL);
+	}
+cleanup:
+	statsEnd(op->device, retVal);
+	if ( op->buffer ) {
+		// Keep whatever arrived, and put the fill byte back in the rest of the reserved space
+		op->buffer->length += op->numBytes - op->job.remaining;
+		if ( retVal != FX2_SUCCESS ) {
+			eepromClearTail(op->buffer, op->job.remaining);
+		}
+	}
+	pthread_mutex_lock(&op->lock);
+	op->status = retVal;
+	op->error = errPtr;
+	op->finished = true;
+	pthread_mutex_unlock(&op->lock);
+	opNotify(op);
+	return NULL;
+}
+
+static FX2Status opStart(
+	OpKind kind, struct USBDevice *device, FX2Callback callback, void *context,
+	struct FX2Operation *op, struct FX2Operation **opPtr, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	int i;
+	op->kind = kind;
+	op->device = device;
+	op->numBytes = op->job.remaining;
+	op->callback = callback;
+	op->context = context;
+	op->bytesDone = 0;
+	op->finished = false;
+	op->reported = false;
+	op->joined = false;
+	op->status = FX2_SUCCESS;
+	op->error = NULL;
+	if ( pipe(op->fds) ) {
+		errRenderStd(error);
+		FAIL_RET(FX2_SYS_ERR, fail);
+	}
+	for ( i = 0; i < 2; i++ ) {
+		fcntl(op->fds[i], F_SETFL, fcntl(op->fds[i], F_GETFL) | O_NONBLOCK);
+	}
+	pthread_mutex_init(&op->lock, NULL);
+	if ( pthread_create(&op->thread, NULL, opWorker, op) ) {
+		errRender(error, "opStart(): Failed to start worker thread");
+		pthread_mutex_destroy(&op->lock);
+		close(op->fds[0]);
+		close(op->fds[1]);
+		FAIL_RET(FX2_SYS_ERR, fail);
+	}
+	*opPtr = op;
+	return FX2_SUCCESS;
+fail:
+	free(op);
+	return retVal;
+}
+
+static struct FX2Operation *opAlloc(const char **error) {
+	struct FX2Operation *const op = (struct FX2Operation *)calloc(1, sizeof(struct FX2Operation));
+	if ( !op ) {
+		errRender(error, "Unable to allocate operation");
+	}
+	return op;
+}
+
+DLLEXPORT(FX2Status) fx2WriteRAMAsync(
+	struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes,
+	FX2Callback callback, void *context, struct FX2Operation **op, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	struct FX2Operation *const newOp = opAlloc(error);
+	CHECK_STATUS(!newOp, FX2_BUF_ERR, cleanup, "fx2WriteRAMAsync()");
+	xferInitWrite(&newOp->job, CMD_READ_WRITE_RAM, 0x0000, bufPtr, numBytes);
+	retVal = opStart(OP_WRITE_RAM, device, callback, context, newOp, op, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "fx2WriteRAMAsync()");
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(FX2Status) fx2WriteEEPROMAsync(
+	struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes,
+	FX2Callback callback, void *context, struct FX2Operation **op, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	struct FX2Operation *newOp = NULL;
+	CHECK_STATUS(
+		!eepromBanksSupported(device, numBytes), FX2_USB_ERR, cleanup,
+		"fx2WriteEEPROMAsync()"BANK_ERROR);
+	newOp = opAlloc(error);
+	CHECK_STATUS(!newOp, FX2_BUF_ERR, cleanup, "fx2WriteEEPROMAsync()");
+	xferInitWrite(&newOp->job, CMD_READ_WRITE_EEPROM, 0x00000000, bufPtr, numBytes);
+	retVal = opStart(OP_WRITE_EEPROM, device, callback, context, newOp, op, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "fx2WriteEEPROMAsync()");
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(FX2Status) fx2ReadEEPROMAsync(
+	struct USBDevice *device, uint32 numBytes, struct Buffer *i2cBuffer,
+	FX2Callback callback, void *context, struct FX2Operation **op, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	BufferStatus bStatus;
+	struct FX2Operation *newOp = NULL;
+	CHECK_STATUS(
+		!eepromBanksSupported(device, numBytes), FX2_USB_ERR, cleanup,
+		"fx2ReadEEPROMAsync()"BANK_ERROR);
+	bStatus = eepromReserveTail(i2cBuffer, numBytes, error);
+	CHECK_STATUS(bStatus, FX2_BUF_ERR, cleanup, "fx2ReadEEPROMAsync()");
+	newOp = opAlloc(error);
+	CHECK_STATUS(!newOp, FX2_BUF_ERR, cleanup, "fx2ReadEEPROMAsync()");
+	xferInitRead(
+		&newOp->job, CMD_READ_WRITE_EEPROM, 0x00000000, i2cBuffer->data + i2cBuffer->length,
+		numBytes);
+	newOp->buffer = i2cBuffer;
+	retVal = opStart(OP_READ_EEPROM, device, callback, context, newOp, op, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "fx2ReadEEPROMAsync()");
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(int) fx2OpGetFd(const struct FX2Operation *op) {
+	return op->fds[0];
+}
+
+DLLEXPORT(bool) fx2OpPoll(struct FX2Operation *op, uint32 *bytesDone) {
+	uint8 drain[64];
+	bool finished;
+	while ( read(op->fds[0], drain, sizeof(drain)) > 0 );
+	pthread_mutex_lock(&op->lock);
+	finished = op->finished;
+	if ( bytesDone ) {
+		*bytesDone = op->bytesDone;
+	}
+	pthread_mutex_unlock(&op->lock);
+	if ( finished && !op->reported ) {
+		op->reported = true;
+		if ( op->callback ) {
+			op->callback(op, op->status, op->context);
+		}
+	}
+	return finished;
+}
+
+DLLEXPORT(FX2Status) fx2OpWait(struct FX2Operation *op, const char **error) {
+	if ( !op->joined ) {
+		pthread_join(op->thread, NULL);
+		op->joined = true;
+	}
+	fx2OpPoll(op, NULL);
+	if ( op->error ) {
+		if ( error ) {
+			*error = op->error;
+		} else {
+			errFree(op->error);
+		}
+		op->error = NULL;
+	}
+	return op->status;
+}
+
+DLLEXPORT(void) fx2OpFree(struct FX2Operation *op) {
+	if ( op ) {
+		if ( !op->joined ) {
+			pthread_join(op->thread, NULL);
+		}
+		if ( op->error ) {
+			errFree(op->error);
+		}
+		pthread_mutex_destroy(&op->lock);
+		close(op->fds[0]);
+		close(op->fds[1]);
+		free(op);
+	}
+}
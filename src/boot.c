@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+#include "seg.h"
+
+// The boot loader addresses the EEPROM before reading the header: a control byte, two address
+// bytes and a repeated-start control byte.
+//
+#define ADDRESSING_BYTES 4
+
+// Fill in the nominal timings. Each I2C byte is nine bit-times (eight data bits plus ACK).
+//
+DLLEXPORT(void) i2cDefaultBootModel(struct I2CBootModel *model) {
+	model->startupNs = 0;
+	model->byteNs100k = 90000;
+	model->byteNs400k = 22500;
+	model->recordNs = 10000;
+	model->fastI2C = true;
+}
+
+// Estimate the time from the boot loader starting to the CPU leaving reset. The header is always
+// read at 100kHz; after that the config byte decides.
+//
+DLLEXPORT(I2CStatus) i2cEstimateBootTime(
+	const struct I2CBootModel *model, const uint8 *image, size_t length, uint64 *bootNs,
+	const char **error)
+{
+	I2CStatus retVal = I2C_SUCCESS;
+	struct I2CRecordIter iter;
+	uint64 recordBytes, byteNs;
+	retVal = i2cIterInit(&iter, image, length, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "i2cEstimateBootTime()");
+	CHECK_STATUS(
+		!iter.hasTerminator, I2C_NOT_INITIALISED, cleanup,
+		"i2cEstimateBootTime(): the image has no terminating record, so the CPU would never start");
+	byteNs = (iter.configByte & CONFIG_BYTE_400KHZ) ? model->byteNs400k : model->byteNs100k;
+	recordBytes = (uint64)(iter.trailing - image) - 8;
+	*bootNs =
+		model->startupNs +
+		(uint64)(ADDRESSING_BYTES + 8) * model->byteNs100k +
+		recordBytes * byteNs +
+		(uint64)(iter.numRecords + 1) * model->recordNs;
+cleanup:
+	return retVal;
+}
+
+// Choose the I2C speed the model allows, then lay out the records to minimise the boot time: each
+// record costs its four header bytes plus the loader's per-record overhead.
+//
+DLLEXPORT(I2CStatus) i2cWritePromRecordsBoot(
+	struct Buffer *destination, const struct Buffer *sourceData, const struct Buffer *sourceMask,
+	const struct I2CBootModel *model, const char **error)
+{
+	I2CStatus retVal = I2C_SUCCESS;
+	uint32 byteNs;
+	CHECK_STATUS(
+		destination->length != 8 || destination->data[0] != 0xC2, I2C_NOT_INITIALISED, cleanup,
+		"i2cWritePromRecordsBoot(): the buffer was not initialised");
+	if ( model->fastI2C ) {
+		destination->data[7] |= CONFIG_BYTE_400KHZ;
+		byteNs = model->byteNs400k;
+	} else {
+		destination->data[7] &= (uint8)~CONFIG_BYTE_400KHZ;
+		byteNs = model->byteNs100k;
+	}
+	retVal = i2cWriteOptimal(
+		destination, sourceData, sourceMask, model->recordNs + 4*byteNs, byteNs, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "i2cWritePromRecordsBoot()");
+cleanup:
+	return retVal;
+}
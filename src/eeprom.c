@@ -14,103 +14,499 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <makestuff/common.h>
 #include <makestuff/libusbwrap.h>
 #include <makestuff/liberror.h>
 #include <makestuff/libbuffer.h>
 #include <makestuff/libfx2loader.h>
 #include "vendorCommands.h"
+#include "xfer.h"
+#include "transport.h"
+#include "stats.h"
+#include "monitor.h"
+#include "eeprom.h"
 
 #define A2_ERROR ": This firmware does not seem to support EEPROM operations - try loading an appropriate firmware into RAM first"
-#define BLOCK_SIZE 4096
+
+bool eepromBanksSupported(struct USBDevice *device, uint32 numBytes) {
+	struct FX2EEPROMConfig config;
+	return
+		numBytes <= 0x10000 || (
+			fx2GetEEPROMConfig(device, &config, NULL) == FX2_SUCCESS &&
+			(config.features & FX2_FEATURE_BANKS)
+		);
+}
+
+BufferStatus eepromReserveTail(struct Buffer *buf, uint32 numBytes, const char **error) {
+	const size_t length = buf->length;
+	BufferStatus bStatus = BUF_SUCCESS;
+	if ( buf->capacity - length < numBytes ) {
+		bStatus = bufAppendConst(buf, buf->fill, numBytes, error);
+		buf->length = length;
+	}
+	return bStatus;
+}
+
+void eepromClearTail(struct Buffer *buf, uint32 numBytes) {
+	memset(buf->data + buf->length, buf->fill, numBytes);
+}
 
 // Write the supplied reader buffer to EEPROM, using the supplied VID/PID.
 //
 DLLEXPORT(FX2Status) fx2WriteEEPROM(
 	struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes, const char **error)
 {
+	return fx2WriteEEPROMEx(device, bufPtr, numBytes, NULL, NULL, error);
+}
+
+// As above, checking for cancellation before each chunk and reporting progress after it.
+//
+DLLEXPORT(FX2Status) fx2WriteEEPROMEx(
+	struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes,
+	const struct FX2Monitor *monitor, uint32 *bytesDone, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	USBStatus uStatus;
+	struct XferJob job;
+	struct Monitor mon;
+	uint32 done = 0;
+	statsBegin(device, FX2_STATS_WRITE_EEPROM);
+	CHECK_STATUS(
+		!eepromBanksSupported(device, numBytes), FX2_USB_ERR, cleanup, "fx2WriteEEPROMEx()"BANK_ERROR);
+	xferInitWrite(&job, CMD_READ_WRITE_EEPROM, 0x00000000, bufPtr, numBytes);
+	monInit(&mon, monitor, &job);
+	do {
+		if ( monCancelled(&mon) ) {
+			errRender(
+				error, "fx2WriteEEPROMEx(): Cancelled after %u of %u bytes", done, numBytes);
+			FAIL_RET(FX2_CANCELLED, cleanup);
+		}
+		uStatus = xferNext(device, &job, error);
+		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteEEPROMEx()"A2_ERROR);
+		done = numBytes - job.remaining;
+		monUpdate(&mon, done);
+	} while ( !xferFinished(&job) );
+cleanup:
+	if ( bytesDone ) {
+		*bytesDone = done;
+	}
+	statsEnd(device, retVal);
+	return retVal;
+}
+
+// Read from the EEPROM into the supplied buffer, using the supplied VID/PID.
+//
+DLLEXPORT(FX2Status) fx2ReadEEPROM(
+	struct USBDevice *device, uint32 numBytes, struct Buffer *i2cBuffer, const char **error)
+{
+	return fx2ReadEEPROMEx(device, numBytes, i2cBuffer, NULL, NULL, error);
+}
+
+// As above, checking for cancellation before each chunk and reporting progress after it. If the
+// read stops early, the buffer is extended by just the bytes which were read.
+//
+DLLEXPORT(FX2Status) fx2ReadEEPROMEx(
+	struct USBDevice *device, uint32 numBytes, struct Buffer *i2cBuffer,
+	const struct FX2Monitor *monitor, uint32 *bytesDone, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	BufferStatus bStatus;
+	uint32 done = 0;
+	bStatus = eepromReserveTail(i2cBuffer, numBytes, error);
+	CHECK_STATUS(bStatus, FX2_BUF_ERR, cleanup, "fx2ReadEEPROMEx()");
+	retVal = fx2ReadEEPROMInto(
+		device, i2cBuffer->data + i2cBuffer->length, numBytes, monitor, &done, error);
+	i2cBuffer->length += done;
+	if ( retVal != FX2_SUCCESS ) {
+		eepromClearTail(i2cBuffer, numBytes - done);
+	}
+cleanup:
+	if ( bytesDone ) {
+		*bytesDone = done;
+	}
+	return retVal;
+}
+
+// Read from the EEPROM straight into the caller's memory, a chunk at a time.
+//
+DLLEXPORT(FX2Status) fx2ReadEEPROMInto(
+	struct USBDevice *device, uint8 *bufPtr, uint32 numBytes,
+	const struct FX2Monitor *monitor, uint32 *bytesDone, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	USBStatus uStatus;
+	struct XferJob job;
+	struct Monitor mon;
+	uint32 done = 0;
+	statsBegin(device, FX2_STATS_READ_EEPROM);
+	CHECK_STATUS(
+		!eepromBanksSupported(device, numBytes), FX2_USB_ERR, cleanup, "fx2ReadEEPROMInto()"BANK_ERROR);
+	xferInitRead(&job, CMD_READ_WRITE_EEPROM, 0x00000000, bufPtr, numBytes);
+	monInit(&mon, monitor, &job);
+	do {
+		if ( monCancelled(&mon) ) {
+			errRender(error, "fx2ReadEEPROMInto(): Cancelled after %u of %u bytes", done, numBytes);
+			FAIL_RET(FX2_CANCELLED, cleanup);
+		}
+		uStatus = xferNext(device, &job, error);
+		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2ReadEEPROMInto()"A2_ERROR);
+		done = numBytes - job.remaining;
+		monUpdate(&mon, done);
+	} while ( !xferFinished(&job) );
+cleanup:
+	if ( bytesDone ) {
+		*bytesDone = done;
+	}
+	statsEnd(device, retVal);
+	return retVal;
+}
+
+// Write only those EEPROM pages whose contents differ from what is already there.
+//
+DLLEXPORT(FX2Status) fx2WriteEEPROMDiff(
+	struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes, const uint8 *current,
+	uint32 pageSize, uint32 *bytesWritten, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	USBStatus uStatus;
+	struct Buffer readBack = {0};
+	BufferStatus bStatus;
+	struct XferJob job;
+	uint32 offset = 0, length, written = 0;
+	statsBegin(device, FX2_STATS_WRITE_EEPROM);
+	if ( !pageSize ) {
+		pageSize = FX2_DEFAULT_PAGE_SIZE;
+	}
+	CHECK_STATUS(
+		!eepromBanksSupported(device, numBytes), FX2_USB_ERR, cleanup, "fx2WriteEEPROMDiff()"BANK_ERROR);
+	if ( !current ) {
+		// No cached copy, so read back what's on the chip now
+		bStatus = bufInitialise(&readBack, numBytes ? numBytes : 1, 0x00, error);
+		CHECK_STATUS(bStatus, FX2_BUF_ERR, cleanup, "fx2WriteEEPROMDiff()");
+		retVal = fx2ReadEEPROMBulk(device, numBytes, &readBack, error);
+		CHECK_STATUS(retVal, retVal, cleanup, "fx2WriteEEPROMDiff()");
+		current = readBack.data;
+	}
+	while ( xferNextDirtyRun(bufPtr, current, numBytes, pageSize, &offset, &length) ) {
+		xferInitWrite(&job, CMD_READ_WRITE_EEPROM, offset, bufPtr + offset, length);
+		do {
+			uStatus = xferNext(device, &job, error);
+			CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteEEPROMDiff()"A2_ERROR);
+		} while ( !xferFinished(&job) );
+		written += length;
+		offset += length;
+	}
+cleanup:
+	statsEnd(device, retVal);
+	if ( bytesWritten ) {
+		*bytesWritten = written;
+	}
+	if ( readBack.data ) {
+		bufDestroy(&readBack);
+	}
+	return retVal;
+}
+
+// Ask the firmware for its EEPROM page size and feature flags.
+//
+DLLEXPORT(FX2Status) fx2GetEEPROMConfig(
+	struct USBDevice *device, struct FX2EEPROMConfig *config, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	uint8 response[4];
+	USBStatus uStatus = devControlRead(
+		device,
+		CMD_EEPROM_CONFIG, // bRequest: EEPROM configuration
+		0x0000,            // wValue: unused
+		0x0000,            // wIndex: unused
+		response,          // buffer to receive the page size and features
+		4,                 // wLength: two little-endian words
+		XFER_TIMEOUT,      // timeout
+		error
+	);
+	CHECK_STATUS(
+		uStatus, FX2_USB_ERR, cleanup,
+		"fx2GetEEPROMConfig(): This firmware does not support EEPROM configuration");
+	config->pageSize = (uint16)(response[0] | (response[1] << 8));
+	config->features = (uint16)(response[2] | (response[3] << 8));
+cleanup:
+	return retVal;
+}
+
+// Tell the firmware what page size the attached EEPROM has.
+//
+DLLEXPORT(FX2Status) fx2SetEEPROMPageSize(
+	struct USBDevice *device, uint16 pageSize, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	USBStatus uStatus = devControlWrite(
+		device,
+		CMD_EEPROM_CONFIG, // bRequest: EEPROM configuration
+		pageSize,          // wValue: the new page size
+		0x0000,            // wIndex: unused
+		NULL,              // no data
+		0,                 // wLength: no data
+		XFER_TIMEOUT,      // timeout
+		error
+	);
+	CHECK_STATUS(
+		uStatus, FX2_USB_ERR, cleanup,
+		"fx2SetEEPROMPageSize(): The firmware rejected the page size, or does not support it");
+cleanup:
+	return retVal;
+}
+
+// Wait for the firmware to finish programming the data it has received over a bulk endpoint.
+//
+static FX2Status awaitBulkWrite(struct USBDevice *device, uint32 numBytes, const char **error) {
 	FX2Status retVal = FX2_SUCCESS;
 	USBStatus uStatus;
-	uint16 address = 0x0000;
-	uint16 bank = 0x0000;
-	while ( numBytes > BLOCK_SIZE ) {
-		uStatus = usbControlWrite(
+	uint8 response[5];
+	uint32 remaining;
+	uint32 polls = 0;
+	const uint32 maxPolls = XFER_TIMEOUT + numBytes / 8;  // about 1ms per poll
+	for ( ;; ) {
+		uStatus = devControlRead(
 			device,
-			CMD_READ_WRITE_EEPROM, // bRequest: EEPROM access
-			address,               // wValue: address to write
-			bank,                  // wIndex: bank (currently only 0 & 1 supported by firmware)
-			bufPtr,                // data to be written
-			BLOCK_SIZE,            // wLength: number of bytes to be written
-			5000,                  // timeout
+			CMD_EEPROM_BULK_WRITE, // bRequest: bulk write status
+			0x0000,                // wValue: unused
+			0x0000,                // wIndex: unused
+			response,              // remaining byte count & error flag
+			5,                     // wLength
+			XFER_TIMEOUT,          // timeout
 			error
 		);
-		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteEEPROM()"A2_ERROR);
-		numBytes -= BLOCK_SIZE;
-		bufPtr += BLOCK_SIZE;
-		address = (uint16)(address + BLOCK_SIZE);
-		if ( !address ) {
-			bank++;
+		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "awaitBulkWrite()");
+		CHECK_STATUS(
+			response[4], FX2_USB_ERR, cleanup,
+			"awaitBulkWrite(): The firmware reported an I2C error while programming the EEPROM");
+		remaining = (uint32)(
+			response[0] | (response[1] << 8) | (response[2] << 16) | ((uint32)response[3] << 24));
+		if ( !remaining ) {
+			break;
+		}
+		if ( ++polls == maxPolls ) {
+			errRender(error, "awaitBulkWrite(): Timed out with %u bytes still to program", remaining);
+			FAIL_RET(FX2_USB_ERR, cleanup);
 		}
+		statsPoll(device);
+		usleep(1000);
 	}
-	uStatus = usbControlWrite(
+cleanup:
+	return retVal;
+}
+
+// Stream the supplied buffer to EEPROM over EP2OUT, falling back to EP0 if necessary.
+//
+DLLEXPORT(FX2Status) fx2WriteEEPROMBulk(
+	struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	USBStatus uStatus;
+	struct FX2EEPROMConfig config;
+	uint8 length[4];
+	statsBegin(device, FX2_STATS_WRITE_EEPROM);
+	if (
+		numBytes == 0 ||
+		fx2GetEEPROMConfig(device, &config, NULL) != FX2_SUCCESS ||
+		!(config.features & FX2_FEATURE_BULK_WRITE) )
+	{
+		// This firmware can't do it, so use the control endpoint instead
+		retVal = fx2WriteEEPROM(device, bufPtr, numBytes, error);
+		goto cleanup;
+	}
+	length[0] = (uint8)numBytes;
+	length[1] = (uint8)(numBytes >> 8);
+	length[2] = (uint8)(numBytes >> 16);
+	length[3] = (uint8)(numBytes >> 24);
+	uStatus = devControlWrite(
+		device,
+		CMD_EEPROM_BULK_WRITE, // bRequest: start bulk write
+		0x0000,                // wValue: start address
+		0x0000,                // wIndex: bank
+		length,                // data: total number of bytes to follow on EP2OUT
+		4,                     // wLength: one little-endian longword
+		XFER_TIMEOUT,          // timeout
+		error
+	);
+	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteEEPROMBulk()");
+	uStatus = devBulkWrite(
 		device,
-		CMD_READ_WRITE_EEPROM, // bRequest: EEPROM access
-		address,               // wValue: address to write
-		bank,                  // wIndex: bank (currently only 0 & 1 supported by firmware)
-		bufPtr,                // data to be written
-		(uint16)numBytes,      // wLength: number of bytes to be written
-		5000,                  // timeout
+		EP_BULK_WRITE,                // EP2OUT
+		bufPtr,                       // data to be written
+		numBytes,                     // number of bytes to write
+		XFER_TIMEOUT + numBytes / 8,  // timeout: the firmware only frees buffers as it programs them
 		error
 	);
-	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteEEPROM()"A2_ERROR);
+	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteEEPROMBulk()");
+	retVal = awaitBulkWrite(device, numBytes, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "fx2WriteEEPROMBulk()");
 cleanup:
+	statsEnd(device, retVal);
 	return retVal;
 }
 
-// Read from the EEPROM into the supplied buffer, using the supplied VID/PID.
+// Read from the EEPROM as one long sequential read streamed over EP4IN, falling back to EP0 if
+// necessary. The buffer is only extended if the read succeeds.
 //
-DLLEXPORT(FX2Status) fx2ReadEEPROM(
+DLLEXPORT(FX2Status) fx2ReadEEPROMBulk(
 	struct USBDevice *device, uint32 numBytes, struct Buffer *i2cBuffer, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	BufferStatus bStatus;
+	bStatus = eepromReserveTail(i2cBuffer, numBytes, error);
+	CHECK_STATUS(bStatus, FX2_BUF_ERR, cleanup, "fx2ReadEEPROMBulk()");
+	retVal = fx2ReadEEPROMBulkInto(device, i2cBuffer->data + i2cBuffer->length, numBytes, error);
+	if ( retVal == FX2_SUCCESS ) {
+		i2cBuffer->length += numBytes;
+	} else {
+		eepromClearTail(i2cBuffer, numBytes);
+	}
+cleanup:
+	return retVal;
+}
+
+// As above, straight into the caller's memory.
+//
+DLLEXPORT(FX2Status) fx2ReadEEPROMBulkInto(
+	struct USBDevice *device, uint8 *bufPtr, uint32 numBytes, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	USBStatus uStatus;
+	struct FX2EEPROMConfig config;
+	uint8 length[4];
+	statsBegin(device, FX2_STATS_READ_EEPROM);
+	if (
+		numBytes == 0 ||
+		fx2GetEEPROMConfig(device, &config, NULL) != FX2_SUCCESS ||
+		!(config.features & FX2_FEATURE_BULK_READ) )
+	{
+		// This firmware can't do it, so use the control endpoint instead
+		retVal = fx2ReadEEPROMInto(device, bufPtr, numBytes, NULL, NULL, error);
+		goto cleanup;
+	}
+	length[0] = (uint8)numBytes;
+	length[1] = (uint8)(numBytes >> 8);
+	length[2] = (uint8)(numBytes >> 16);
+	length[3] = (uint8)(numBytes >> 24);
+	uStatus = devControlWrite(
+		device,
+		CMD_EEPROM_BULK_READ, // bRequest: start streaming read
+		0x0000,               // wValue: start address
+		0x0000,               // wIndex: bank
+		length,               // data: total number of bytes to send on EP4IN
+		4,                    // wLength: one little-endian longword
+		XFER_TIMEOUT,         // timeout
+		error
+	);
+	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2ReadEEPROMBulkInto()");
+	uStatus = devBulkRead(
+		device,
+		EP_BULK_READ,                 // EP4IN
+		bufPtr,                       // buffer to receive the data
+		numBytes,                     // number of bytes to read
+		XFER_TIMEOUT + numBytes / 8,  // timeout: limited by the I2C clock
+		error
+	);
+	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2ReadEEPROMBulkInto()");
+cleanup:
+	statsEnd(device, retVal);
+	return retVal;
+}
+
+// Ask the firmware for a CRC32 of a range of the EEPROM, falling back to reading it back and
+// calculating the CRC here if necessary.
+//
+DLLEXPORT(FX2Status) fx2CrcEEPROM(
+	struct USBDevice *device, uint32 address, uint32 numBytes, uint32 *crc, const char **error)
 {
 	FX2Status retVal = FX2_SUCCESS;
 	USBStatus uStatus;
+	struct FX2EEPROMConfig config;
+	struct Buffer readBack = {0};
 	BufferStatus bStatus;
-	uint16 address = 0x0000;
-	uint16 bank = 0x0000;
-	uint8 *bufPtr;
-	bStatus = bufAppendConst(i2cBuffer, 0x00, numBytes, error);
-	CHECK_STATUS(bStatus, FX2_BUF_ERR, cleanup, "fx2ReadEEPROM()");
-	bufPtr = i2cBuffer->data;
-	while ( numBytes > BLOCK_SIZE ) {
-		uStatus = usbControlRead(
+	uint8 request[4], response[8];
+	uint32 polls = 0, remaining;
+	const uint32 maxPolls = XFER_TIMEOUT + numBytes / 8;  // about 1ms per poll
+	statsBegin(device, FX2_STATS_VERIFY_EEPROM);
+	if (
+		fx2GetEEPROMConfig(device, &config, NULL) != FX2_SUCCESS ||
+		!(config.features & FX2_FEATURE_CRC32) )
+	{
+		// The firmware can't do it, so do it the slow way, which only reads from the start
+		CHECK_STATUS(
+			address != 0, FX2_USB_ERR, cleanup,
+			"fx2CrcEEPROM(): This firmware cannot calculate CRCs of arbitrary ranges");
+		bStatus = bufInitialise(&readBack, numBytes ? numBytes : 1, 0x00, error);
+		CHECK_STATUS(bStatus, FX2_BUF_ERR, cleanup, "fx2CrcEEPROM()");
+		retVal = fx2ReadEEPROMBulk(device, numBytes, &readBack, error);
+		CHECK_STATUS(retVal, retVal, cleanup, "fx2CrcEEPROM()");
+		*crc = fx2Crc32(0, readBack.data, numBytes);
+		goto cleanup;
+	}
+	request[0] = (uint8)numBytes;
+	request[1] = (uint8)(numBytes >> 8);
+	request[2] = (uint8)(numBytes >> 16);
+	request[3] = (uint8)(numBytes >> 24);
+	uStatus = devControlWrite(
+		device,
+		CMD_EEPROM_CRC32,        // bRequest: start CRC calculation
+		(uint16)address,         // wValue: start address
+		(uint16)(address >> 16), // wIndex: bank
+		request,                 // data: number of bytes to include
+		4,                       // wLength: one little-endian longword
+		XFER_TIMEOUT,            // timeout
+		error
+	);
+	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2CrcEEPROM()");
+	for ( ;; ) {
+		uStatus = devControlRead(
 			device,
-			CMD_READ_WRITE_EEPROM, // bRequest: EEPROM access
-			address,               // wValue: address to read
-			bank,                  // wIndex: bank (currently only 0 & 1 supported by firmware)
-			bufPtr,                // data to be written
-		   BLOCK_SIZE,            // wLength: number of bytes to be written
-			5000,                  // timeout
+			CMD_EEPROM_CRC32, // bRequest: CRC status
+			0x0000,           // wValue: unused
+			0x0000,           // wIndex: unused
+			response,         // remaining byte count & CRC
+			8,                // wLength
+			XFER_TIMEOUT,     // timeout
 			error
 		);
-		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteEEPROM()"A2_ERROR);
-		numBytes -= BLOCK_SIZE;
-		bufPtr += BLOCK_SIZE;
-		address = (uint16)(address + BLOCK_SIZE);
-		if ( !address ) {
-			bank++;
+		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2CrcEEPROM()");
+		remaining = (uint32)(
+			response[0] | (response[1] << 8) | (response[2] << 16) | ((uint32)response[3] << 24));
+		if ( !remaining ) {
+			break;
 		}
+		if ( ++polls == maxPolls ) {
+			errRender(error, "fx2CrcEEPROM(): Timed out with %u bytes still to read", remaining);
+			FAIL_RET(FX2_USB_ERR, cleanup);
+		}
+		statsPoll(device);
+		usleep(1000);
 	}
-	uStatus = usbControlRead(
-		device,
-		CMD_READ_WRITE_EEPROM, // bRequest: EEPROM access
-		address,               // wValue: address to read
-		bank,                  // wIndex: bank (currently only 0 & 1 supported by firmware)
-		bufPtr,                // data to be written
-		(uint16)numBytes,      // wLength: number of bytes to be written
-		5000,                  // timeout
-		error
-	);
-	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteEEPROM()"A2_ERROR);
+	*crc = (uint32)(
+		response[4] | (response[5] << 8) | (response[6] << 16) | ((uint32)response[7] << 24));
+cleanup:
+	statsEnd(device, retVal);
+	if ( readBack.data ) {
+		bufDestroy(&readBack);
+	}
+	return retVal;
+}
+
+// Check the EEPROM contents against the supplied buffer by comparing CRCs.
+//
+DLLEXPORT(FX2Status) fx2VerifyEEPROM(
+	struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes, bool *isMatch,
+	const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	uint32 crc;
+	retVal = fx2CrcEEPROM(device, 0x00000000, numBytes, &crc, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "fx2VerifyEEPROM()");
+	*isMatch = (crc == fx2Crc32(0, bufPtr, numBytes));
 cleanup:
 	return retVal;
 }
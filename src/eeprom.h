@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BANK_ERROR ": This firmware cannot address EEPROMs larger than 64KiB"
+
+// Transfers which go past the first 64KiB need the firmware to honour the bank in wIndex; older
+// firmwares ignore it, and would silently wrap around and overwrite the start of the EEPROM.
+//
+bool eepromBanksSupported(struct USBDevice *device, uint32 numBytes);
+
+// Make room for numBytes after the buffer's contents without changing its length, so a read can
+// go straight into the spare capacity and the length be extended by however much arrived. Only a
+// buffer which actually has to grow pays for filling the new space.
+//
+BufferStatus eepromReserveTail(struct Buffer *buf, uint32 numBytes, const char **error);
+
+// Spare capacity must hold the fill byte, so after a read which stopped early, overwrite whatever
+// reached the numBytes after the buffer's (already extended) contents.
+//
+void eepromClearTail(struct Buffer *buf, uint32 numBytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
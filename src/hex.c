@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+#include "mapfile.h"
+
+// Output is gathered into chunks this big before each write.
+//
+#define SINK_SIZE 65536
+
+// Nibble values of the hex digits, and 0xFF for everything else.
+//
+#define X 0xFF
+static const uint8 nibbleTable[256] = {
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  0, 1, 2, 3, 4, 5, 6, 7, 8, 9, X, X, X, X, X, X,
+	X,10,11,12,13,14,15, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X,10,11,12,13,14,15, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+	X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,  X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X
+};
+#undef X
+
+static const char digitTable[] = "0123456789ABCDEF";
+
+// Decode numBytes pairs of hex digits. Returns false if any character is not a hex digit. The
+// nibbles are ORed together and checked once at the end, rather than after every lookup.
+//
+static bool decodeBytes(const char *src, uint8 *dst, size_t numBytes) {
+	uint8 bad = 0x00;
+	while ( numBytes-- ) {
+		const uint8 hi = nibbleTable[(uint8)src[0]];
+		const uint8 lo = nibbleTable[(uint8)src[1]];
+		bad |= hi | lo;
+		*dst++ = (uint8)((hi << 4) | (lo & 0x0F));
+		src += 2;
+	}
+	return !(bad & 0xF0);
+}
+
+// Parse I8HEX text (with the I16HEX/I32HEX extended address records) into data and mask buffers.
+//
+DLLEXPORT(HexStatus) hexParse(
+	const char *text, size_t length, struct Buffer *data, struct Buffer *mask,
+	const char **error)
+{
+	HexStatus retVal = HEX_SUCCESS;
+	const char *ptr = text;
+	const char *const end = text + length;
+	uint8 record[5 + 255];  // length, address, type, payload, checksum
+	uint32 base = 0, line = 1, address;
+	size_t recordLength, i;
+	uint8 sum;
+	BufferStatus bStatus;
+	while ( ptr < end ) {
+		// Skip blank lines and line endings
+		//
+		if ( *ptr == '\n' ) {
+			line++;
+			ptr++;
+			continue;
+		}
+		if ( *ptr == '\r' || *ptr == ' ' || *ptr == '\t' ) {
+			ptr++;
+			continue;
+		}
+		if ( *ptr != ':' || end - ptr < 11 ) {
+			errRender(error, "hexParse(): Syntax error on line %u", line);
+			FAIL_RET(HEX_SYNTAX_ERROR, cleanup);
+		}
+
+		// Decode the whole record, then check its checksum in one go
+		//
+		if ( !decodeBytes(ptr + 1, record, 1) ) {
+			errRender(error, "hexParse(): Syntax error on line %u", line);
+			FAIL_RET(HEX_SYNTAX_ERROR, cleanup);
+		}
+		recordLength = 5U + record[0];
+		if ( (size_t)(end - ptr) < 1 + 2*recordLength ||
+		     !decodeBytes(ptr + 3, record + 1, recordLength - 1) )
+		{
+			errRender(error, "hexParse(): Syntax error on line %u", line);
+			FAIL_RET(HEX_SYNTAX_ERROR, cleanup);
+		}
+		sum = 0;
+		for ( i = 0; i < recordLength; i++ ) {
+			sum = (uint8)(sum + record[i]);
+		}
+		if ( sum ) {
+			errRender(error, "hexParse(): Checksum mismatch on line %u", line);
+			FAIL_RET(HEX_CHECKSUM_ERROR, cleanup);
+		}
+		ptr += 1 + 2*recordLength;
+
+		switch ( record[3] ) {
+		case 0x00:
+			// Data: write it, and mark it as defined
+			address = base + (uint32)((record[1] << 8) | record[2]);
+			bStatus = bufWriteBlock(data, address, record + 4, record[0], error);
+			CHECK_STATUS(bStatus, HEX_BUFFER_ERROR, cleanup, "hexParse()");
+			bStatus = bufWriteConst(mask, address, 0x01, record[0], error);
+			CHECK_STATUS(bStatus, HEX_BUFFER_ERROR, cleanup, "hexParse()");
+			break;
+		case 0x01:
+			// End of file: ignore anything after it
+			goto cleanup;
+		case 0x02:
+		case 0x04:
+			if ( record[0] != 2 ) {
+				errRender(error, "hexParse(): Bad extended address record on line %u", line);
+				FAIL_RET(HEX_SYNTAX_ERROR, cleanup);
+			}
+			if ( record[3] == 0x02 ) {
+				// Extended segment address
+				base = (uint32)((record[4] << 8) | record[5]) << 4;
+			} else {
+				// Extended linear address
+				base = (uint32)((record[4] << 8) | record[5]) << 16;
+			}
+			break;
+		case 0x03:
+		case 0x05:
+			// Start address: meaningless for the FX2LP
+			break;
+		default:
+			errRender(
+				error, "hexParse(): Unsupported record type 0x%02X on line %u", record[3], line);
+			FAIL_RET(HEX_SYNTAX_ERROR, cleanup);
+		}
+	}
+cleanup:
+	return retVal;
+}
+
+// Parse an I8HEX file, reading it through a memory mapping.
+//
+DLLEXPORT(HexStatus) hexReadFile(
+	const char *fileName, struct Buffer *data, struct Buffer *mask, const char **error)
+{
+	HexStatus retVal = HEX_SUCCESS;
+	struct MappedFile map = {NULL, 0, -1};
+	if ( mapRead(&map, fileName) ) {
+		errRenderStd(error);
+		errPrefix(error, "hexReadFile(): Cannot read %s", fileName);
+		FAIL_RET(HEX_FILE_ERROR, cleanup);
+	}
+	retVal = hexParse((const char *)map.data, map.length, data, mask, error);
+	if ( retVal ) {
+		errPrefix(error, "hexReadFile(%s)", fileName);
+		FAIL_RET(retVal, cleanup);
+	}
+cleanup:
+	mapClose(&map);
+	return retVal;
+}
+
+// Output is formatted into a fixed chunk and handed on whenever it fills up.
+//
+struct Sink {
+	char chunk[SINK_SIZE];
+	size_t used;
+	HexStatus (*flush)(struct Sink *sink, const char **error);
+	void *target;
+};
+
+static HexStatus flushToBuffer(struct Sink *sink, const char **error) {
+	HexStatus retVal = HEX_SUCCESS;
+	BufferStatus bStatus = bufAppendBlock(
+		(struct Buffer *)sink->target, (const uint8 *)sink->chunk, sink->used, error);
+	CHECK_STATUS(bStatus, HEX_BUFFER_ERROR, cleanup, "hexFormat()");
+	sink->used = 0;
+cleanup:
+	return retVal;
+}
+
+static HexStatus flushToFile(struct Sink *sink, const char **error) {
+	HexStatus retVal = HEX_SUCCESS;
+	if ( fwrite(sink->chunk, 1, sink->used, (FILE *)sink->target) != sink->used ) {
+		errRenderStd(error);
+		errPrefix(error, "hexWriteFile()");
+		FAIL_RET(HEX_FILE_ERROR, cleanup);
+	}
+	sink->used = 0;
+cleanup:
+	return retVal;
+}
+
+// Append one record. The longest is 1 + 2*(5+255) + 1 characters.
+//
+static HexStatus emitRecord(
+	struct Sink *sink, uint8 type, uint16 address, const uint8 *payload, uint8 length,
+	const char **error)
+{
+	HexStatus retVal = HEX_SUCCESS;
+	char *out;
+	uint8 sum, byte;
+	size_t i;
+	if ( SINK_SIZE - sink->used < 2*(5+255) + 2 ) {
+		retVal = sink->flush(sink, error);
+		CHECK_STATUS(retVal, retVal, cleanup, "emitRecord()");
+	}
+	out = sink->chunk + sink->used;
+	#define PUT(b) byte = (b); sum = (uint8)(sum + byte); \
+		*out++ = digitTable[byte >> 4]; *out++ = digitTable[byte & 0x0F]
+	*out++ = ':';
+	sum = 0;
+	PUT(length);
+	PUT((uint8)(address >> 8));
+	PUT((uint8)address);
+	PUT(type);
+	for ( i = 0; i < length; i++ ) {
+		PUT(payload[i]);
+	}
+	PUT((uint8)(0x100 - sum));
+	#undef PUT
+	*out++ = '\n';
+	sink->used = (size_t)(out - sink->chunk);
+cleanup:
+	return retVal;
+}
+
+// Emit the defined bytes as records of at most recordSize bytes. Records never span a hole or a
+// 64KiB boundary; crossing a boundary emits an extended linear address record.
+//
+static HexStatus formatRecords(
+	struct Sink *sink, const struct Buffer *data, const struct Buffer *mask, uint8 recordSize,
+	const char **error)
+{
+	HexStatus retVal = HEX_SUCCESS;
+	const size_t length = data->length < mask->length ? data->length : mask->length;
+	size_t i = 0, run;
+	uint32 upper = 0;
+	uint8 ext[2];
+	if ( recordSize == 0 ) {
+		recordSize = 16;
+	}
+	for ( ;; ) {
+		while ( i < length && !mask->data[i] ) {
+			i++;
+		}
+		if ( i == length ) {
+			break;
+		}
+		if ( (i >> 16) != upper ) {
+			upper = (uint32)(i >> 16);
+			ext[0] = (uint8)(upper >> 8);
+			ext[1] = (uint8)upper;
+			retVal = emitRecord(sink, 0x04, 0x0000, ext, 2, error);
+			CHECK_STATUS(retVal, retVal, cleanup, "formatRecords()");
+		}
+		run = 1;
+		while ( run < recordSize && i + run < length && mask->data[i + run] &&
+		        ((i + run) & 0xFFFF) != 0 )
+		{
+			run++;
+		}
+		retVal = emitRecord(sink, 0x00, (uint16)i, data->data + i, (uint8)run, error);
+		CHECK_STATUS(retVal, retVal, cleanup, "formatRecords()");
+		i += run;
+	}
+	retVal = emitRecord(sink, 0x01, 0x0000, NULL, 0, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "formatRecords()");
+	retVal = sink->flush(sink, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "formatRecords()");
+cleanup:
+	return retVal;
+}
+
+// Format the data/mask buffers as I8HEX text, appended to the text buffer.
+//
+DLLEXPORT(HexStatus) hexFormat(
+	const struct Buffer *data, const struct Buffer *mask, uint8 recordSize, struct Buffer *text,
+	const char **error)
+{
+	HexStatus retVal = HEX_SUCCESS;
+	struct Sink *const sink = (struct Sink *)malloc(sizeof(struct Sink));
+	CHECK_STATUS(!sink, HEX_BUFFER_ERROR, cleanup, "hexFormat(): Out of memory");
+	sink->used = 0;
+	sink->flush = flushToBuffer;
+	sink->target = text;
+	retVal = formatRecords(sink, data, mask, recordSize, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "hexFormat()");
+cleanup:
+	free(sink);
+	return retVal;
+}
+
+// Write the data/mask buffers to an I8HEX file, in large chunks.
+//
+DLLEXPORT(HexStatus) hexWriteFile(
+	const struct Buffer *data, const struct Buffer *mask, const char *fileName, uint8 recordSize,
+	const char **error)
+{
+	HexStatus retVal = HEX_SUCCESS;
+	struct Sink *const sink = (struct Sink *)malloc(sizeof(struct Sink));
+	FILE *file = NULL;
+	CHECK_STATUS(!sink, HEX_BUFFER_ERROR, cleanup, "hexWriteFile(): Out of memory");
+	file = fopen(fileName, "wb");
+	if ( !file ) {
+		errRenderStd(error);
+		errPrefix(error, "hexWriteFile(): Cannot create %s", fileName);
+		FAIL_RET(HEX_FILE_ERROR, cleanup);
+	}
+	sink->used = 0;
+	sink->flush = flushToFile;
+	sink->target = file;
+	retVal = formatRecords(sink, data, mask, recordSize, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "hexWriteFile()");
+	if ( fclose(file) ) {
+		file = NULL;
+		errRenderStd(error);
+		errPrefix(error, "hexWriteFile(): Cannot write %s", fileName);
+		FAIL_RET(HEX_FILE_ERROR, cleanup);
+	}
+	file = NULL;
+cleanup:
+	if ( file ) {
+		fclose(file);
+	}
+	free(sink);
+	return retVal;
+}
@@ -15,11 +15,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <stddef.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <makestuff/common.h>
 #include <makestuff/liberror.h>
 #include <makestuff/libbuffer.h>
 #include <makestuff/libfx2loader.h>
+#include "scan.h"
+#include "seg.h"
 
 #define LSB(x) (uint8)((x) & 0xFF)
 #define MSB(x) (uint8)((x) >> 8)
@@ -53,7 +56,7 @@ static I2CStatus dumpChunk(
 {
 	I2CStatus retVal = I2C_SUCCESS;
 	BufferStatus bStatus;
-	size_t i, startBlock;
+	size_t startBlock;
 	if ( length == 0 ) {
 		return I2C_SUCCESS;
 	}
@@ -68,32 +71,33 @@ static I2CStatus dumpChunk(
 	bStatus = bufAppendWordBE(destination, address, error);
 	CHECK_STATUS(bStatus, I2C_BUFFER_ERROR, cleanup, "dumpChunk()");
 	startBlock = destination->length;
-	bStatus = bufAppendBlock(destination, sourceData->data + address, length, error);
-	CHECK_STATUS(bStatus, I2C_BUFFER_ERROR, cleanup, "dumpChunk()");
-	for ( i = 0; i < length; i++ ) {
-		if ( sourceMask->data[address + i] == 0x00 ) {
-			destination->data[startBlock + i] = 0x00;
-		}
+	if ( destination->capacity - startBlock < length ) {
+		// Let libbuffer grow the buffer; the contents are overwritten below
+		bStatus = bufAppendConst(destination, 0x00, length, error);
+		CHECK_STATUS(bStatus, I2C_BUFFER_ERROR, cleanup, "dumpChunk()");
+	} else {
+		destination->length = startBlock + length;
 	}
+	scanMaskedCopy(
+		destination->data + startBlock, sourceData->data + address, sourceMask->data + address,
+		length);
 cleanup:
 	return retVal;
 }
 
-// Build EEPROM records from the data/mask source buffers and write to the destination buffer.
+// Build EEPROM records from the data/mask source buffers using the original heuristic: a block is
+// only split on a run of four or more holes.
 //
-DLLEXPORT(I2CStatus) i2cWritePromRecords(
+static I2CStatus writeHeuristic(
 	struct Buffer *destination, const struct Buffer *sourceData, const struct Buffer *sourceMask,
 	const char **error)
 {
 	I2CStatus retVal = I2C_SUCCESS;
-	uint16 i = 0, chunkStart;
-	CHECK_STATUS(
-		destination->length != 8 || destination->data[0] != 0xC2, I2C_NOT_INITIALISED, cleanup,
-		"i2cWritePromRecords(): the buffer was not initialised");
-	while ( i < sourceData->length && !sourceMask->data[i] ) {
-		i++;
-	}
-	if ( i == sourceData->length ) {
+	const uint8 *const mask = sourceMask->data;
+	const size_t length = sourceData->length;
+	size_t i, chunkStart;
+	i = scanFindNonZero(mask, 0, length);
+	if ( i == length ) {
 		return I2C_SUCCESS;  // There are no data
 	}
 
@@ -103,14 +107,12 @@ DLLEXPORT(I2CStatus) i2cWritePromRecords(
 	do {
 		// Find the end of this block of ones
 		//
-		while ( i < sourceData->length && sourceMask->data[i] ) {
-			i++;
-		}
-		if ( i == sourceData->length ) {
+		i = scanFindZero(mask, i, length);
+		if ( i == length ) {
 			retVal = dumpChunk(
-				destination, sourceData, sourceMask, chunkStart,
-				(uint16)(sourceData->length - chunkStart), error);
-			CHECK_STATUS(retVal, retVal, cleanup, "i2cWritePromRecords()");
+				destination, sourceData, sourceMask, (uint16)chunkStart,
+				(uint16)(length - chunkStart), error);
+			CHECK_STATUS(retVal, retVal, cleanup, "writeHeuristic()");
 			break;  // out of do...while
 		}
 
@@ -121,50 +123,179 @@ DLLEXPORT(I2CStatus) i2cWritePromRecords(
 		// length is 1023 bytes, it's actually good to break on FOUR bytes - it costs nothing
 		// extra, but it hopefully keeps the number of forced (1023-byte) breaks to a minimum.
 		//
-		if ( i < sourceData->length-4 ) {
+		if ( i + 4 < length ) {
 			// We are not within five bytes of the end
 			//
-			if ( !sourceMask->data[i] && !sourceMask->data[i+1] &&
-			     !sourceMask->data[i+2] && !sourceMask->data[i+3] )
-			{
+			if ( !mask[i] && !mask[i+1] && !mask[i+2] && !mask[i+3] ) {
 				// Yes, let's split it - dump the current block and start a fresh one
 				//
 				retVal = dumpChunk(
-					destination, sourceData, sourceMask, chunkStart, (uint16)(i - chunkStart), error);
-				CHECK_STATUS(retVal, retVal, cleanup, "i2cWritePromRecords()");
+					destination, sourceData, sourceMask, (uint16)chunkStart,
+					(uint16)(i - chunkStart), error);
+				CHECK_STATUS(retVal, retVal, cleanup, "writeHeuristic()");
 				
 				// Skip these four...we know they're zero
 				//
-				i = (uint16)(i + 4);
+				i += 4;
 				
 				// Find the next block of ones
 				//
-				while ( i < sourceMask->length && !sourceMask->data[i] ) {
-					i++;
-				}
+				i = scanFindNonZero(mask, i, sourceMask->length);
 				chunkStart = i;
 			} else {
 				// This is four or fewer zeros - not worth splitting for so skip over them
 				//
-				while ( !sourceMask->data[i] ) {
-					i++;
-				}
+				i = scanFindNonZero(mask, i, length);
 			}
 		} else {
 			// We are within four bytes of the end - include the remainder, whatever it is
 			//
 			retVal = dumpChunk(
-				destination, sourceData, sourceMask, chunkStart,
+				destination, sourceData, sourceMask, (uint16)chunkStart,
 				(uint16)(sourceMask->length - chunkStart), error);
-			CHECK_STATUS(retVal, retVal, cleanup, "i2cWritePromRecords()");
+			CHECK_STATUS(retVal, retVal, cleanup, "writeHeuristic()");
 			break; // out of do...while
 		}
-	} while ( i < sourceData->length );
+	} while ( i < length );
+
+cleanup:
+	return retVal;
+}
+
+// Build EEPROM records from the data/mask source buffers using an exact segmentation, chosen to
+// minimise a weighted sum of record count and payload size.
+//
+I2CStatus i2cWriteOptimal(
+	struct Buffer *destination, const struct Buffer *sourceData, const struct Buffer *sourceMask,
+	uint32 recordCost, uint32 byteCost, const char **error)
+{
+	I2CStatus retVal = I2C_SUCCESS;
+	struct SegRecord *records = NULL;
+	size_t numRecords, i;
+	retVal = segOptimal(
+		sourceMask->data, sourceData->length, recordCost, byteCost, &records, &numRecords, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "i2cWriteOptimal()");
+	for ( i = 0; i < numRecords; i++ ) {
+		retVal = dumpChunk(
+			destination, sourceData, sourceMask, records[i].address, records[i].length, error);
+		CHECK_STATUS(retVal, retVal, cleanup, "i2cWriteOptimal()");
+	}
+cleanup:
+	free(records);
+	return retVal;
+}
+
+// Build EEPROM records from the data/mask source buffers and write to the destination buffer,
+// using the requested segmentation strategy.
+//
+DLLEXPORT(I2CStatus) i2cWritePromRecordsEx(
+	struct Buffer *destination, const struct Buffer *sourceData, const struct Buffer *sourceMask,
+	I2CSegmentation strategy, const char **error)
+{
+	I2CStatus retVal = I2C_SUCCESS;
+	CHECK_STATUS(
+		destination->length != 8 || destination->data[0] != 0xC2, I2C_NOT_INITIALISED, cleanup,
+		"i2cWritePromRecordsEx(): the buffer was not initialised");
+	if ( strategy == I2C_SEG_MIN_BYTES ) {
+		// Each record costs four bytes of header
+		retVal = i2cWriteOptimal(destination, sourceData, sourceMask, 4, 1, error);
+	} else if ( strategy == I2C_SEG_MIN_RECORDS ) {
+		// Any record outweighs every byte of a 64KiB image, so bytes only break ties
+		retVal = i2cWriteOptimal(destination, sourceData, sourceMask, 1UL<<20, 1, error);
+	} else if ( strategy == I2C_SEG_MIN_BOOT_TIME ) {
+		// Use the nominal timings at whatever bus speed the header already selects
+		struct I2CBootModel model;
+		i2cDefaultBootModel(&model);
+		model.fastI2C = (destination->data[7] & CONFIG_BYTE_400KHZ) != 0;
+		retVal = i2cWritePromRecordsBoot(destination, sourceData, sourceMask, &model, error);
+	} else {
+		retVal = writeHeuristic(destination, sourceData, sourceMask, error);
+	}
+	CHECK_STATUS(retVal, retVal, cleanup, "i2cWritePromRecordsEx()");
+cleanup:
+	return retVal;
+}
 
+// Build EEPROM records from the data/mask source buffers and write to the destination buffer.
+//
+DLLEXPORT(I2CStatus) i2cWritePromRecords(
+	struct Buffer *destination, const struct Buffer *sourceData, const struct Buffer *sourceMask,
+	const char **error)
+{
+	I2CStatus retVal = I2C_SUCCESS;
+	CHECK_STATUS(
+		destination->length != 8 || destination->data[0] != 0xC2, I2C_NOT_INITIALISED, cleanup,
+		"i2cWritePromRecords(): the buffer was not initialised");
+	retVal = writeHeuristic(destination, sourceData, sourceMask, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "i2cWritePromRecords()");
 cleanup:
 	return retVal;
 }
 
+// Validate the header and record chain of a C2 image, and set up the iterator to walk it.
+//
+DLLEXPORT(I2CStatus) i2cIterInit(
+	struct I2CRecordIter *iter, const uint8 *image, size_t length, const char **error)
+{
+	I2CStatus retVal = I2C_SUCCESS;
+	const uint8 *ptr = image + 8;
+	const uint8 *const ptrEnd = image + length;
+	uint16 recLength;
+	CHECK_STATUS(
+		length < 8 || image[0] != 0xC2, I2C_NOT_INITIALISED, cleanup,
+		"i2cIterInit(): the EEPROM records appear to be corrupt/uninitialised");
+	iter->vid = (uint16)(image[1] | (image[2] << 8));
+	iter->pid = (uint16)(image[3] | (image[4] << 8));
+	iter->did = (uint16)(image[5] | (image[6] << 8));
+	iter->configByte = image[7];
+	iter->hasTerminator = false;
+	iter->trailing = ptrEnd;
+	iter->trailingLength = 0;
+	iter->numRecords = 0;
+	iter->next = ptr;
+
+	// Walk the chain, checking each record fits in the image
+	//
+	while ( ptr < ptrEnd ) {
+		CHECK_STATUS(
+			ptrEnd - ptr < 4, I2C_NOT_INITIALISED, cleanup,
+			"i2cIterInit(): the EEPROM records are truncated");
+		recLength = (uint16)(((ptr[0] << 8) + ptr[1]) & 0x03FF);
+		CHECK_STATUS(
+			(size_t)(ptrEnd - ptr) < 4U + recLength, I2C_NOT_INITIALISED, cleanup,
+			"i2cIterInit(): the EEPROM records are truncated");
+		if ( ptr[0] & 0x80 ) {
+			iter->hasTerminator = true;
+			iter->terminator.address = (uint16)((ptr[2] << 8) + ptr[3]);
+			iter->terminator.length = recLength;
+			iter->terminator.data = ptr + 4;
+			iter->end = ptr;
+			iter->trailing = ptr + 4 + recLength;
+			iter->trailingLength = (size_t)(ptrEnd - iter->trailing);
+			goto cleanup;
+		}
+		iter->numRecords++;
+		ptr += 4 + recLength;
+	}
+	iter->end = ptrEnd;
+cleanup:
+	return retVal;
+}
+
+// Return the next data record, if there is one.
+//
+DLLEXPORT(bool) i2cIterNext(struct I2CRecordIter *iter, struct I2CRecord *record) {
+	const uint8 *const ptr = iter->next;
+	if ( ptr >= iter->end ) {
+		return false;
+	}
+	record->length = (uint16)(((ptr[0] << 8) + ptr[1]) & 0x03FF);
+	record->address = (uint16)((ptr[2] << 8) + ptr[3]);
+	record->data = ptr + 4;
+	iter->next = ptr + 4 + record->length;
+	return true;
+}
+
 // Read EEPROM records from the source buffer and write the decoded data to the data/mask
 // destination buffers.
 //
@@ -173,30 +304,22 @@ DLLEXPORT(I2CStatus) i2cReadPromRecords(
 	const char **error)
 {
 	I2CStatus retVal = I2C_SUCCESS;
-	uint16 chunkAddress, chunkLength;
-	const uint8 *ptr = source->data;
-	const uint8 *const ptrEnd = ptr + source->length;
+	struct I2CRecordIter iter;
+	struct I2CRecord record;
 	BufferStatus bStatus;
 	CHECK_STATUS(
-		source->length < 8+5 || ptr[0] != 0xC2, I2C_NOT_INITIALISED, cleanup,
+		source->length < 8+5 || source->data[0] != 0xC2, I2C_NOT_INITIALISED, cleanup,
 		"i2cReadPromRecords(): the EEPROM records appear to be corrupt/uninitialised");
 	CHECK_STATUS(
 		destData->length != 0 || destMask->length != 0, I2C_DEST_BUFFER_NOT_EMPTY, cleanup,
 		"i2cReadPromRecords(): the destination buffer is not empty");
-	ptr += 8;  // skip over the header
-	while ( ptr < ptrEnd ) {
-		chunkLength = (uint16)((ptr[0] << 8) + ptr[1]);
-		chunkAddress = (uint16)((ptr[2] << 8) + ptr[3]);
-		if ( chunkLength & 0x8000 ) {
-			break;
-		}
-		chunkLength &= 0x03FF;
-		ptr += 4;
-		bStatus = bufWriteBlock(destData, chunkAddress, ptr, chunkLength, error);
+	retVal = i2cIterInit(&iter, source->data, source->length, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "i2cReadPromRecords()");
+	while ( i2cIterNext(&iter, &record) ) {
+		bStatus = bufWriteBlock(destData, record.address, record.data, record.length, error);
 		CHECK_STATUS(bStatus, I2C_BUFFER_ERROR, cleanup, "i2cReadPromRecords()");
-		bStatus = bufWriteConst(destMask, chunkAddress, 0x01, chunkLength, error);
+		bStatus = bufWriteConst(destMask, record.address, 0x01, record.length, error);
 		CHECK_STATUS(bStatus, I2C_BUFFER_ERROR, cleanup, "i2cReadPromRecords()");
-		ptr += chunkLength;
 	}
 cleanup:
 	return retVal;
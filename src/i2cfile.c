@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libfx2loader.h>
+#include "mapfile.h"
+#include "seg.h"
+
+// Decode the records of a mapped C2 image straight into a mapped binary file. Anything after the
+// terminating record (e.g the unused part of an EEPROM dump) is never touched.
+//
+DLLEXPORT(I2CStatus) i2cConvertIicToBix(
+	const char *iicFile, const char *bixFile, const char **error)
+{
+	I2CStatus retVal = I2C_SUCCESS;
+	struct MappedFile in = {NULL, 0, -1}, out = {NULL, 0, -1};
+	struct I2CRecordIter iter;
+	struct I2CRecord record;
+	size_t length = 0;
+	if ( mapRead(&in, iicFile) ) {
+		errRenderStd(error);
+		errPrefix(error, "i2cConvertIicToBix(): Cannot read %s", iicFile);
+		FAIL_RET(I2C_FILE_ERROR, cleanup);
+	}
+	retVal = i2cIterInit(&iter, in.data, in.length, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "i2cConvertIicToBix()");
+
+	// The output runs to the end of the highest record
+	//
+	while ( i2cIterNext(&iter, &record) ) {
+		if ( (size_t)record.address + record.length > length ) {
+			length = (size_t)record.address + record.length;
+		}
+	}
+	if ( mapCreate(&out, bixFile, length) ) {
+		errRenderStd(error);
+		errPrefix(error, "i2cConvertIicToBix(): Cannot create %s", bixFile);
+		FAIL_RET(I2C_FILE_ERROR, cleanup);
+	}
+
+	// The new file reads as zeros, so the holes are already done
+	//
+	retVal = i2cIterInit(&iter, in.data, in.length, error);
+	CHECK_STATUS(retVal, retVal, cleanup, "i2cConvertIicToBix()");
+	while ( i2cIterNext(&iter, &record) ) {
+		memcpy(out.data + record.address, record.data, record.length);
+	}
+	if ( mapClose(&out) ) {
+		errRenderStd(error);
+		errPrefix(error, "i2cConvertIicToBix(): Cannot write %s", bixFile);
+		FAIL_RET(I2C_FILE_ERROR, cleanup);
+	}
+cleanup:
+	mapClose(&out);
+	mapClose(&in);
+	return retVal;
+}
+
+// Encode a mapped binary file straight into a mapped C2 image. Every byte of a .bix file is
+// defined, so the records are simply consecutive 1023-byte slices, exactly as
+// i2cWritePromRecords() would lay them out.
+//
+DLLEXPORT(I2CStatus) i2cConvertBixToIic(
+	const char *bixFile, const char *iicFile, uint8 configByte, const char **error)
+{
+	I2CStatus retVal = I2C_SUCCESS;
+	struct MappedFile in = {NULL, 0, -1}, out = {NULL, 0, -1};
+	const uint8 lastRecord[] = {0x80, 0x01, 0xE6, 0x00, 0x00};
+	size_t numRecords, address, chunk;
+	uint8 *ptr;
+	if ( mapRead(&in, bixFile) ) {
+		errRenderStd(error);
+		errPrefix(error, "i2cConvertBixToIic(): Cannot read %s", bixFile);
+		FAIL_RET(I2C_FILE_ERROR, cleanup);
+	}
+	CHECK_STATUS(
+		in.length > 0x10000, I2C_FILE_ERROR, cleanup,
+		"i2cConvertBixToIic(): The file is larger than the FX2LP's 64KiB address space");
+	numRecords = (in.length + SEG_MAX_RECORD - 1) / SEG_MAX_RECORD;
+	if ( mapCreate(&out, iicFile, 8 + 4*numRecords + in.length + sizeof(lastRecord)) ) {
+		errRenderStd(error);
+		errPrefix(error, "i2cConvertBixToIic(): Cannot create %s", iicFile);
+		FAIL_RET(I2C_FILE_ERROR, cleanup);
+	}
+	ptr = out.data;
+	*ptr++ = 0xC2;
+	memset(ptr, 0x00, 6);  // VID, PID & DID are unused by C2 loaders
+	ptr += 6;
+	*ptr++ = configByte;
+	for ( address = 0; address < in.length; address += chunk ) {
+		chunk = in.length - address;
+		if ( chunk > SEG_MAX_RECORD ) {
+			chunk = SEG_MAX_RECORD;
+		}
+		*ptr++ = (uint8)(chunk >> 8);
+		*ptr++ = (uint8)chunk;
+		*ptr++ = (uint8)(address >> 8);
+		*ptr++ = (uint8)address;
+		memcpy(ptr, in.data + address, chunk);
+		ptr += chunk;
+	}
+	memcpy(ptr, lastRecord, sizeof(lastRecord));
+	if ( mapClose(&out) ) {
+		errRenderStd(error);
+		errPrefix(error, "i2cConvertBixToIic(): Cannot write %s", iicFile);
+		FAIL_RET(I2C_FILE_ERROR, cleanup);
+	}
+cleanup:
+	mapClose(&out);
+	mapClose(&in);
+	return retVal;
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mapfile.h"
+
+int mapRead(struct MappedFile *map, const char *path) {
+	struct stat st;
+	void *ptr;
+	map->data = NULL;
+	map->length = 0;
+	map->fd = open(path, O_RDONLY);
+	if ( map->fd < 0 ) {
+		return -1;
+	}
+	if ( fstat(map->fd, &st) ) {
+		goto fail;
+	}
+	map->length = (size_t)st.st_size;
+	if ( map->length ) {
+		// Zero-length files can't be mapped, but are still valid (empty) input
+		ptr = mmap(NULL, map->length, PROT_READ, MAP_PRIVATE, map->fd, 0);
+		if ( ptr == MAP_FAILED ) {
+			goto fail;
+		}
+		map->data = (uint8 *)ptr;
+	}
+	return 0;
+fail:
+	{
+		const int saved = errno;
+		close(map->fd);
+		map->fd = -1;
+		errno = saved;
+	}
+	return -1;
+}
+
+int mapCreate(struct MappedFile *map, const char *path, size_t length) {
+	void *ptr;
+	map->data = NULL;
+	map->length = length;
+	map->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if ( map->fd < 0 ) {
+		return -1;
+	}
+	if ( ftruncate(map->fd, (off_t)length) ) {
+		goto fail;
+	}
+	if ( length ) {
+		ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, map->fd, 0);
+		if ( ptr == MAP_FAILED ) {
+			goto fail;
+		}
+		map->data = (uint8 *)ptr;
+	}
+	return 0;
+fail:
+	{
+		const int saved = errno;
+		close(map->fd);
+		map->fd = -1;
+		errno = saved;
+	}
+	return -1;
+}
+
+int mapClose(struct MappedFile *map) {
+	int retVal = 0;
+	if ( map->data && munmap(map->data, map->length) ) {
+		retVal = -1;
+	}
+	if ( map->fd >= 0 && close(map->fd) ) {
+		retVal = -1;
+	}
+	map->data = NULL;
+	map->fd = -1;
+	return retVal;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <makestuff/common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A whole file mapped into memory.
+//
+struct MappedFile {
+	uint8 *data;
+	size_t length;
+	int fd;
+};
+
+// Map an existing file read-only. Returns zero on success, or -1 with errno set.
+//
+int mapRead(struct MappedFile *map, const char *path);
+
+// Create (or truncate) a file of exactly the given length and map it read-write. Returns zero on
+// success, or -1 with errno set.
+//
+int mapCreate(struct MappedFile *map, const char *path, size_t length);
+
+// Unmap and close the file. Returns zero on success, or -1 with errno set if the file could not
+// be written back.
+//
+int mapClose(struct MappedFile *map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
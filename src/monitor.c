@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <pthread.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libfx2loader.h>
+#include "monitor.h"
+#include "stats.h"
+
+struct FX2CancelToken {
+	pthread_mutex_t lock;
+	bool cancelled;
+};
+
+DLLEXPORT(FX2Status) fx2CancelCreate(struct FX2CancelToken **token, const char **error) {
+	FX2Status retVal = FX2_SUCCESS;
+	struct FX2CancelToken *const newToken =
+		(struct FX2CancelToken *)calloc(1, sizeof(struct FX2CancelToken));
+	CHECK_STATUS(!newToken, FX2_BUF_ERR, cleanup, "fx2CancelCreate(): Unable to allocate token");
+	pthread_mutex_init(&newToken->lock, NULL);
+	*token = newToken;
+cleanup:
+	return retVal;
+}
+
+DLLEXPORT(void) fx2CancelRequest(struct FX2CancelToken *token) {
+	pthread_mutex_lock(&token->lock);
+	token->cancelled = true;
+	pthread_mutex_unlock(&token->lock);
+}
+
+DLLEXPORT(bool) fx2CancelRequested(struct FX2CancelToken *token) {
+	bool cancelled;
+	pthread_mutex_lock(&token->lock);
+	cancelled = token->cancelled;
+	pthread_mutex_unlock(&token->lock);
+	return cancelled;
+}
+
+DLLEXPORT(void) fx2CancelReset(struct FX2CancelToken *token) {
+	pthread_mutex_lock(&token->lock);
+	token->cancelled = false;
+	pthread_mutex_unlock(&token->lock);
+}
+
+DLLEXPORT(void) fx2CancelFree(struct FX2CancelToken *token) {
+	if ( token ) {
+		pthread_mutex_destroy(&token->lock);
+		free(token);
+	}
+}
+
+void monInit(struct Monitor *mon, const struct FX2Monitor *user, struct XferJob *job) {
+	mon->user = user;
+	mon->total = job->remaining;
+	mon->done = 0;
+	mon->last = statsNow();
+	mon->rate = 0.0;
+	if ( user && user->timeout ) {
+		job->timeout = user->timeout;
+	}
+}
+
+bool monCancelled(const struct Monitor *mon) {
+	return mon->user && mon->user->cancel && fx2CancelRequested(mon->user->cancel);
+}
+
+// The throughput is an exponentially-weighted average of the per-chunk rates, so the estimate
+// follows a slow EEPROM or a congested bus within a few chunks without jittering on every one.
+//
+void monUpdate(struct Monitor *mon, uint32 bytesDone) {
+	struct FX2Progress progress;
+	uint64 now, elapsed;
+	double chunkRate;
+	const uint32 chunkBytes = bytesDone - mon->done;
+	mon->done = bytesDone;
+	if ( !mon->user || !mon->user->progress ) {
+		return;
+	}
+	now = statsNow();
+	elapsed = now - mon->last;
+	mon->last = now;
+	chunkRate = elapsed ? (double)chunkBytes * 1e9 / (double)elapsed : 0.0;
+	mon->rate = (mon->rate > 0.0) ? 0.75 * mon->rate + 0.25 * chunkRate : chunkRate;
+	progress.bytesDone = bytesDone;
+	progress.bytesTotal = mon->total;
+	progress.bytesPerSecond = mon->rate;
+	progress.secondsLeft = (mon->rate > 0.0) ? (double)(mon->total - bytesDone) / mon->rate : 0.0;
+	mon->user->progress(&progress, mon->user->context);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <makestuff/common.h>
+#include <makestuff/libfx2loader.h>
+#include "xfer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tracks one job on behalf of a caller's FX2Monitor, which may be NULL.
+//
+struct Monitor {
+	const struct FX2Monitor *user;
+	uint32 total;
+	uint32 done;
+	uint64 last;  // when the previous chunk finished
+	double rate;  // smoothed bytes per second
+};
+
+// Start monitoring the job, applying the caller's timeout to it.
+//
+void monInit(struct Monitor *mon, const struct FX2Monitor *user, struct XferJob *job);
+
+// Returns true if the caller has asked for the job to stop.
+//
+bool monCancelled(const struct Monitor *mon);
+
+// Update the throughput estimate after a chunk brings the job to bytesDone, and report progress.
+//
+void monUpdate(struct Monitor *mon, uint32 bytesDone);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
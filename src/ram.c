@@ -14,78 +14,266 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <makestuff/common.h>
 #include <makestuff/libusbwrap.h>
 #include <makestuff/liberror.h>
 #include <makestuff/libfx2loader.h>
 #include "vendorCommands.h"
+#include "xfer.h"
+#include "transport.h"
+#include "stats.h"
+#include "monitor.h"
+#include "sim.h"
+#include "tune.h"
 
-#define BLOCK_SIZE 4096
+// While waiting for renumeration, the bus is polled at intervals doubling from RENUM_POLL_MIN to
+// RENUM_POLL_MAX milliseconds: quick enough to add little latency, and far shorter than the
+// 100ms a hub spends debouncing a connection, so a disconnect cannot slip between two polls. A
+// device with the same VID:PID as the old firmware is given RENUM_DROP_TIME to drop off the bus
+// before it is assumed not to be renumerating at all.
+//
+#define RENUM_POLL_MIN 2
+#define RENUM_POLL_MAX 16
+#define RENUM_DROP_TIME 500
 
-// Write the supplied reader buffer to RAM, using the supplied VID/PID.
+// Write the FX2 CPUCS register: 0x01 holds the 8051 in reset, 0x00 brings it out of reset.
 //
-DLLEXPORT(FX2Status) fx2WriteRAM(
-	struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes, const char **error)
+static USBStatus writeCPUCS(
+	struct USBDevice *device, uint8 value, uint32 timeout, const char **error)
 {
-	FX2Status retVal = FX2_SUCCESS;
-	uint16 address = 0x0000;
-	uint8 byte = 0x01;
-	USBStatus uStatus = usbControlWrite(
+	return devControlWrite(
 		device,
 		CMD_READ_WRITE_RAM, // bRequest: RAM access
 		0xE600,             // wValue: address to write (FX2 CPUCS)
 		0x0000,             // wIndex: unused
-		&byte,              // data = 0x01: hold 8051 in reset
+		&value,             // data: the new CPUCS value
 		1,                  // wLength: just one byte
-		5000,               // timeout
+		timeout,            // timeout
 		error
 	);
-	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteRAM(): Failed to put the CPU in reset");
-	while ( numBytes > BLOCK_SIZE ) {
-		uStatus = usbControlWrite(
-			device,
-			CMD_READ_WRITE_RAM, // bRequest: RAM access
-			address,            // wValue: RAM address to write
-			0x0000,             // wIndex: unused
-			bufPtr,             // data to be written
-			BLOCK_SIZE,         // wLength: BLOCK_SIZE block
-			5000,               // timeout
-			error
-		);
-		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteRAM(): Failed to write block of bytes");
-		numBytes -= BLOCK_SIZE;
-		bufPtr += BLOCK_SIZE;
-		address = (uint16)(address + BLOCK_SIZE);
+}
+
+// Write one contiguous region of RAM, in chunks.
+//
+static USBStatus writeRegion(
+	struct USBDevice *device, uint32 address, const uint8 *bufPtr, uint32 numBytes,
+	const char **error)
+{
+	USBStatus uStatus;
+	struct XferJob job;
+	xferInitWrite(&job, CMD_READ_WRITE_RAM, address, bufPtr, numBytes);
+	do {
+		uStatus = xferNext(device, &job, error);
+	} while ( uStatus == USB_SUCCESS && !xferFinished(&job) );
+	return uStatus;
+}
+
+// Write the supplied reader buffer to RAM, using the supplied VID/PID.
+//
+DLLEXPORT(FX2Status) fx2WriteRAM(
+	struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes, const char **error)
+{
+	return fx2WriteRAMEx(device, bufPtr, numBytes, NULL, NULL, error);
+}
+
+// Write just the defined parts of the image to RAM, merging runs separated by short gaps.
+//
+DLLEXPORT(FX2Status) fx2WriteRAMMasked(
+	struct USBDevice *device, const uint8 *bufPtr, const uint8 *maskPtr, uint32 numBytes,
+	const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	USBStatus uStatus;
+	uint32 offset = 0, length;
+	statsBegin(device, FX2_STATS_WRITE_RAM);
+	uStatus = writeCPUCS(device, 0x01, XFER_TIMEOUT, error);
+	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteRAMMasked(): Failed to put the CPU in reset");
+	while ( xferNextMaskRun(maskPtr, numBytes, XFER_MERGE_GAP, &offset, &length) ) {
+		uStatus = writeRegion(device, offset, bufPtr + offset, length, error);
+		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteRAMMasked(): Failed to write block of bytes");
+		offset += length;
 	}
 
-	// Write final chunk of data
-	uStatus = usbControlWrite(
-		device,
-		CMD_READ_WRITE_RAM, // bRequest: RAM access
-		address,            // wValue: RAM address to write
-		0x0000,             // wIndex: unused
-		bufPtr,             // data to be written
-		(uint16)numBytes,   // wLength: remaining bytes
-		5000,               // timeout
-		error
-	);
-	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteRAM(): Failed to write final block");
+	// As in fx2WriteRAMEx(), the result of releasing the CPU cannot be trusted
+	(void)writeCPUCS(device, 0x00, XFER_TIMEOUT, NULL);
+cleanup:
+	statsEnd(device, retVal);
+	return retVal;
+}
+
+static int compareSegments(const void *x, const void *y) {
+	const uint32 a = ((const struct FX2Segment *)x)->address;
+	const uint32 b = ((const struct FX2Segment *)y)->address;
+	return (a > b) - (a < b);
+}
+
+// Sort the segments and check them before touching the device. Each run of several segments is
+// assembled in a staging buffer; a segment on its own is uploaded straight from the caller.
+//
+DLLEXPORT(FX2Status) fx2WriteRAMSegments(
+	struct USBDevice *device, const struct FX2Segment *segments, uint32 numSegments,
+	const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	USBStatus uStatus;
+	struct FX2Segment *sorted = NULL;
+	uint8 *staging = NULL;
+	struct XferRun run;
+	uint32 i, next = 0, end = 0;
+	statsBegin(device, FX2_STATS_WRITE_RAM);
+	if ( numSegments ) {
+		sorted = (struct FX2Segment *)malloc(numSegments * sizeof(struct FX2Segment));
+		CHECK_STATUS(!sorted, FX2_BUF_ERR, cleanup, "fx2WriteRAMSegments(): Unable to allocate segment list");
+		memcpy(sorted, segments, numSegments * sizeof(struct FX2Segment));
+		qsort(sorted, numSegments, sizeof(struct FX2Segment), compareSegments);
+	}
+	for ( i = 0; i < numSegments; i++ ) {
+		if ( !sorted[i].length ) {
+			continue;
+		}
+		if (
+			sorted[i].address < end || sorted[i].address > 0x10000 ||
+			sorted[i].length > 0x10000 - sorted[i].address )
+		{
+			errRender(
+				error,
+				"fx2WriteRAMSegments(): The segment at 0x%04X overlaps another or extends beyond 64KiB",
+				sorted[i].address);
+			FAIL_RET(FX2_BUF_ERR, cleanup);
+		}
+		end = sorted[i].address + sorted[i].length;
+	}
+	uStatus = writeCPUCS(device, 0x01, XFER_TIMEOUT, error);
+	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteRAMSegments(): Failed to put the CPU in reset");
+	while ( xferNextSegmentRun(sorted, numSegments, XFER_MERGE_GAP, &next, &run) ) {
+		const uint8 *bufPtr = sorted[run.first].data;
+		if ( run.count > 1 ) {
+			if ( !staging ) {
+				staging = (uint8 *)malloc(0x10000);
+				CHECK_STATUS(!staging, FX2_BUF_ERR, cleanup, "fx2WriteRAMSegments(): Unable to allocate staging buffer");
+			}
+			memset(staging, 0x00, run.length);
+			for ( i = run.first; i < run.first + run.count; i++ ) {
+				memcpy(staging + sorted[i].address - run.address, sorted[i].data, sorted[i].length);
+			}
+			bufPtr = staging;
+		}
+		uStatus = writeRegion(device, run.address, bufPtr, run.length, error);
+		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteRAMSegments(): Failed to write block of bytes");
+	}
+
+	// As in fx2WriteRAMEx(), the result of releasing the CPU cannot be trusted
+	(void)writeCPUCS(device, 0x00, XFER_TIMEOUT, NULL);
+cleanup:
+	free(staging);
+	free(sorted);
+	statsEnd(device, retVal);
+	return retVal;
+}
+
+// As above, checking for cancellation before each chunk and reporting progress after it.
+//
+DLLEXPORT(FX2Status) fx2WriteRAMEx(
+	struct USBDevice *device, const uint8 *bufPtr, uint32 numBytes,
+	const struct FX2Monitor *monitor, uint32 *bytesDone, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	struct XferJob job;
+	struct Monitor mon;
+	USBStatus uStatus;
+	uint32 timeout;
+	statsBegin(device, FX2_STATS_WRITE_RAM);
+	xferInitWrite(&job, CMD_READ_WRITE_RAM, 0x0000, bufPtr, numBytes);
+	monInit(&mon, monitor, &job);
+	timeout = job.timeout ? job.timeout : XFER_TIMEOUT;
+	uStatus = writeCPUCS(device, 0x01, timeout, error);
+	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteRAMEx(): Failed to put the CPU in reset");
+
+	// Write the data in chunks
+	do {
+		if ( monCancelled(&mon) ) {
+			errRender(
+				error, "fx2WriteRAMEx(): Cancelled after %u of %u bytes; the CPU is still in reset",
+				numBytes - job.remaining, numBytes);
+			FAIL_RET(FX2_CANCELLED, cleanup);
+		}
+		uStatus = xferNext(device, &job, error);
+		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2WriteRAMEx(): Failed to write block of bytes");
+		monUpdate(&mon, numBytes - job.remaining);
+	} while ( !xferFinished(&job) );
 
 	// There's an unavoidable race condition here: this command brings the FX2 out of reset, which
 	// causes it to drop off the bus for renumeration. It may drop off before or after the host
 	// gets its acknowledgement, so we cannot trust the return code. We have no choice but to
 	// assume it worked.
-	byte = 0x00;
-	uStatus = usbControlWrite(
-		device,
-		CMD_READ_WRITE_RAM, // bRequest: RAM access
-		0xE600,             // wValue: address to write (FX2 CPUCS)
-		0x0000,             // wIndex: unused
-		&byte,              // data = 0x00: bring 8051 out of reset
-		1,                  // wLength: just one byte
-		5000,               // timeout
-		NULL
-	);
+	(void)writeCPUCS(device, 0x00, timeout, NULL);
+cleanup:
+	if ( bytesDone ) {
+		*bytesDone = numBytes - job.remaining;
+	}
+	statsEnd(device, retVal);
+	return retVal;
+}
+
+static uint32 msSince(uint64 start) {
+	return (uint32)((statsNow() - start) / 1000000);
+}
+
+// Close the old handle, wait for the old firmware to leave the bus (if it shares the new one's
+// VID:PID), then wait for the new firmware to appear and keep trying to open it until it can be
+// opened or the time runs out. Boards are told apart by vp alone, so this is only reliable when
+// nothing else attached matches it. A simulated device renumerates instantly, its renumeration time
+// having already been charged to its clock.
+//
+DLLEXPORT(FX2Status) fx2AwaitRenumeration(
+	struct USBDevice **device, const char *vp, uint32 timeout, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	USBStatus uStatus;
+	struct USBDevice *const oldDevice = *device;
+	struct USBDevice *newDevice = NULL;
+	const uint64 start = statsNow();
+	uint32 poll = RENUM_POLL_MIN;
+	bool isAvailable;
+	if ( oldDevice && simLookup(oldDevice) ) {
+		return FX2_SUCCESS;
+	}
+	usbCloseDevice(oldDevice, 0);
+	*device = NULL;
+	uStatus = usbIsDeviceAvailable(vp, &isAvailable, error);
+	CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2AwaitRenumeration()");
+	while ( isAvailable && msSince(start) < RENUM_DROP_TIME && msSince(start) < timeout ) {
+		usleep(RENUM_POLL_MIN * 1000);
+		uStatus = usbIsDeviceAvailable(vp, &isAvailable, error);
+		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2AwaitRenumeration()");
+	}
+	for ( ;; ) {
+		const bool expired = msSince(start) >= timeout;
+		uStatus = usbIsDeviceAvailable(vp, &isAvailable, error);
+		CHECK_STATUS(uStatus, FX2_USB_ERR, cleanup, "fx2AwaitRenumeration()");
+		if ( isAvailable ) {
+			// The device may be visible a little before it can be opened (e.g while udev sets its
+			// permissions), so only the last attempt's error counts
+			uStatus = usbOpenDevice(vp, 1, 0, 0, &newDevice, expired ? error : NULL);
+			if ( uStatus == USB_SUCCESS ) {
+				break;
+			}
+			CHECK_STATUS(expired, FX2_USB_ERR, cleanup, "fx2AwaitRenumeration()");
+		} else if ( expired ) {
+			errRender(error, "fx2AwaitRenumeration(): %s did not appear within %ums", vp, timeout);
+			FAIL_RET(FX2_USB_ERR, cleanup);
+		}
+		usleep(poll * 1000);
+		if ( poll < RENUM_POLL_MAX ) {
+			poll *= 2;
+		}
+	}
+	*device = newDevice;
 cleanup:
+	statsMove(oldDevice, newDevice);
+	tuneMove(oldDevice, newDevice);
 	return retVal;
 }
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include "scan.h"
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define SCAN_SSE2
+#endif
+
+#ifdef _MSC_VER
+	#include <intrin.h>
+	static __inline uint32 firstSet(uint32 x) {
+		unsigned long i;
+		_BitScanForward(&i, x);
+		return (uint32)i;
+	}
+#else
+	#define firstSet(x) ((uint32)__builtin_ctz(x))
+#endif
+
+// Scalar helpers, used for the tails and when there is no SIMD.
+//
+#define ONES  ((size_t)-1 / 0xFF)
+#define HIGHS (ONES * 0x80)
+
+static inline size_t loadWord(const uint8 *p) {
+	size_t w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+size_t scanFindZero(const uint8 *p, size_t from, size_t end) {
+	size_t i = from;
+#if defined(__AVX2__)
+	const __m256i zero = _mm256_setzero_si256();
+	while ( i + 32 <= end ) {
+		const uint32 bits = (uint32)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), zero));
+		if ( bits ) {
+			return i + firstSet(bits);
+		}
+		i += 32;
+	}
+#elif defined(SCAN_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	while ( i + 16 <= end ) {
+		const uint32 bits = (uint32)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), zero));
+		if ( bits ) {
+			return i + firstSet(bits);
+		}
+		i += 16;
+	}
+#endif
+	// A word has a zero byte iff (w - 0x0101...) & ~w & 0x8080... is nonzero
+	while ( i + sizeof(size_t) <= end ) {
+		const size_t w = loadWord(p + i);
+		if ( (w - ONES) & ~w & HIGHS ) {
+			break;
+		}
+		i += sizeof(size_t);
+	}
+	while ( i < end && p[i] ) {
+		i++;
+	}
+	return i;
+}
+
+size_t scanFindNonZero(const uint8 *p, size_t from, size_t end) {
+	size_t i = from;
+#if defined(__AVX2__)
+	const __m256i zero = _mm256_setzero_si256();
+	while ( i + 32 <= end ) {
+		const uint32 bits = ~(uint32)_mm256_movemask_epi8(
+			_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), zero));
+		if ( bits ) {
+			return i + firstSet(bits);
+		}
+		i += 32;
+	}
+#elif defined(SCAN_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	while ( i + 16 <= end ) {
+		const uint32 bits = 0xFFFF ^ (uint32)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), zero));
+		if ( bits ) {
+			return i + firstSet(bits);
+		}
+		i += 16;
+	}
+#endif
+	while ( i + sizeof(size_t) <= end && !loadWord(p + i) ) {
+		i += sizeof(size_t);
+	}
+	while ( i < end && !p[i] ) {
+		i++;
+	}
+	return i;
+}
+
+void scanMaskedCopy(uint8 *dst, const uint8 *src, const uint8 *mask, size_t n) {
+	size_t i = 0;
+#if defined(__AVX2__)
+	const __m256i zero = _mm256_setzero_si256();
+	while ( i + 32 <= n ) {
+		const __m256i holes = _mm256_cmpeq_epi8(
+			_mm256_loadu_si256((const __m256i *)(mask + i)), zero);
+		_mm256_storeu_si256(
+			(__m256i *)(dst + i),
+			_mm256_andnot_si256(holes, _mm256_loadu_si256((const __m256i *)(src + i))));
+		i += 32;
+	}
+#elif defined(SCAN_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	while ( i + 16 <= n ) {
+		const __m128i holes = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(mask + i)), zero);
+		_mm_storeu_si128(
+			(__m128i *)(dst + i),
+			_mm_andnot_si128(holes, _mm_loadu_si128((const __m128i *)(src + i))));
+		i += 16;
+	}
+#endif
+	while ( i < n ) {
+		dst[i] = mask[i] ? src[i] : 0x00;
+		i++;
+	}
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <makestuff/common.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Mask-scanning kernels used by the I2C encoder. They use AVX2 or SSE2 when the compiler targets
+// them, and a word-at-a-time scalar loop otherwise.
+
+// Return the index of the first zero byte in p[from..end), or end if there is none.
+//
+size_t scanFindZero(const uint8 *p, size_t from, size_t end);
+
+// Return the index of the first nonzero byte in p[from..end), or end if there is none.
+//
+size_t scanFindNonZero(const uint8 *p, size_t from, size_t end);
+
+// Set dst[i] = mask[i] ? src[i] : 0x00 for i in [0, n). The dst and src may be the same.
+//
+void scanMaskedCopy(uint8 *dst, const uint8 *src, const uint8 *mask, size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <makestuff/liberror.h>
+#include "seg.h"
+#include "scan.h"
+
+// The nonzero mask bytes are numbered 0..m-1, at positions pos[]. Let best[k] be the cheapest way
+// to cover the first k of them, with the last record ending on pos[k-1]. That record starts on
+// some pos[i] no more than 1022 bytes earlier, so:
+//
+//   best[k] = min{ best[i] - byteCost*pos[i] } + recordCost + byteCost*(pos[k-1] + 1)
+//
+// The set of admissible i is a window sliding forward with k, so the minimum is kept in a
+// monotone deque, giving O(m) overall.
+//
+I2CStatus segOptimal(
+	const uint8 *mask, size_t length, uint32 recordCost, uint32 byteCost,
+	struct SegRecord **records, size_t *numRecords, const char **error)
+{
+	I2CStatus retVal = I2C_SUCCESS;
+	uint32 *pos = NULL, *from = NULL, *deque = NULL;
+	uint64 *best = NULL;
+	struct SegRecord *result = NULL;
+	size_t m = 0, i, k, head = 0, tail = 0, count;
+	*records = NULL;
+	*numRecords = 0;
+
+	// Find the positions of all the nonzero mask bytes
+	//
+	pos = (uint32 *)malloc((length ? length : 1) * sizeof(uint32));
+	CHECK_STATUS(!pos, I2C_BUFFER_ERROR, cleanup, "segOptimal(): Out of memory");
+	i = scanFindNonZero(mask, 0, length);
+	while ( i < length ) {
+		const size_t runEnd = scanFindZero(mask, i, length);
+		while ( i < runEnd ) {
+			pos[m++] = (uint32)i++;
+		}
+		i = scanFindNonZero(mask, runEnd, length);
+	}
+	if ( m == 0 ) {
+		goto cleanup;
+	}
+	best = (uint64 *)malloc((m + 1) * sizeof(uint64));
+	from = (uint32 *)malloc((m + 1) * sizeof(uint32));
+	deque = (uint32 *)malloc(m * sizeof(uint32));
+	CHECK_STATUS(!best || !from || !deque, I2C_BUFFER_ERROR, cleanup, "segOptimal(): Out of memory");
+
+	// Run the recurrence. The deque holds candidate start indices i with strictly increasing
+	// best[i] - byteCost*pos[i]; adding byteCost*pos[i] keeps the keys unsigned.
+	//
+	#define KEY(i) (best[i] + (uint64)byteCost*(pos[m-1] - pos[i]))
+	best[0] = 0;
+	for ( k = 1; k <= m; k++ ) {
+		const uint32 end = pos[k-1];
+		while ( tail > head && KEY(deque[tail-1]) >= KEY(k-1) ) {
+			tail--;
+		}
+		deque[tail++] = (uint32)(k-1);
+		while ( end - pos[deque[head]] >= SEG_MAX_RECORD ) {
+			head++;
+		}
+		i = deque[head];
+		from[k] = (uint32)i;
+		best[k] = best[i] + recordCost + (uint64)byteCost*(end - pos[i] + 1);
+	}
+	#undef KEY
+
+	// Walk back through the choices to recover the records
+	//
+	count = 0;
+	for ( k = m; k > 0; k = from[k] ) {
+		count++;
+	}
+	result = (struct SegRecord *)malloc(count * sizeof(struct SegRecord));
+	CHECK_STATUS(!result, I2C_BUFFER_ERROR, cleanup, "segOptimal(): Out of memory");
+	*numRecords = count;
+	for ( k = m; k > 0; k = from[k] ) {
+		count--;
+		result[count].address = (uint16)pos[from[k]];
+		result[count].length = (uint16)(pos[k-1] - pos[from[k]] + 1);
+	}
+	*records = result;
+cleanup:
+	free(deque);
+	free(from);
+	free(best);
+	free(pos);
+	return retVal;
+}
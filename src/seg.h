@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SEG_H
+#define SEG_H
+
+#include <makestuff/common.h>
+#include <makestuff/libfx2loader.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The longest C2 record payload: lengths are ten bits wide (TRM 3.4.3).
+//
+#define SEG_MAX_RECORD 1023
+
+// One record chosen by segOptimal().
+//
+struct SegRecord {
+	uint16 address;
+	uint16 length;
+};
+
+// Choose the C2 records covering every nonzero byte of mask[0..length) which minimise
+// recordCost*numRecords + byteCost*payloadBytes, subject to the 1023-byte record limit. The result
+// is exact. On success *records is a malloc()'d array which the caller must free().
+//
+I2CStatus segOptimal(
+	const uint8 *mask, size_t length, uint32 recordCost, uint32 byteCost,
+	struct SegRecord **records, size_t *numRecords, const char **error
+);
+
+// Append the records chosen by segOptimal() for these weights to an initialised I2C buffer.
+// Defined in i2c.c, alongside the other record writers.
+//
+I2CStatus i2cWriteOptimal(
+	struct Buffer *destination, const struct Buffer *sourceData, const struct Buffer *sourceMask,
+	uint32 recordCost, uint32 byteCost, const char **error
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <makestuff/common.h>
+#include <makestuff/libusbwrap.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libfx2loader.h>
+#include "vendorCommands.h"
+#include "sim.h"
+
+#define CPUCS 0xE600
+#define EP0BUF_SIZE 64
+
+struct FX2Sim {
+	struct FX2Sim *next;  // in the registry of live simulations
+	struct FX2SimConfig config;
+	pthread_mutex_t lock;
+	uint8 ram[0x10000];
+	uint8 *eeprom;
+	bool inReset;
+	bool ramLoaded;        // RAM has been written since the 8051 was last put in reset
+	bool firmwareRunning;
+	uint16 pageSize;       // the firmware's idea of the page size, from CMD_EEPROM_CONFIG
+	uint8 pageBuf[MAX_PAGE_SIZE];
+	struct FX2SimStats stats;
+};
+
+// Every live simulation, so a device handle can be recognised as one of ours. There are rarely
+// more than a handful, so a list is plenty.
+//
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+static struct FX2Sim *registry = NULL;
+
+DLLEXPORT(void) fx2SimDefaultConfig(struct FX2SimConfig *config) {
+	config->eepromSize = 16384;                    // 24LC128
+	config->eepromPageSize = FX2_DEFAULT_PAGE_SIZE;
+	config->firmwareRunning = true;
+	config->timing.transferNs = 125000;            // one high-speed microframe each way
+	config->timing.byteNs = 17;                    // 480Mb/s, less protocol overhead
+	config->timing.i2cClockHz = 400000;
+	config->timing.pageWriteNs = 5000000;          // 24LCxx tWC
+	config->timing.renumerateNs = 1000000000;
+	config->timing.realTime = false;
+}
+
+DLLEXPORT(FX2Status) fx2SimCreate(
+	const struct FX2SimConfig *config, struct FX2Sim **simPtr, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	struct FX2Sim *sim = (struct FX2Sim *)calloc(1, sizeof(struct FX2Sim));
+	CHECK_STATUS(!sim, FX2_BUF_ERR, cleanup, "fx2SimCreate(): Unable to allocate simulation");
+	if ( config ) {
+		sim->config = *config;
+	} else {
+		fx2SimDefaultConfig(&sim->config);
+	}
+	CHECK_STATUS(
+		!sim->config.eepromSize || !sim->config.eepromPageSize ||
+		(sim->config.eepromPageSize & (sim->config.eepromPageSize - 1)) ||
+		!sim->config.timing.i2cClockHz,
+		FX2_BUF_ERR, cleanup,
+		"fx2SimCreate(): The EEPROM size and page size must be nonzero (the page size a power of "
+		"two), and so must the I2C clock");
+	sim->eeprom = (uint8 *)malloc(sim->config.eepromSize);
+	CHECK_STATUS(!sim->eeprom, FX2_BUF_ERR, cleanup, "fx2SimCreate(): Unable to allocate EEPROM");
+	memset(sim->eeprom, 0xFF, sim->config.eepromSize);
+	sim->firmwareRunning = sim->config.firmwareRunning;
+	sim->pageSize = FX2_DEFAULT_PAGE_SIZE;
+	pthread_mutex_init(&sim->lock, NULL);
+	pthread_mutex_lock(&registryLock);
+	sim->next = registry;
+	registry = sim;
+	pthread_mutex_unlock(&registryLock);
+	*simPtr = sim;
+	sim = NULL;
+cleanup:
+	if ( sim ) {
+		free(sim->eeprom);
+		free(sim);
+	}
+	return retVal;
+}
+
+DLLEXPORT(void) fx2SimDestroy(struct FX2Sim *sim) {
+	struct FX2Sim **link;
+	if ( !sim ) {
+		return;
+	}
+	pthread_mutex_lock(&registryLock);
+	for ( link = &registry; *link; link = &(*link)->next ) {
+		if ( *link == sim ) {
+			*link = sim->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&registryLock);
+	pthread_mutex_destroy(&sim->lock);
+	free(sim->eeprom);
+	free(sim);
+}
+
+// The handle is just the simulation's address; it is never dereferenced as a USBDevice.
+//
+DLLEXPORT(struct USBDevice *) fx2SimDevice(struct FX2Sim *sim) {
+	return (struct USBDevice *)sim;
+}
+
+DLLEXPORT(uint8 *) fx2SimEEPROM(struct FX2Sim *sim, uint32 *size) {
+	if ( size ) {
+		*size = sim->config.eepromSize;
+	}
+	return sim->eeprom;
+}
+
+DLLEXPORT(uint8 *) fx2SimRAM(struct FX2Sim *sim) {
+	return sim->ram;
+}
+
+DLLEXPORT(void) fx2SimGetStats(struct FX2Sim *sim, struct FX2SimStats *stats) {
+	pthread_mutex_lock(&sim->lock);
+	*stats = sim->stats;
+	pthread_mutex_unlock(&sim->lock);
+}
+
+DLLEXPORT(void) fx2SimResetStats(struct FX2Sim *sim) {
+	pthread_mutex_lock(&sim->lock);
+	memset(&sim->stats, 0, sizeof(sim->stats));
+	pthread_mutex_unlock(&sim->lock);
+}
+
+struct FX2Sim *simLookup(struct USBDevice *device) {
+	struct FX2Sim *sim;
+	pthread_mutex_lock(&registryLock);
+	for ( sim = registry; sim && (struct USBDevice *)sim != device; sim = sim->next );
+	pthread_mutex_unlock(&registryLock);
+	return sim;
+}
+
+// The time to clock numBytes over the I2C bus: eight data bits and an acknowledge each.
+//
+static uint64 i2cTime(const struct FX2Sim *sim, uint32 numBytes) {
+	return (uint64)numBytes * 9U * 1000000000U / sim->config.timing.i2cClockHz;
+}
+
+// Account for one USB transfer, returning the time it took so the caller can sleep for it after
+// releasing the lock.
+//
+static uint64 transferTime(struct FX2Sim *sim, uint32 numBytes, uint64 extraNs) {
+	const uint64 ns =
+		sim->config.timing.transferNs + (uint64)numBytes * sim->config.timing.byteNs + extraNs;
+	sim->stats.elapsedNs += ns;
+	sim->stats.numTransfers++;
+	sim->stats.numBytes += numBytes;
+	return ns;
+}
+
+static void realTimeWait(const struct FX2Sim *sim, uint64 ns) {
+	if ( sim->config.timing.realTime ) {
+		struct timespec delay;
+		delay.tv_sec = (time_t)(ns / 1000000000U);
+		delay.tv_nsec = (long)(ns % 1000000000U);
+		while ( nanosleep(&delay, &delay) );
+	}
+}
+
+// A sequential read from the EEPROM: a random-read header (start, device address, two address
+// bytes, repeated start, device address), then the data. Addresses wrap at the end of the EEPROM.
+//
+static uint64 promRead(struct FX2Sim *sim, uint32 address, uint8 *data, uint32 numBytes) {
+	const uint32 size = sim->config.eepromSize;
+	uint32 i;
+	for ( i = 0; i < numBytes; i++ ) {
+		data[i] = sim->eeprom[(address + i) % size];
+	}
+	return i2cTime(sim, 4 + numBytes);
+}
+
+// A page write: like a real 24LCxx, bytes beyond the end of the physical page wrap around to its
+// start, so a misconfigured page size corrupts the EEPROM just as it would on a board.
+//
+static uint64 promWrite(struct FX2Sim *sim, uint32 address, const uint8 *data, uint32 numBytes) {
+	const uint32 pageMask = sim->config.eepromPageSize - 1U;
+	const uint32 pageBase = (address % sim->config.eepromSize) & ~pageMask;
+	uint32 i;
+	for ( i = 0; i < numBytes; i++ ) {
+		sim->eeprom[pageBase + ((address + i) & pageMask)] = data[i];
+	}
+	sim->stats.numPageWrites++;
+	return i2cTime(sim, 3 + numBytes) + sim->config.timing.pageWriteNs;
+}
+
+// The FX2LP core handles 0xA0 itself, whatever the 8051 is doing. Writing CPUCS holds or releases
+// the 8051; releasing it after a RAM load starts the new firmware, which renumerates.
+//
+static uint64 ramWrite(struct FX2Sim *sim, uint16 address, const uint8 *data, uint16 numBytes) {
+	uint64 ns = 0;
+	uint16 i;
+	for ( i = 0; i < numBytes; i++, address++ ) {
+		sim->ram[address] = data[i];
+		if ( address != CPUCS ) {
+			sim->ramLoaded = true;
+		} else if ( data[i] & 0x01 ) {
+			sim->inReset = true;
+			sim->ramLoaded = false;
+			sim->firmwareRunning = false;
+		} else if ( sim->inReset ) {
+			sim->inReset = false;
+			if ( sim->ramLoaded ) {
+				sim->firmwareRunning = true;
+				sim->pageSize = FX2_DEFAULT_PAGE_SIZE;
+				sim->stats.numRenumerations++;
+				ns += sim->config.timing.renumerateNs;
+			}
+		}
+	}
+	return ns;
+}
+
+USBStatus simControlRead(
+	struct FX2Sim *sim, uint8 bRequest, uint16 wValue, uint16 wIndex, uint8 *data,
+	uint16 wLength, const char **error)
+{
+	uint64 ns = 0;
+	pthread_mutex_lock(&sim->lock);
+	if ( bRequest == CMD_READ_WRITE_RAM ) {
+		uint16 i;
+		for ( i = 0; i < wLength; i++ ) {
+			data[i] = sim->ram[(uint16)(wValue + i)];
+		}
+	} else if ( !sim->firmwareRunning ) {
+		goto stall;
+	} else if ( bRequest == CMD_CALCULATOR ) {
+		const uint16 response[] = {
+			(uint16)(wValue + wIndex), (uint16)(wValue - wIndex), (uint16)(wValue * wIndex),
+			(uint16)(wIndex ? wValue / wIndex : 0xFFFF)
+		};
+		uint16 i;
+		for ( i = 0; i < wLength && i < 8; i++ ) {
+			data[i] = (uint8)(response[i/2] >> (8 * (i & 1)));
+		}
+	} else if ( bRequest == CMD_READ_WRITE_EEPROM ) {
+		// The firmware reads the EEPROM one EP0 packet at a time
+		uint32 address = ((uint32)wIndex << 16) | wValue;
+		uint16 done, chunkSize;
+		for ( done = 0; done < wLength; done += chunkSize ) {
+			chunkSize = (wLength - done < EP0BUF_SIZE) ? wLength - done : EP0BUF_SIZE;
+			ns += promRead(sim, address + done, data + done, chunkSize);
+		}
+	} else if ( bRequest == CMD_EEPROM_CONFIG && wLength >= 4 ) {
+		const uint16 features = FEATURE_PAGE_WRITE | FEATURE_BANKS;
+		data[0] = (uint8)sim->pageSize;
+		data[1] = 0x00;
+		data[2] = (uint8)features;
+		data[3] = (uint8)(features >> 8);
+	} else {
+		goto stall;
+	}
+	ns = transferTime(sim, wLength, ns);
+	pthread_mutex_unlock(&sim->lock);
+	realTimeWait(sim, ns);
+	return USB_SUCCESS;
+stall:
+	transferTime(sim, 0, 0);
+	pthread_mutex_unlock(&sim->lock);
+	errRender(error, "simControlRead(): Request 0x%02X stalled", bRequest);
+	return USB_CONTROL;
+}
+
+USBStatus simControlWrite(
+	struct FX2Sim *sim, uint8 bRequest, uint16 wValue, uint16 wIndex, const uint8 *data,
+	uint16 wLength, const char **error)
+{
+	uint64 ns = 0;
+	pthread_mutex_lock(&sim->lock);
+	if ( bRequest == CMD_READ_WRITE_RAM ) {
+		ns += ramWrite(sim, wValue, data, wLength);
+	} else if ( !sim->firmwareRunning ) {
+		goto stall;
+	} else if ( bRequest == CMD_READ_WRITE_EEPROM ) {
+		// Gather the data into whole pages, as the firmware does, so each page is programmed with
+		// one write cycle
+		const uint32 pageMask = sim->pageSize - 1U;
+		uint32 address = ((uint32)wIndex << 16) | wValue;
+		uint32 pageStart = address;
+		uint32 fill = 0;
+		uint16 i;
+		for ( i = 0; i < wLength; i++ ) {
+			sim->pageBuf[fill++] = data[i];
+			address++;
+			if ( !(address & pageMask) ) {
+				ns += promWrite(sim, pageStart, sim->pageBuf, fill);
+				pageStart = address;
+				fill = 0;
+			}
+		}
+		if ( fill ) {
+			ns += promWrite(sim, pageStart, sim->pageBuf, fill);
+		}
+	} else if ( bRequest == CMD_EEPROM_CONFIG ) {
+		if ( wValue == 0 || wValue > MAX_PAGE_SIZE || (wValue & (wValue - 1)) ) {
+			goto stall;  // not a power of two the firmware can buffer
+		}
+		sim->pageSize = wValue;
+	} else {
+		goto stall;
+	}
+	ns = transferTime(sim, wLength, ns);
+	pthread_mutex_unlock(&sim->lock);
+	realTimeWait(sim, ns);
+	return USB_SUCCESS;
+stall:
+	transferTime(sim, 0, 0);
+	pthread_mutex_unlock(&sim->lock);
+	errRender(error, "simControlWrite(): Request 0x%02X stalled", bRequest);
+	return USB_CONTROL;
+}
+
+USBStatus simBulk(struct FX2Sim *sim, uint8 endpoint, uint32 count, const char **error) {
+	pthread_mutex_lock(&sim->lock);
+	transferTime(sim, 0, 0);
+	pthread_mutex_unlock(&sim->lock);
+	(void)count;
+	errRender(error, "simBulk(): The simulated firmware has no EP%u", endpoint & 0x0F);
+	return USB_BULK;
+}
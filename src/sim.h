@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SIM_H
+#define SIM_H
+
+#include <makestuff/common.h>
+#include <makestuff/libusbwrap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct FX2Sim;
+
+// Returns the simulation whose fx2SimDevice() handle this is, or NULL for a real device.
+//
+struct FX2Sim *simLookup(struct USBDevice *device);
+
+// Handle a vendor request on the simulated control endpoint. Requests the simulation does not
+// support (or which the firmware would refuse) stall, returning USB_CONTROL.
+//
+USBStatus simControlRead(
+	struct FX2Sim *sim, uint8 bRequest, uint16 wValue, uint16 wIndex, uint8 *data,
+	uint16 wLength, const char **error);
+
+USBStatus simControlWrite(
+	struct FX2Sim *sim, uint8 bRequest, uint16 wValue, uint16 wIndex, const uint8 *data,
+	uint16 wLength, const char **error);
+
+// The simulated firmware has no bulk endpoints, so every bulk transfer fails with USB_BULK.
+//
+USBStatus simBulk(struct FX2Sim *sim, uint8 endpoint, uint32 count, const char **error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libfx2loader.h>
+#include "stats.h"
+
+struct DevStats {
+	struct DevStats *next;
+	struct USBDevice *device;
+	uint32 depth;   // of nested statsBegin() calls
+	FX2StatsOp op;  // the outermost operation in progress
+	uint64 opStart;
+	struct FX2Stats stats;
+};
+
+// Every device with statistics enabled. The lock also guards the statistics themselves; it is
+// only ever held for a few instructions, which is nothing next to a USB round trip.
+//
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+static struct DevStats *registry = NULL;
+
+// Call with the lock held.
+//
+static struct DevStats *find(struct USBDevice *device) {
+	struct DevStats *entry;
+	for ( entry = registry; entry && entry->device != device; entry = entry->next );
+	return entry;
+}
+
+uint64 statsNow(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec * 1000000000U + (uint64)ts.tv_nsec;
+}
+
+// Bucket zero is under 1us; bucket i is [2^(i-1), 2^i)us; the last bucket takes everything longer.
+//
+static uint32 bucket(uint64 ns) {
+	uint64 us = ns / 1000;
+	uint32 i = 0;
+	while ( us && i < FX2_STATS_BUCKETS - 1 ) {
+		us >>= 1;
+		i++;
+	}
+	return i;
+}
+
+DLLEXPORT(FX2Status) fx2StatsEnable(struct USBDevice *device, const char **error) {
+	FX2Status retVal = FX2_SUCCESS;
+	struct DevStats *entry;
+	pthread_mutex_lock(&registryLock);
+	if ( !find(device) ) {
+		entry = (struct DevStats *)calloc(1, sizeof(struct DevStats));
+		CHECK_STATUS(!entry, FX2_BUF_ERR, cleanup, "fx2StatsEnable(): Unable to allocate statistics");
+		entry->device = device;
+		entry->op = FX2_STATS_OTHER;
+		entry->next = registry;
+		registry = entry;
+	}
+cleanup:
+	pthread_mutex_unlock(&registryLock);
+	return retVal;
+}
+
+DLLEXPORT(void) fx2StatsDisable(struct USBDevice *device) {
+	struct DevStats **link, *entry;
+	pthread_mutex_lock(&registryLock);
+	for ( link = &registry; *link; link = &(*link)->next ) {
+		if ( (*link)->device == device ) {
+			entry = *link;
+			*link = entry->next;
+			free(entry);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&registryLock);
+}
+
+DLLEXPORT(bool) fx2StatsGet(struct USBDevice *device, struct FX2Stats *stats) {
+	struct DevStats *entry;
+	pthread_mutex_lock(&registryLock);
+	entry = find(device);
+	if ( entry ) {
+		*stats = entry->stats;
+	}
+	pthread_mutex_unlock(&registryLock);
+	return entry != NULL;
+}
+
+DLLEXPORT(void) fx2StatsReset(struct USBDevice *device) {
+	struct DevStats *entry;
+	pthread_mutex_lock(&registryLock);
+	entry = find(device);
+	if ( entry ) {
+		memset(&entry->stats, 0, sizeof(entry->stats));
+	}
+	pthread_mutex_unlock(&registryLock);
+}
+
+void statsBegin(struct USBDevice *device, FX2StatsOp op) {
+	struct DevStats *entry;
+	pthread_mutex_lock(&registryLock);
+	entry = find(device);
+	if ( entry && entry->depth++ == 0 ) {
+		entry->op = op;
+		entry->opStart = statsNow();
+	}
+	pthread_mutex_unlock(&registryLock);
+}
+
+void statsEnd(struct USBDevice *device, FX2Status status) {
+	struct DevStats *entry;
+	pthread_mutex_lock(&registryLock);
+	entry = find(device);
+	if ( entry && entry->depth && --entry->depth == 0 ) {
+		struct FX2OpStats *const op = entry->stats.ops + entry->op;
+		op->numOps++;
+		if ( status != FX2_SUCCESS ) {
+			op->numFailed++;
+		}
+		op->opNs += statsNow() - entry->opStart;
+		entry->op = FX2_STATS_OTHER;
+	}
+	pthread_mutex_unlock(&registryLock);
+}
+
+void statsPoll(struct USBDevice *device) {
+	struct DevStats *entry;
+	pthread_mutex_lock(&registryLock);
+	entry = find(device);
+	if ( entry ) {
+		entry->stats.ops[entry->op].numPolls++;
+	}
+	pthread_mutex_unlock(&registryLock);
+}
+
+uint64 statsStart(struct USBDevice *device) {
+	bool enabled;
+	pthread_mutex_lock(&registryLock);
+	enabled = find(device) != NULL;
+	pthread_mutex_unlock(&registryLock);
+	return enabled ? statsNow() : 0;
+}
+
+void statsTransfer(struct USBDevice *device, uint64 start, uint32 numBytes, bool failed) {
+	struct DevStats *entry;
+	uint64 ns;
+	if ( !start ) {
+		return;
+	}
+	ns = statsNow() - start;
+	pthread_mutex_lock(&registryLock);
+	entry = find(device);
+	if ( entry ) {
+		struct FX2OpStats *const op = entry->stats.ops + entry->op;
+		op->numTransfers++;
+		op->transferNs += ns;
+		if ( ns > op->maxTransferNs ) {
+			op->maxTransferNs = ns;
+		}
+		op->histogram[bucket(ns)]++;
+		if ( failed ) {
+			op->numErrors++;
+		} else {
+			op->numBytes += numBytes;
+		}
+	}
+	pthread_mutex_unlock(&registryLock);
+}
+
+void statsMove(struct USBDevice *oldDevice, struct USBDevice *newDevice) {
+	struct DevStats *entry;
+	if ( !newDevice ) {
+		fx2StatsDisable(oldDevice);
+		return;
+	}
+	pthread_mutex_lock(&registryLock);
+	entry = find(oldDevice);
+	if ( entry ) {
+		entry->device = newDevice;
+	}
+	pthread_mutex_unlock(&registryLock);
+}
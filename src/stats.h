@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <makestuff/common.h>
+#include <makestuff/libfx2loader.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The hooks behind fx2StatsEnable(). Each one is a cheap lookup which does nothing unless
+// statistics are enabled for the device.
+
+// Nanoseconds on a monotonic clock.
+//
+uint64 statsNow(void);
+
+// Mark the start and end of a public operation on the device. Calls nest: transfers are charged
+// to the outermost operation, so e.g fx2CrcEEPROM() falling back to fx2ReadEEPROM() still counts
+// as one verify.
+//
+void statsBegin(struct USBDevice *device, FX2StatsOp op);
+void statsEnd(struct USBDevice *device, FX2Status status);
+
+// Count a status poll while waiting for the firmware.
+//
+void statsPoll(struct USBDevice *device);
+
+// Call before each transfer; returns its start time, or zero if statistics are disabled.
+//
+uint64 statsStart(struct USBDevice *device);
+
+// Call after each transfer with the value statsStart() returned.
+//
+void statsTransfer(struct USBDevice *device, uint64 start, uint32 numBytes, bool failed);
+
+// Carry a device's statistics over to the handle it has been reopened as, or discard them if
+// newDevice is NULL.
+//
+void statsMove(struct USBDevice *oldDevice, struct USBDevice *newDevice);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
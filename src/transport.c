@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <makestuff/common.h>
+#include <makestuff/libusbwrap.h>
+#include "transport.h"
+#include "sim.h"
+#include "stats.h"
+
+USBStatus devControlRead(
+	struct USBDevice *device, uint8 bRequest, uint16 wValue, uint16 wIndex,
+	uint8 *data, uint16 wLength, uint32 timeout, const char **error)
+{
+	struct FX2Sim *const sim = simLookup(device);
+	const uint64 start = statsStart(device);
+	const USBStatus uStatus = sim ?
+		simControlRead(sim, bRequest, wValue, wIndex, data, wLength, error) :
+		usbControlRead(device, bRequest, wValue, wIndex, data, wLength, timeout, error);
+	statsTransfer(device, start, wLength, uStatus != USB_SUCCESS);
+	return uStatus;
+}
+
+USBStatus devControlWrite(
+	struct USBDevice *device, uint8 bRequest, uint16 wValue, uint16 wIndex,
+	const uint8 *data, uint16 wLength, uint32 timeout, const char **error)
+{
+	struct FX2Sim *const sim = simLookup(device);
+	const uint64 start = statsStart(device);
+	const USBStatus uStatus = sim ?
+		simControlWrite(sim, bRequest, wValue, wIndex, data, wLength, error) :
+		usbControlWrite(device, bRequest, wValue, wIndex, data, wLength, timeout, error);
+	statsTransfer(device, start, wLength, uStatus != USB_SUCCESS);
+	return uStatus;
+}
+
+USBStatus devBulkRead(
+	struct USBDevice *device, uint8 endpoint, uint8 *data, uint32 count, uint32 timeout,
+	const char **error)
+{
+	struct FX2Sim *const sim = simLookup(device);
+	const uint64 start = statsStart(device);
+	const USBStatus uStatus = sim ?
+		simBulk(sim, endpoint, count, error) :
+		usbBulkRead(device, endpoint, data, count, timeout, error);
+	statsTransfer(device, start, count, uStatus != USB_SUCCESS);
+	return uStatus;
+}
+
+USBStatus devBulkWrite(
+	struct USBDevice *device, uint8 endpoint, const uint8 *data, uint32 count, uint32 timeout,
+	const char **error)
+{
+	struct FX2Sim *const sim = simLookup(device);
+	const uint64 start = statsStart(device);
+	const USBStatus uStatus = sim ?
+		simBulk(sim, endpoint, count, error) :
+		usbBulkWrite(device, endpoint, data, count, timeout, error);
+	statsTransfer(device, start, count, uStatus != USB_SUCCESS);
+	return uStatus;
+}
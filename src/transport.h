@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <makestuff/common.h>
+#include <makestuff/libusbwrap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Drop-in replacements for the libusbwrap transfer functions, used everywhere the library talks
+// to a device. Each one passes the transfer to the simulation if the handle came from
+// fx2SimDevice(), and otherwise to libusbwrap, and records it if statistics are enabled.
+//
+USBStatus devControlRead(
+	struct USBDevice *device, uint8 bRequest, uint16 wValue, uint16 wIndex,
+	uint8 *data, uint16 wLength, uint32 timeout, const char **error);
+
+USBStatus devControlWrite(
+	struct USBDevice *device, uint8 bRequest, uint16 wValue, uint16 wIndex,
+	const uint8 *data, uint16 wLength, uint32 timeout, const char **error);
+
+USBStatus devBulkRead(
+	struct USBDevice *device, uint8 endpoint, uint8 *data, uint32 count, uint32 timeout,
+	const char **error);
+
+USBStatus devBulkWrite(
+	struct USBDevice *device, uint8 endpoint, const uint8 *data, uint32 count, uint32 timeout,
+	const char **error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
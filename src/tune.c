@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <makestuff/common.h>
+#include <makestuff/liberror.h>
+#include <makestuff/libfx2loader.h>
+#include "xfer.h"
+#include "tune.h"
+
+// Chunk sizes are FX2_CHUNK_MIN << index. Every tuned transfer goes over the control pipe, where
+// Linux usbfs rejects a wLength above 4096, so the largest size is also the default.
+//
+#define CHUNK_SIZE(i) ((uint32)FX2_CHUNK_MIN << (i))
+#define NUM_SIZES 4      // up to FX2_CHUNK_MAX
+#define TOP_INDEX (NUM_SIZES - 1)
+#define DEFAULT_INDEX 3  // BLOCK_SIZE
+
+// A size is trusted after this many full chunks; the neighbours of the best size are tried again
+// every PROBE_INTERVAL chunks, in case conditions have changed; and a neighbour must be this much
+// faster to be preferred, so noise doesn't make the size wander.
+//
+#define MIN_SAMPLES 2
+#define PROBE_INTERVAL 32
+#define HYSTERESIS 1.05
+
+// Derived timeouts allow four times the expected duration plus a second, within these limits.
+//
+#define MIN_TIMEOUT 1000
+#define MAX_TIMEOUT 60000
+
+struct Profile {
+	uint32 best;        // index of the fastest size so far
+	uint32 sinceProbe;  // chunks since the neighbours were last tried
+	double rate[NUM_SIZES];  // smoothed bytes per second at each size
+	uint32 samples[NUM_SIZES];
+};
+
+struct DevTune {
+	struct DevTune *next;
+	struct USBDevice *device;
+	struct FX2TransferConfig config;
+	struct Profile profiles[FX2_TRANSFER_NUM_KINDS];
+};
+
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+static struct DevTune *registry = NULL;
+
+// Call with the lock held.
+//
+static struct DevTune *find(struct USBDevice *device) {
+	struct DevTune *entry;
+	for ( entry = registry; entry && entry->device != device; entry = entry->next );
+	return entry;
+}
+
+// The index of the largest size no bigger than chunkSize, clamped to the legal range.
+//
+static uint32 sizeIndex(uint32 chunkSize) {
+	uint32 i = 0;
+	while ( i < TOP_INDEX && CHUNK_SIZE(i + 1) <= chunkSize ) {
+		i++;
+	}
+	return i;
+}
+
+// Stay on the best size until it is trusted, then try each untrusted neighbour in turn.
+//
+static uint32 choose(const struct DevTune *entry, FX2TransferKind kind) {
+	const struct Profile *const p = entry->profiles + kind;
+	uint32 i;
+	if ( entry->config.chunkSize ) {
+		return sizeIndex(entry->config.chunkSize);
+	}
+	i = p->best;
+	if ( p->samples[i] < MIN_SAMPLES ) {
+		return i;
+	}
+	if ( i < TOP_INDEX && p->samples[i + 1] < MIN_SAMPLES ) {
+		return i + 1;
+	}
+	if ( i > 0 && p->samples[i - 1] < MIN_SAMPLES ) {
+		return i - 1;
+	}
+	return i;
+}
+
+// Without a measurement, scale the default timeout with the chunk size.
+//
+static uint32 timeoutFor(const struct DevTune *entry, FX2TransferKind kind, uint32 i) {
+	const double rate = entry->profiles[kind].rate[i];
+	const uint32 chunkSize = CHUNK_SIZE(i);
+	double ms;
+	if ( entry->config.timeout ) {
+		return entry->config.timeout;
+	}
+	if ( rate <= 0.0 ) {
+		return XFER_TIMEOUT;
+	}
+	ms = 4000.0 * chunkSize / rate + 1000.0;
+	return (ms < MIN_TIMEOUT) ? MIN_TIMEOUT : (ms > MAX_TIMEOUT) ? MAX_TIMEOUT : (uint32)ms;
+}
+
+DLLEXPORT(FX2Status) fx2SetTransferConfig(
+	struct USBDevice *device, const struct FX2TransferConfig *config, const char **error)
+{
+	FX2Status retVal = FX2_SUCCESS;
+	struct DevTune *entry;
+	uint32 kind;
+	pthread_mutex_lock(&registryLock);
+	entry = find(device);
+	if ( !entry ) {
+		entry = (struct DevTune *)calloc(1, sizeof(struct DevTune));
+		CHECK_STATUS(
+			!entry, FX2_BUF_ERR, cleanup, "fx2SetTransferConfig(): Unable to allocate configuration");
+		entry->device = device;
+		entry->next = registry;
+		registry = entry;
+	}
+	memset(entry->profiles, 0, sizeof(entry->profiles));
+	for ( kind = 0; kind < FX2_TRANSFER_NUM_KINDS; kind++ ) {
+		entry->profiles[kind].best = DEFAULT_INDEX;
+	}
+	entry->config = *config;
+cleanup:
+	pthread_mutex_unlock(&registryLock);
+	return retVal;
+}
+
+DLLEXPORT(void) fx2ClearTransferConfig(struct USBDevice *device) {
+	struct DevTune **link, *entry;
+	pthread_mutex_lock(&registryLock);
+	for ( link = &registry; *link; link = &(*link)->next ) {
+		if ( (*link)->device == device ) {
+			entry = *link;
+			*link = entry->next;
+			free(entry);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&registryLock);
+}
+
+DLLEXPORT(bool) fx2GetTransferTuning(
+	struct USBDevice *device, FX2TransferKind kind, struct FX2TransferTuning *tuning)
+{
+	struct DevTune *entry;
+	pthread_mutex_lock(&registryLock);
+	entry = find(device);
+	if ( entry ) {
+		const uint32 i = choose(entry, kind);
+		tuning->chunkSize = CHUNK_SIZE(i);
+		tuning->timeout = timeoutFor(entry, kind, i);
+		tuning->bytesPerSecond = entry->profiles[kind].rate[i];
+	} else {
+		tuning->chunkSize = BLOCK_SIZE;
+		tuning->timeout = XFER_TIMEOUT;
+		tuning->bytesPerSecond = 0.0;
+	}
+	pthread_mutex_unlock(&registryLock);
+	return entry != NULL;
+}
+
+bool tuneNext(struct USBDevice *device, FX2TransferKind kind, uint32 *chunkSize, uint32 *timeout) {
+	struct DevTune *entry;
+	pthread_mutex_lock(&registryLock);
+	entry = find(device);
+	if ( entry ) {
+		const uint32 i = choose(entry, kind);
+		*chunkSize = CHUNK_SIZE(i);
+		*timeout = timeoutFor(entry, kind, i);
+	} else {
+		*chunkSize = BLOCK_SIZE;
+		*timeout = XFER_TIMEOUT;
+	}
+	pthread_mutex_unlock(&registryLock);
+	return entry != NULL;
+}
+
+// Only full chunks are measured, since a short final chunk pays the same fixed cost for fewer
+// bytes. A failure marks the size as hopeless until the next probe, and steps down from it.
+//
+void tuneRecord(
+	struct USBDevice *device, FX2TransferKind kind, uint32 chunkSize, uint32 numBytes,
+	uint64 ns, bool failed)
+{
+	struct DevTune *entry;
+	struct Profile *p;
+	const uint32 i = sizeIndex(chunkSize);
+	uint32 j, lo, hi;
+	pthread_mutex_lock(&registryLock);
+	entry = find(device);
+	if ( !entry ) {
+		goto cleanup;
+	}
+	p = entry->profiles + kind;
+	if ( failed ) {
+		p->rate[i] = 0.0;
+		p->samples[i] = MIN_SAMPLES;
+		if ( p->best >= i && i > 0 ) {
+			p->best = i - 1;
+		}
+		goto cleanup;
+	}
+	if ( numBytes < chunkSize || !ns ) {
+		goto cleanup;
+	}
+	{
+		const double rate = (double)numBytes * 1e9 / (double)ns;
+		// A size whose last chunk failed has no rate to smooth, so starts afresh
+		p->rate[i] = (p->samples[i] && p->rate[i] > 0.0) ? 0.75 * p->rate[i] + 0.25 * rate : rate;
+		p->samples[i]++;
+	}
+
+	// Move to a trusted neighbour if it is clearly faster
+	lo = (p->best > 0) ? p->best - 1 : 0;
+	hi = (p->best < TOP_INDEX) ? p->best + 1 : p->best;
+	for ( j = lo; j <= hi; j++ ) {
+		if ( p->samples[j] >= MIN_SAMPLES && p->rate[j] > HYSTERESIS * p->rate[p->best] ) {
+			p->best = j;
+		}
+	}
+
+	// Every so often, give the neighbours another try
+	if ( ++p->sinceProbe >= PROBE_INTERVAL ) {
+		p->sinceProbe = 0;
+		lo = (p->best > 0) ? p->best - 1 : p->best;
+		hi = (p->best < TOP_INDEX) ? p->best + 1 : p->best;
+		for ( j = lo; j <= hi; j++ ) {
+			if ( j != p->best && p->samples[j] >= MIN_SAMPLES ) {
+				p->samples[j] = MIN_SAMPLES - 1;
+			}
+		}
+	}
+cleanup:
+	pthread_mutex_unlock(&registryLock);
+}
+
+void tuneMove(struct USBDevice *oldDevice, struct USBDevice *newDevice) {
+	struct DevTune *entry;
+	if ( !newDevice ) {
+		fx2ClearTransferConfig(oldDevice);
+		return;
+	}
+	pthread_mutex_lock(&registryLock);
+	entry = find(oldDevice);
+	if ( entry ) {
+		entry->device = newDevice;
+	}
+	pthread_mutex_unlock(&registryLock);
+}
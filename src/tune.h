@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <makestuff/common.h>
+#include <makestuff/libfx2loader.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The hooks behind fx2SetTransferConfig(). Without a configuration for the device they return
+// the fixed defaults and record nothing.
+
+// Get the chunk size and timeout for the next chunk of the given kind. Returns true if the device
+// is being tuned, in which case the chunk should be reported with tuneRecord().
+//
+bool tuneNext(struct USBDevice *device, FX2TransferKind kind, uint32 *chunkSize, uint32 *timeout);
+
+// Report that a chunk transferred numBytes of the chunkSize tuneNext() asked for, in the given
+// number of nanoseconds, or failed.
+//
+void tuneRecord(
+	struct USBDevice *device, FX2TransferKind kind, uint32 chunkSize, uint32 numBytes,
+	uint64 ns, bool failed);
+
+// Carry a device's transfer configuration and measurements over to the handle it has been
+// reopened as, or discard them if newDevice is NULL.
+//
+void tuneMove(struct USBDevice *oldDevice, struct USBDevice *newDevice);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,5 +21,26 @@
 #define CMD_CALCULATOR        0x80
 #define CMD_READ_WRITE_RAM    0xA0
 #define CMD_READ_WRITE_EEPROM 0xA2
+#define CMD_EEPROM_CONFIG     0xA4
+#define CMD_EEPROM_BULK_WRITE 0xA5
+#define CMD_EEPROM_BULK_READ  0xA6
+#define CMD_EEPROM_CRC32      0xA7
+
+// Feature bits returned by CMD_EEPROM_CONFIG
+#define FEATURE_PAGE_WRITE    (1<<0)
+#define FEATURE_BULK_WRITE    (1<<1)
+#define FEATURE_BULK_READ     (1<<2)
+#define FEATURE_BANKS         (1<<3)
+#define FEATURE_CRC32         (1<<4)
+
+// Endpoints used for bulk EEPROM transfers
+#define EP_BULK_WRITE         2
+#define EP_BULK_READ          4
+
+// Features this firmware supports
+#define FEATURES              (FEATURE_PAGE_WRITE | FEATURE_BULK_WRITE | FEATURE_BULK_READ | FEATURE_BANKS | FEATURE_CRC32)
+
+// Largest EEPROM page the firmware can buffer
+#define MAX_PAGE_SIZE         128
 
 #endif
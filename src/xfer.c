@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <string.h>
+#include <makestuff/common.h>
+#include <makestuff/libusbwrap.h>
+#include "vendorCommands.h"
+#include "xfer.h"
+#include "transport.h"
+#include "stats.h"
+#include "tune.h"
+#include "scan.h"
+
+void xferInitWrite(
+	struct XferJob *job, uint8 bRequest, uint32 address, const uint8 *bufPtr, uint32 numBytes)
+{
+	job->bRequest = bRequest;
+	job->isRead = false;
+	job->readPtr = NULL;
+	job->writePtr = bufPtr;
+	job->address = address;
+	job->remaining = numBytes;
+	job->timeout = 0;
+	job->started = false;
+}
+
+void xferInitRead(
+	struct XferJob *job, uint8 bRequest, uint32 address, uint8 *bufPtr, uint32 numBytes)
+{
+	job->bRequest = bRequest;
+	job->isRead = true;
+	job->readPtr = bufPtr;
+	job->writePtr = NULL;
+	job->address = address;
+	job->remaining = numBytes;
+	job->timeout = 0;
+	job->started = false;
+}
+
+// Issue one chunk of at most the device's block size, then advance the job past it. Chunks end
+// on block boundaries, so when a job starts part-way through a block every chunk still starts on
+// an EEPROM page boundary.
+//
+USBStatus xferNext(struct USBDevice *device, struct XferJob *job, const char **error) {
+	USBStatus uStatus;
+	const FX2TransferKind kind =
+		(job->bRequest == CMD_READ_WRITE_RAM) ? FX2_TRANSFER_RAM :
+		job->isRead ? FX2_TRANSFER_EEPROM_READ : FX2_TRANSFER_EEPROM_WRITE;
+	uint32 blockSize, timeout;
+	const bool tuned = tuneNext(device, kind, &blockSize, &timeout);
+	const uint16 chunkSize = xferChunkSize(job, blockSize);
+	const uint64 start = tuned ? statsNow() : 0;
+	if ( job->timeout ) {
+		timeout = job->timeout;
+	}
+	if ( job->isRead ) {
+		uStatus = devControlRead(
+			device,
+			job->bRequest,                // bRequest: RAM or EEPROM access
+			(uint16)job->address,         // wValue: address to read
+			(uint16)(job->address >> 16), // wIndex: bank
+			job->readPtr,                 // buffer to receive the data
+			chunkSize,                    // wLength: number of bytes to read
+			timeout,                      // timeout
+			error
+		);
+	} else {
+		uStatus = devControlWrite(
+			device,
+			job->bRequest,                // bRequest: RAM or EEPROM access
+			(uint16)job->address,         // wValue: address to write
+			(uint16)(job->address >> 16), // wIndex: bank
+			job->writePtr,                // data to be written
+			chunkSize,                    // wLength: number of bytes to write
+			timeout,                      // timeout
+			error
+		);
+	}
+	if ( tuned ) {
+		tuneRecord(
+			device, kind, blockSize, chunkSize, statsNow() - start, uStatus != USB_SUCCESS);
+	}
+	if ( uStatus == USB_SUCCESS ) {
+		xferAdvance(job, chunkSize);
+	}
+	return uStatus;
+}
+
+// Compare a page at a time; a run ends at the first page which is already correct.
+//
+bool xferNextDirtyRun(
+	const uint8 *newData, const uint8 *oldData, uint32 numBytes, uint32 pageSize,
+	uint32 *offset, uint32 *length)
+{
+	uint32 page = *offset - *offset % pageSize;
+	uint32 start, size;
+	if ( *offset >= numBytes ) {
+		return false;
+	}
+	for ( ;; ) {
+		if ( page >= numBytes ) {
+			return false;
+		}
+		size = (numBytes - page < pageSize) ? numBytes - page : pageSize;
+		if ( memcmp(newData + page, oldData + page, size) ) {
+			break;
+		}
+		page += size;
+	}
+	start = page;
+	do {
+		page += size;
+		if ( page >= numBytes ) {
+			break;
+		}
+		size = (numBytes - page < pageSize) ? numBytes - page : pageSize;
+	} while ( memcmp(newData + page, oldData + page, size) );
+	*offset = start;
+	*length = page - start;
+	return true;
+}
+
+// Alternate between the scanning kernels: find the end of each defined run, then the start of the
+// next, until a gap turns out to be longer than maxGap (or runs off the end).
+//
+bool xferNextMaskRun(
+	const uint8 *mask, uint32 numBytes, uint32 maxGap, uint32 *offset, uint32 *length)
+{
+	const size_t start = scanFindNonZero(mask, *offset, numBytes);
+	size_t end, next;
+	if ( start >= numBytes ) {
+		return false;
+	}
+	end = scanFindZero(mask, start, numBytes);
+	while ( end < numBytes ) {
+		next = scanFindNonZero(mask, end, numBytes);
+		if ( next >= numBytes || next - end > maxGap ) {
+			break;
+		}
+		end = scanFindZero(mask, next, numBytes);
+	}
+	*offset = (uint32)start;
+	*length = (uint32)(end - start);
+	return true;
+}
+
+bool xferNextSegmentRun(
+	const struct FX2Segment *segments, uint32 numSegments, uint32 maxGap, uint32 *next,
+	struct XferRun *run)
+{
+	uint32 i = *next, end;
+	while ( i < numSegments && !segments[i].length ) {
+		i++;
+	}
+	if ( i >= numSegments ) {
+		*next = i;
+		return false;
+	}
+	run->address = segments[i].address;
+	run->first = i;
+	end = segments[i].address + segments[i].length;
+	for ( i++; i < numSegments; i++ ) {
+		if ( !segments[i].length ) {
+			continue;
+		}
+		if ( segments[i].address - end > maxGap ) {
+			break;
+		}
+		end = segments[i].address + segments[i].length;
+	}
+	run->length = end - run->address;
+	run->count = i - run->first;
+	*next = i;
+	return true;
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef XFER_H
+#define XFER_H
+
+#include <makestuff/common.h>
+#include <makestuff/libusbwrap.h>
+#include <makestuff/libfx2loader.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLOCK_SIZE 4096
+#define XFER_TIMEOUT 5000
+
+// A chunked transfer of a contiguous region over the vendor-command control pipe. The address is
+// linear: the low 16 bits go in wValue and the upper bits go in wIndex as the EEPROM bank.
+//
+struct XferJob {
+	uint8 bRequest;
+	bool isRead;
+	uint8 *readPtr;
+	const uint8 *writePtr;
+	uint32 address;
+	uint32 remaining;
+	uint32 timeout;  // per chunk, in milliseconds, or zero for the device's
+	bool started;
+};
+
+// Prepare a job to write numBytes from bufPtr to the given address.
+//
+void xferInitWrite(
+	struct XferJob *job, uint8 bRequest, uint32 address, const uint8 *bufPtr, uint32 numBytes);
+
+// Prepare a job to read numBytes from the given address into bufPtr.
+//
+void xferInitRead(
+	struct XferJob *job, uint8 bRequest, uint32 address, uint8 *bufPtr, uint32 numBytes);
+
+// Returns true when every chunk of the job has been transferred. A zero-length job still issues
+// one (empty) transfer, just like the original loops did.
+//
+static inline bool xferFinished(const struct XferJob *job) {
+	return job->started && job->remaining == 0;
+}
+
+// The size of the next chunk of the job: at most blockSize bytes, ending on a blockSize boundary.
+//
+static inline uint16 xferChunkSize(const struct XferJob *job, uint32 blockSize) {
+	const uint32 toBoundary = blockSize - job->address % blockSize;
+	return (uint16)(job->remaining > toBoundary ? toBoundary : job->remaining);
+}
+
+// Advance the job past a chunk of chunkSize bytes which has been transferred.
+//
+static inline void xferAdvance(struct XferJob *job, uint16 chunkSize) {
+	job->started = true;
+	job->remaining -= chunkSize;
+	job->address += chunkSize;
+	if ( job->isRead ) {
+		job->readPtr += chunkSize;
+	} else {
+		job->writePtr += chunkSize;
+	}
+}
+
+// Issue the next chunk of the job, sized and timed for the device, and advance it.
+//
+USBStatus xferNext(struct USBDevice *device, struct XferJob *job, const char **error);
+
+// Starting at *offset, find the next run of consecutive pages where newData and oldData differ.
+// Returns false if there are no more differences, else sets *offset and *length to the run. The
+// run is page-aligned, except that the final page may be short if numBytes is not a multiple of
+// pageSize.
+//
+bool xferNextDirtyRun(
+	const uint8 *newData, const uint8 *oldData, uint32 numBytes, uint32 pageSize,
+	uint32 *offset, uint32 *length);
+
+// Gaps of up to this many undefined bytes are uploaded as filler rather than ending a run: each
+// control transfer pays for a SETUP and a STATUS stage and a round trip through the host
+// controller's schedule, which costs about as much as eight 64-byte EP0 data packets.
+//
+#define XFER_MERGE_GAP 512
+
+// Starting at *offset, find the next run of the image to upload: it starts at the next byte the
+// mask marks as defined, and extends over defined bytes and over gaps of at most maxGap undefined
+// bytes. Returns false if there are no more defined bytes, else sets *offset and *length to the
+// run, which always starts and ends on a defined byte.
+//
+bool xferNextMaskRun(
+	const uint8 *mask, uint32 numBytes, uint32 maxGap, uint32 *offset, uint32 *length);
+
+// A run of consecutive segments, from an address-ordered list, to be uploaded as one.
+//
+struct XferRun {
+	uint32 address;
+	uint32 length;
+	uint32 first;  // index of the run's first segment
+	uint32 count;  // number of segments in the run
+};
+
+// Starting at segment *next, merge segments into a run while the gaps between them are at most
+// maxGap bytes, skipping empty segments. The segments must be sorted by address and must not
+// overlap. Returns false if there are no more segments, else sets *run and advances *next past it.
+//
+bool xferNextSegmentRun(
+	const struct FX2Segment *segments, uint32 numSegments, uint32 maxGap, uint32 *next,
+	struct XferRun *run);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+#include "vendorCommands.h"
+#include "transport.h"
+
+TEST(Async, testReadEEPROM) {
+	struct FX2Sim *sim;
+	struct FX2Operation *op;
+	struct Buffer readBack;
+	uint8 image[5000];
+	uint32 bytesDone = 0;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(NULL, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+	for ( uint32 i = 0; i < sizeof(image); i++ ) {
+		image[i] = (uint8)(i * 11);
+	}
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteEEPROM(device, image, sizeof(image), NULL));
+
+	// The data is appended once the read completes
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&readBack, 16, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufAppendByte(&readBack, 0x55, NULL));
+	ASSERT_EQ(
+		FX2_SUCCESS, fx2ReadEEPROMAsync(device, sizeof(image), &readBack, NULL, NULL, &op, NULL));
+	ASSERT_EQ(FX2_SUCCESS, fx2OpWait(op, NULL));
+	ASSERT_TRUE(fx2OpPoll(op, &bytesDone));
+	fx2OpFree(op);
+	ASSERT_EQ(sizeof(image), bytesDone);
+	ASSERT_EQ(1 + sizeof(image), readBack.length);
+	ASSERT_EQ(0x55, readBack.data[0]);
+	ASSERT_EQ(0, std::memcmp(image, readBack.data + 1, sizeof(image)));
+
+	// A failed read leaves the length alone and the spare capacity full of the fill byte, even if
+	// the failed chunk delivered some bytes (the sim can't fail part-way, so plant them)
+	const uint8 reset = 0x01;
+	const size_t length = readBack.length;
+	ASSERT_EQ(
+		USB_SUCCESS, devControlWrite(device, CMD_READ_WRITE_RAM, 0xE600, 0x0000, &reset, 1, 5000, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufAppendConst(&readBack, 0x00, sizeof(image), NULL));
+	readBack.length = length;
+	std::memset(readBack.data + length, 0xEE, sizeof(image));
+	ASSERT_EQ(
+		FX2_SUCCESS, fx2ReadEEPROMAsync(device, sizeof(image), &readBack, NULL, NULL, &op, NULL));
+	ASSERT_EQ(FX2_USB_ERR, fx2OpWait(op, NULL));
+	fx2OpFree(op);
+	ASSERT_EQ(length, readBack.length);
+	for ( uint32 i = 0; i < sizeof(image); i++ ) {
+		ASSERT_EQ(0x00, readBack.data[length + i]);
+	}
+	bufDestroy(&readBack);
+	fx2SimDestroy(sim);
+}
+
+TEST(Async, testBanksRefused) {
+	// Firmware which can't report its features can't be trusted with the bank in wIndex, so
+	// transfers beyond 64KiB are refused before they start rather than wrapping around
+	struct FX2SimConfig config;
+	struct FX2Sim *sim;
+	struct FX2Operation *op = NULL;
+	struct Buffer readBack;
+	std::vector<uint8> image(0x10001, 0x42);
+	fx2SimDefaultConfig(&config);
+	config.eepromSize = 0x20000;
+	config.firmwareRunning = false;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(&config, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+	ASSERT_EQ(
+		FX2_USB_ERR,
+		fx2WriteEEPROMAsync(device, image.data(), (uint32)image.size(), NULL, NULL, &op, NULL));
+	ASSERT_TRUE(op == NULL);
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&readBack, 16, 0x00, NULL));
+	ASSERT_EQ(
+		FX2_USB_ERR,
+		fx2ReadEEPROMAsync(device, (uint32)image.size(), &readBack, NULL, NULL, &op, NULL));
+	ASSERT_TRUE(op == NULL);
+	ASSERT_EQ(0UL, readBack.length);
+	bufDestroy(&readBack);
+	fx2SimDestroy(sim);
+}
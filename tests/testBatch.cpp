@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2009-2011 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *  
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+extern "C" {
+	#include "fx2cli.h"
+}
+
+static void writeHex(
+	const std::string &fileName, const uint8 *bytes, const uint8 *present, size_t length)
+{
+	Buffer data, mask;
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&data, 64, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&mask, 64, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufAppendBlock(&data, bytes, length, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufAppendBlock(&mask, present, length, NULL));
+	ASSERT_EQ(HEX_SUCCESS, hexWriteFile(&data, &mask, fileName.c_str(), 16, NULL));
+	bufDestroy(&mask);
+	bufDestroy(&data);
+}
+
+// A sparse file converted after a dense one by the same worker must not pick up the dense file's
+// bytes in its gaps.
+//
+TEST(Batch, testSparseAfterDense) {
+	char dirTemplate[] = "/tmp/fx2batchXXXXXX";
+	const std::string dir = mkdtemp(dirTemplate);
+	const std::string manifest = dir + "/manifest.txt";
+	uint8 bytes[32], present[32];
+	Buffer data, mask;
+	FILE *file;
+	size_t i;
+
+	// a.hex defines 32 bytes of 0xAA; b.hex defines only 0x00-0x03 and 0x10-0x13
+	for ( i = 0; i < 32; i++ ) {
+		bytes[i] = 0xAA;
+		present[i] = 0x01;
+	}
+	writeHex(dir + "/a.hex", bytes, present, 32);
+	for ( i = 0; i < 20; i++ ) {
+		bytes[i] = (i < 4) ? 0x11 : (i >= 16) ? 0x22 : 0x00;
+		present[i] = (i < 4 || i >= 16) ? 0x01 : 0x00;
+	}
+	writeHex(dir + "/b.hex", bytes, present, 20);
+
+	// One worker, so b.hex reuses the buffers a.hex was read into
+	file = fopen(manifest.c_str(), "w");
+	ASSERT_TRUE(file != NULL);
+	fprintf(file, "%s/a.hex %s/a.out.hex\n", dir.c_str(), dir.c_str());
+	fprintf(file, "%s/b.hex %s/b.out.hex\n", dir.c_str(), dir.c_str());
+	fclose(file);
+	ASSERT_EQ(0, batchRun(manifest.c_str(), 1, I2C_SEG_DEFAULT));
+
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&data, 64, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&mask, 64, 0x00, NULL));
+	ASSERT_EQ(HEX_SUCCESS, hexReadFile((dir + "/b.out.hex").c_str(), &data, &mask, NULL));
+	ASSERT_EQ(20UL, data.length);
+	for ( i = 0; i < 20; i++ ) {
+		EXPECT_EQ(present[i], mask.data[i]) << "at " << i;
+		if ( present[i] ) {
+			EXPECT_EQ(bytes[i], data.data[i]) << "at " << i;
+		}
+	}
+	bufDestroy(&mask);
+	bufDestroy(&data);
+
+	remove((dir + "/a.out.hex").c_str());
+	remove((dir + "/b.out.hex").c_str());
+	remove((dir + "/a.hex").c_str());
+	remove((dir + "/b.hex").c_str());
+	remove(manifest.c_str());
+	rmdir(dir.c_str());
+}
+
+// A glob which matches nothing is a manifest error, not an empty success, and stops the whole
+// run before anything is converted.
+//
+TEST(Batch, testGlobNoMatch) {
+	char dirTemplate[] = "/tmp/fx2batchXXXXXX";
+	const std::string dir = mkdtemp(dirTemplate);
+	const std::string manifest = dir + "/manifest.txt";
+	const uint8 bytes[] = {0x01, 0x02, 0x03, 0x04};
+	const uint8 present[] = {0x01, 0x01, 0x01, 0x01};
+	FILE *file;
+	writeHex(dir + "/a.hex", bytes, present, sizeof(bytes));
+	file = fopen(manifest.c_str(), "w");
+	ASSERT_TRUE(file != NULL);
+	fprintf(file, "%s/a.hex %s/a.out.hex\n", dir.c_str(), dir.c_str());
+	fprintf(file, "%s/typo*.hex %s/*.out.hex\n", dir.c_str(), dir.c_str());
+	fclose(file);
+	ASSERT_EQ(36, batchRun(manifest.c_str(), 1, I2C_SEG_DEFAULT));
+	ASSERT_NE(0, access((dir + "/a.out.hex").c_str(), F_OK));
+
+	remove((dir + "/a.hex").c_str());
+	remove(manifest.c_str());
+	rmdir(dir.c_str());
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.hpp>
+
+#define LENGTH 3000
+
+// A firmware image with long runs (forcing 1023-byte splits), short gaps that are bridged and
+// longer gaps that split records.
+//
+static constexpr std::array<uint8, LENGTH> makeMask() {
+	std::array<uint8, LENGTH> mask{};
+	for ( std::size_t i = 0; i < LENGTH; i++ ) {
+		mask[i] = !((i >= 1100 && i < 1103) || (i >= 1500 && i < 1510) || (i % 97 == 0) || i >= 2990);
+	}
+	return mask;
+}
+
+static constexpr std::array<uint8, LENGTH> makeData() {
+	std::array<uint8, LENGTH> data{};
+	for ( std::size_t i = 0; i < LENGTH; i++ ) {
+		data[i] = static_cast<uint8>(i * 7 + 3);
+	}
+	return data;
+}
+
+static constexpr auto fwMask = makeMask();
+static constexpr auto fwData = makeData();
+static constexpr auto fwImage = fx2::c2Image<fx2::c2ImageSize(fwMask)>(fwData, fwMask);
+static constexpr auto fwPlan = fx2::ramPlan<fx2::ramPlanSize(fwMask)>(fwMask);
+
+static_assert(fwImage[0] == 0xC2, "C2 header");
+static_assert(fwImage[fwImage.size() - 5] == 0x80, "terminating record");
+
+TEST(Constexpr, testMatchesEncoder) {
+	Buffer i2cBuffer, data, mask;
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&i2cBuffer, 1024, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&data, LENGTH, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&mask, LENGTH, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufAppendBlock(&data, fwData.data(), LENGTH, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufAppendBlock(&mask, fwMask.data(), LENGTH, NULL));
+	i2cInitialise(&i2cBuffer, 0x0000, 0x0000, 0x0000, CONFIG_BYTE_400KHZ);
+	ASSERT_EQ(I2C_SUCCESS, i2cWritePromRecords(&i2cBuffer, &data, &mask, NULL));
+	ASSERT_EQ(I2C_SUCCESS, i2cFinalise(&i2cBuffer, NULL));
+	ASSERT_EQ(i2cBuffer.length, fwImage.size());
+	ASSERT_EQ(0, std::memcmp(i2cBuffer.data, fwImage.data(), fwImage.size()));
+	bufDestroy(&mask);
+	bufDestroy(&data);
+	bufDestroy(&i2cBuffer);
+}
+
+TEST(Constexpr, testRamPlan) {
+	std::size_t i, total = 0;
+	for ( i = 0; i < fwPlan.size(); i++ ) {
+		ASSERT_TRUE(fwMask[fwPlan[i].address]);
+		ASSERT_TRUE(fwPlan[i].address == 0 || !fwMask[fwPlan[i].address - 1U]);
+		total += fwPlan[i].length;
+	}
+	for ( i = 0; i < LENGTH; i++ ) {
+		total -= fwMask[i];
+	}
+	ASSERT_EQ(0UL, total);
+}
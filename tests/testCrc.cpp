@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libfx2loader.h>
+
+TEST(CRC, testCheckValue) {
+	const uint8 data[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+	ASSERT_EQ(0xCBF43926U, fx2Crc32(0, data, 9));
+	ASSERT_EQ(0x00000000U, fx2Crc32(0, data, 0));
+}
+
+TEST(CRC, testIncremental) {
+	const uint8 data[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+	ASSERT_EQ(fx2Crc32(0, data, 9), fx2Crc32(fx2Crc32(0, data, 4), data + 4, 5));
+}
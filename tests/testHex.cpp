@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+
+TEST(Hex, testParse) {
+	const char text[] =
+		":03000000020006F5\r\n"
+		":030006001234565B\r\n"
+		":00000001FF\r\n"
+		"trailing rubbish is ignored";
+	Buffer data, mask;
+	const uint8 expData[] = {0x02, 0x00, 0x06, 0x00, 0x00, 0x00, 0x12, 0x34, 0x56};
+	const uint8 expMask[] = {0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x01, 0x01, 0x01};
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&data, 16, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&mask, 16, 0x00, NULL));
+	ASSERT_EQ(HEX_SUCCESS, hexParse(text, sizeof(text) - 1, &data, &mask, NULL));
+	ASSERT_EQ(9UL, data.length);
+	ASSERT_EQ(0, std::memcmp(expData, data.data, 9));
+	ASSERT_EQ(0, std::memcmp(expMask, mask.data, 9));
+	bufDestroy(&mask);
+	bufDestroy(&data);
+}
+
+TEST(Hex, testParseErrors) {
+	const char badSum[] = ":03000000020006F6\n";
+	const char badChar[] = ":0300000002G006F5\n";
+	const char truncated[] = ":0300000002\n";
+	Buffer data, mask;
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&data, 16, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&mask, 16, 0x00, NULL));
+	ASSERT_EQ(HEX_CHECKSUM_ERROR, hexParse(badSum, sizeof(badSum) - 1, &data, &mask, NULL));
+	ASSERT_EQ(HEX_SYNTAX_ERROR, hexParse(badChar, sizeof(badChar) - 1, &data, &mask, NULL));
+	ASSERT_EQ(HEX_SYNTAX_ERROR, hexParse(truncated, sizeof(truncated) - 1, &data, &mask, NULL));
+	bufDestroy(&mask);
+	bufDestroy(&data);
+}
+
+TEST(Hex, testRoundTrip) {
+	Buffer data, mask, text, data2, mask2;
+	size_t i;
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&data, 1024, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&mask, 1024, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&text, 1024, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&data2, 1024, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&mask2, 1024, 0x00, NULL));
+	for ( i = 0; i < 70000; i++ ) {
+		const bool defined = (i % 300) < 200;
+		ASSERT_EQ(BUF_SUCCESS, bufAppendByte(&data, defined ? (uint8)(i * 7) : 0x00, NULL));
+		ASSERT_EQ(BUF_SUCCESS, bufAppendByte(&mask, defined ? 0x01 : 0x00, NULL));
+	}
+	ASSERT_EQ(HEX_SUCCESS, hexFormat(&data, &mask, 32, &text, NULL));
+	ASSERT_EQ(0, std::memcmp(":20000000", text.data, 9));
+	ASSERT_EQ(HEX_SUCCESS, hexParse((const char *)text.data, text.length, &data2, &mask2, NULL));
+	ASSERT_EQ(mask.length, mask2.length);
+	ASSERT_EQ(0, std::memcmp(data.data, data2.data, data2.length));
+	ASSERT_EQ(0, std::memcmp(mask.data, mask2.data, mask2.length));
+	bufDestroy(&mask2);
+	bufDestroy(&data2);
+	bufDestroy(&text);
+	bufDestroy(&mask);
+	bufDestroy(&data);
+}
@@ -14,6 +14,7 @@
  * You should have received a copy of the GNU Lesser General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <cstdio>
 #include <cstring>
 #include <gtest/gtest.h>
 #include <makestuff/common.h>
@@ -112,3 +113,131 @@ TEST(I2C, testFinaliseNoInit) {
 	ASSERT_EQ(I2C_NOT_INITIALISED, iStatus);
 	bufDestroy(&buf);
 }
+
+TEST(I2C, testIterator) {
+	const uint8 image[] = {
+		0xC2, LSB(VID), MSB(VID), LSB(PID), MSB(PID), LSB(DID), MSB(DID), CONFIG_BYTE_400KHZ,
+		0x00, 0x03, 0x00, 0x10, 0xA1, 0xA2, 0xA3,  // three bytes at 0x0010
+		0x00, 0x01, 0x12, 0x34, 0xB1,              // one byte at 0x1234
+		0x80, 0x01, 0xE6, 0x00, 0x00,              // terminator
+		0xFF, 0xFF                                 // unused EEPROM
+	};
+	I2CRecordIter iter;
+	I2CRecord record;
+	ASSERT_EQ(I2C_SUCCESS, i2cIterInit(&iter, image, sizeof(image), NULL));
+	ASSERT_EQ(VID, iter.vid);
+	ASSERT_EQ(PID, iter.pid);
+	ASSERT_EQ(DID, iter.did);
+	ASSERT_EQ(CONFIG_BYTE_400KHZ, iter.configByte);
+	ASSERT_EQ(2UL, iter.numRecords);
+	ASSERT_TRUE(iter.hasTerminator);
+	ASSERT_EQ(0xE600, iter.terminator.address);
+	ASSERT_EQ(image + 25, iter.trailing);
+	ASSERT_EQ(2UL, iter.trailingLength);
+	ASSERT_TRUE(i2cIterNext(&iter, &record));
+	ASSERT_EQ(0x0010, record.address);
+	ASSERT_EQ(3, record.length);
+	ASSERT_EQ(image + 12, record.data);
+	ASSERT_TRUE(i2cIterNext(&iter, &record));
+	ASSERT_EQ(0x1234, record.address);
+	ASSERT_EQ(1, record.length);
+	ASSERT_EQ(0xB1, record.data[0]);
+	ASSERT_FALSE(i2cIterNext(&iter, &record));
+	ASSERT_EQ(I2C_NOT_INITIALISED, i2cIterInit(&iter, image, 19, NULL));  // mid-payload
+	ASSERT_EQ(I2C_NOT_INITIALISED, i2cIterInit(&iter, image, 17, NULL));  // mid-header
+}
+
+static size_t encodedSize(const uint8 *mask, size_t length, I2CSegmentation strategy) {
+	Buffer i2cBuffer, data, maskBuf;
+	size_t result;
+	EXPECT_EQ(BUF_SUCCESS, bufInitialise(&i2cBuffer, 1024, 0x00, NULL));
+	EXPECT_EQ(BUF_SUCCESS, bufInitialise(&data, length, 0x00, NULL));
+	EXPECT_EQ(BUF_SUCCESS, bufInitialise(&maskBuf, length, 0x00, NULL));
+	EXPECT_EQ(BUF_SUCCESS, bufAppendConst(&data, 0xA5, length, NULL));
+	EXPECT_EQ(BUF_SUCCESS, bufAppendBlock(&maskBuf, mask, length, NULL));
+	i2cInitialise(&i2cBuffer, VID, PID, DID, CONFIG_BYTE_400KHZ);
+	EXPECT_EQ(I2C_SUCCESS, i2cWritePromRecordsEx(&i2cBuffer, &data, &maskBuf, strategy, NULL));
+	result = i2cBuffer.length - 8;
+	bufDestroy(&maskBuf);
+	bufDestroy(&data);
+	bufDestroy(&i2cBuffer);
+	return result;
+}
+
+TEST(I2C, testSegmentation) {
+	uint8 mask[1031] = {0};
+	size_t i;
+
+	// A full record, three holes, then five bytes: the default splits at 1023 and drags the holes
+	// into the second record, but the holes can be left out entirely
+	for ( i = 0; i < 1023; i++ ) {
+		mask[i] = 0x01;
+	}
+	for ( i = 1026; i < 1031; i++ ) {
+		mask[i] = 0x01;
+	}
+	ASSERT_EQ(4UL+1023UL+4UL+8UL, encodedSize(mask, 1031, I2C_SEG_DEFAULT));
+	ASSERT_EQ(4UL+1023UL+4UL+5UL, encodedSize(mask, 1031, I2C_SEG_MIN_BYTES));
+	ASSERT_EQ(4UL+1023UL+4UL+5UL, encodedSize(mask, 1031, I2C_SEG_MIN_RECORDS));
+
+	// Three isolated bytes: three records is smallest, but one record will do
+	for ( i = 0; i < 1031; i++ ) {
+		mask[i] = (uint8)(i % 100 == 0 && i <= 200);
+	}
+	ASSERT_EQ(3UL*5UL, encodedSize(mask, 1031, I2C_SEG_MIN_BYTES));
+	ASSERT_EQ(4UL+201UL, encodedSize(mask, 1031, I2C_SEG_MIN_RECORDS));
+}
+
+TEST(I2C, testBootEstimate) {
+	const uint8 image[] = {
+		0xC2, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, CONFIG_BYTE_400KHZ,
+		0x00, 0x02, 0x00, 0x00, 0x12, 0x34,  // two bytes at 0x0000
+		0x80, 0x01, 0xE6, 0x00, 0x00         // terminator
+	};
+	I2CBootModel model;
+	uint64 bootNs;
+	i2cDefaultBootModel(&model);
+	model.startupNs = 1000;
+	ASSERT_EQ(I2C_SUCCESS, i2cEstimateBootTime(&model, image, sizeof(image), &bootNs, NULL));
+	ASSERT_EQ(1000 + 12*model.byteNs100k + 11*model.byteNs400k + 2*model.recordNs, bootNs);
+	ASSERT_EQ(I2C_NOT_INITIALISED, i2cEstimateBootTime(&model, image, 14, &bootNs, NULL));
+}
+
+TEST(I2C, testMappedConversion) {
+	Buffer bix, mask, i2cBuffer, readBack;
+	size_t i;
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&bix, 3000, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&mask, 3000, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&i2cBuffer, 1024, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&readBack, 1024, 0x00, NULL));
+	for ( i = 0; i < 3000; i++ ) {
+		ASSERT_EQ(BUF_SUCCESS, bufAppendByte(&bix, (uint8)(i * 13), NULL));
+	}
+	ASSERT_EQ(BUF_SUCCESS, bufAppendConst(&mask, 0x01, 3000, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufWriteBinaryFile(&bix, "testMapped.bix", 0, 3000, NULL));
+
+	// Encoding the mapped file should match the Buffer-based encoder exactly
+	ASSERT_EQ(I2C_SUCCESS, i2cConvertBixToIic("testMapped.bix", "testMapped.iic", CONFIG_BYTE_400KHZ, NULL));
+	i2cInitialise(&i2cBuffer, 0x0000, 0x0000, 0x0000, CONFIG_BYTE_400KHZ);
+	ASSERT_EQ(I2C_SUCCESS, i2cWritePromRecords(&i2cBuffer, &bix, &mask, NULL));
+	ASSERT_EQ(I2C_SUCCESS, i2cFinalise(&i2cBuffer, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufAppendFromBinaryFile(&readBack, "testMapped.iic", NULL));
+	ASSERT_EQ(i2cBuffer.length, readBack.length);
+	ASSERT_EQ(0, std::memcmp(i2cBuffer.data, readBack.data, readBack.length));
+
+	// ...and decoding it again should give back the original
+	ASSERT_EQ(I2C_SUCCESS, i2cConvertIicToBix("testMapped.iic", "testMapped2.bix", NULL));
+	readBack.length = 0;
+	ASSERT_EQ(BUF_SUCCESS, bufAppendFromBinaryFile(&readBack, "testMapped2.bix", NULL));
+	ASSERT_EQ(3000UL, readBack.length);
+	ASSERT_EQ(0, std::memcmp(bix.data, readBack.data, 3000));
+	ASSERT_EQ(I2C_FILE_ERROR, i2cConvertIicToBix("testMapped.missing", "testMapped2.bix", NULL));
+
+	std::remove("testMapped.bix");
+	std::remove("testMapped.iic");
+	std::remove("testMapped2.bix");
+	bufDestroy(&readBack);
+	bufDestroy(&i2cBuffer);
+	bufDestroy(&mask);
+	bufDestroy(&bix);
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+
+namespace {
+	struct Watcher {
+		std::vector<struct FX2Progress> reports;
+		struct FX2CancelToken *cancel;
+		uint32 cancelAfter;  // bytes
+	};
+
+	void onProgress(const struct FX2Progress *progress, void *context) {
+		Watcher *const watcher = (Watcher *)context;
+		watcher->reports.push_back(*progress);
+		if ( watcher->cancel && progress->bytesDone >= watcher->cancelAfter ) {
+			fx2CancelRequest(watcher->cancel);
+		}
+	}
+}
+
+TEST(Progress, testWriteEEPROM) {
+	struct FX2Sim *sim;
+	std::vector<uint8> image(16384, 0x42);
+	Watcher watcher = {{}, NULL, 0};
+	struct FX2Monitor monitor = {onProgress, &watcher, NULL, 0};
+	uint32 bytesDone = 0;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(NULL, &sim, NULL));
+	ASSERT_EQ(
+		FX2_SUCCESS,
+		fx2WriteEEPROMEx(
+			fx2SimDevice(sim), image.data(), (uint32)image.size(), &monitor, &bytesDone, NULL));
+	ASSERT_EQ(image.size(), bytesDone);
+	ASSERT_EQ(4U, watcher.reports.size());
+	for ( size_t i = 0; i < watcher.reports.size(); i++ ) {
+		ASSERT_EQ(4096U * (i + 1), watcher.reports[i].bytesDone);
+		ASSERT_EQ(image.size(), watcher.reports[i].bytesTotal);
+		ASSERT_GE(watcher.reports[i].bytesPerSecond, 0.0);
+	}
+	ASSERT_EQ(0.0, watcher.reports.back().secondsLeft);
+	fx2SimDestroy(sim);
+}
+
+TEST(Progress, testCancel) {
+	struct FX2Sim *sim;
+	struct FX2CancelToken *token;
+	struct Buffer readBack;
+	std::vector<uint8> image(16384, 0x42);
+	Watcher watcher = {{}, NULL, 8192};
+	struct FX2Monitor monitor = {onProgress, &watcher, NULL, 0};
+	uint32 bytesDone = 0;
+	const char *error = NULL;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(NULL, &sim, NULL));
+	ASSERT_EQ(FX2_SUCCESS, fx2CancelCreate(&token, NULL));
+	watcher.cancel = token;
+	monitor.cancel = token;
+
+	// The write stops at the first chunk boundary after the request, and says exactly where
+	ASSERT_EQ(
+		FX2_CANCELLED,
+		fx2WriteEEPROMEx(
+			fx2SimDevice(sim), image.data(), (uint32)image.size(), &monitor, &bytesDone, &error));
+	ASSERT_STREQ("fx2WriteEEPROMEx(): Cancelled after 8192 of 16384 bytes", error);
+	fx2FreeError(error);
+	ASSERT_EQ(8192U, bytesDone);
+	const uint8 *const eeprom = fx2SimEEPROM(sim, NULL);
+	ASSERT_EQ(0, std::memcmp(image.data(), eeprom, 8192));
+	ASSERT_EQ(0xFF, eeprom[8192]);
+
+	// A cancelled read only keeps what it read
+	fx2CancelReset(token);
+	watcher.cancelAfter = 4096;
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&readBack, 1024, 0x00, NULL));
+	ASSERT_EQ(
+		FX2_CANCELLED,
+		fx2ReadEEPROMEx(fx2SimDevice(sim), 16384, &readBack, &monitor, &bytesDone, NULL));
+	ASSERT_EQ(4096U, bytesDone);
+	ASSERT_EQ(4096U, readBack.length);
+	bufDestroy(&readBack);
+
+	// A token which is already cancelled stops the operation before anything is written
+	ASSERT_TRUE(fx2CancelRequested(token));
+	ASSERT_EQ(
+		FX2_CANCELLED,
+		fx2WriteRAMEx(fx2SimDevice(sim), image.data(), 4096, &monitor, &bytesDone, NULL));
+	ASSERT_EQ(0U, bytesDone);
+	fx2CancelFree(token);
+	fx2SimDestroy(sim);
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include "../src/scan.h"
+
+TEST(Scan, testFindRuns) {
+	uint8 buf[100] = {0};
+	size_t i;
+	ASSERT_EQ(100UL, scanFindNonZero(buf, 0, 100));
+	ASSERT_EQ(0UL, scanFindZero(buf, 0, 100));
+	for ( i = 0; i < 100; i++ ) {
+		buf[i] = 0x01;
+		ASSERT_EQ(i, scanFindNonZero(buf, 0, 100));
+		ASSERT_EQ(i, scanFindNonZero(buf, i, 100));
+		ASSERT_EQ(100UL, scanFindNonZero(buf, i + 1, 100));
+		buf[i] = 0x00;
+	}
+	for ( i = 0; i < 100; i++ ) {
+		buf[i] = 0xFF;
+	}
+	ASSERT_EQ(100UL, scanFindZero(buf, 3, 100));
+	for ( i = 0; i < 100; i++ ) {
+		buf[i] = 0x00;
+		ASSERT_EQ(i, scanFindZero(buf, 0, 100));
+		ASSERT_EQ(i, scanFindZero(buf, i, 100));
+		ASSERT_EQ(100UL, scanFindZero(buf, i + 1, 100));
+		buf[i] = 0x80;
+	}
+}
+
+TEST(Scan, testMaskedCopy) {
+	uint8 src[77], mask[77], dst[77];
+	size_t i;
+	for ( i = 0; i < 77; i++ ) {
+		src[i] = (uint8)(i + 1);
+		mask[i] = (uint8)((i % 3) ? 0x01 : 0x00);
+	}
+	scanMaskedCopy(dst, src, mask, 77);
+	for ( i = 0; i < 77; i++ ) {
+		ASSERT_EQ((i % 3) ? (uint8)(i + 1) : 0x00, dst[i]);
+	}
+	scanMaskedCopy(src, src, mask, 77);
+	ASSERT_EQ(0, std::memcmp(src, dst, 77));
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+#include "vendorCommands.h"
+#include "transport.h"
+
+TEST(Sim, testRenumeration) {
+	struct FX2SimConfig config;
+	struct FX2Sim *sim;
+	struct FX2SimStats stats;
+	uint8 firmware[100], response[8];
+	fx2SimDefaultConfig(&config);
+	config.firmwareRunning = false;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(&config, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+
+	// A blank board only understands 0xA0
+	ASSERT_NE(USB_SUCCESS, devControlRead(device, CMD_CALCULATOR, 7, 2, response, 8, 5000, NULL));
+
+	for ( uint32 i = 0; i < sizeof(firmware); i++ ) {
+		firmware[i] = (uint8)(i * 3);
+	}
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteRAM(device, firmware, sizeof(firmware), NULL));
+	ASSERT_EQ(0, std::memcmp(firmware, fx2SimRAM(sim), sizeof(firmware)));
+	fx2SimGetStats(sim, &stats);
+	ASSERT_EQ(1U, stats.numRenumerations);
+	ASSERT_GE(stats.elapsedNs, (uint64)config.timing.renumerateNs);
+
+	// Now the firmware is running
+	ASSERT_EQ(USB_SUCCESS, devControlRead(device, CMD_CALCULATOR, 7, 2, response, 8, 5000, NULL));
+	ASSERT_EQ(9, response[0] | (response[1] << 8));
+	ASSERT_EQ(5, response[2] | (response[3] << 8));
+	ASSERT_EQ(14, response[4] | (response[5] << 8));
+	ASSERT_EQ(3, response[6] | (response[7] << 8));
+	fx2SimDestroy(sim);
+}
+
+TEST(Sim, testEEPROM) {
+	struct FX2Sim *sim;
+	struct FX2SimStats stats;
+	struct Buffer readBack;
+	uint8 image[1000], current[1000];
+	uint32 bytesWritten;
+	bool isMatch;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(NULL, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+	for ( uint32 i = 0; i < sizeof(image); i++ ) {
+		image[i] = (uint8)(i ^ 0x5A);
+	}
+
+	// Every page is written with exactly one write cycle
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteEEPROM(device, image, sizeof(image), NULL));
+	fx2SimGetStats(sim, &stats);
+	ASSERT_EQ(16U, stats.numPageWrites);
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&readBack, 1024, 0x00, NULL));
+	ASSERT_EQ(FX2_SUCCESS, fx2ReadEEPROM(device, sizeof(image), &readBack, NULL));
+	ASSERT_EQ(0, std::memcmp(image, readBack.data, sizeof(image)));
+	ASSERT_EQ(FX2_SUCCESS, fx2VerifyEEPROM(device, image, sizeof(image), &isMatch, NULL));
+	ASSERT_TRUE(isMatch);
+	bufDestroy(&readBack);
+
+	// A one-byte change rewrites one page
+	std::memcpy(current, image, sizeof(image));
+	image[500] ^= 0xFF;
+	fx2SimResetStats(sim);
+	ASSERT_EQ(
+		FX2_SUCCESS,
+		fx2WriteEEPROMDiff(device, image, sizeof(image), current, 0, &bytesWritten, NULL));
+	fx2SimGetStats(sim, &stats);
+	ASSERT_EQ(64U, bytesWritten);
+	ASSERT_EQ(1U, stats.numPageWrites);
+	ASSERT_EQ(0, std::memcmp(image, fx2SimEEPROM(sim, NULL), sizeof(image)));
+	fx2SimDestroy(sim);
+}
+
+TEST(Sim, testCrcFallback) {
+	// The simulated firmware can't calculate CRCs, so they are read back, which only works for
+	// ranges starting at the beginning of the EEPROM
+	struct FX2Sim *sim;
+	uint8 image[1000];
+	uint32 crc = 0;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(NULL, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+	for ( uint32 i = 0; i < sizeof(image); i++ ) {
+		image[i] = (uint8)(i * 13);
+	}
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteEEPROM(device, image, sizeof(image), NULL));
+	ASSERT_EQ(FX2_SUCCESS, fx2CrcEEPROM(device, 0, sizeof(image), &crc, NULL));
+	ASSERT_EQ(fx2Crc32(0, image, sizeof(image)), crc);
+	ASSERT_EQ(FX2_USB_ERR, fx2CrcEEPROM(device, 16, sizeof(image) - 16, &crc, NULL));
+	fx2SimDestroy(sim);
+}
+
+TEST(Sim, testPageWrap) {
+	struct FX2SimConfig config;
+	struct FX2Sim *sim;
+	uint8 image[64];
+	fx2SimDefaultConfig(&config);
+	config.eepromPageSize = 32;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(&config, &sim, NULL));
+	for ( uint32 i = 0; i < sizeof(image); i++ ) {
+		image[i] = (uint8)i;
+	}
+
+	// The firmware assumes 64-byte pages, so the second half overwrites the first
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteEEPROM(fx2SimDevice(sim), image, sizeof(image), NULL));
+	ASSERT_EQ(0, std::memcmp(image + 32, fx2SimEEPROM(sim, NULL), 32));
+
+	// Telling the firmware the real page size fixes it
+	ASSERT_EQ(FX2_SUCCESS, fx2SetEEPROMPageSize(fx2SimDevice(sim), 32, NULL));
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteEEPROM(fx2SimDevice(sim), image, sizeof(image), NULL));
+	ASSERT_EQ(0, std::memcmp(image, fx2SimEEPROM(sim, NULL), sizeof(image)));
+	fx2SimDestroy(sim);
+}
+
+TEST(Sim, testReadInto) {
+	struct FX2Sim *sim;
+	struct Buffer readBack;
+	uint8 image[1000], arena[1100];
+	uint32 bytesDone = 0;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(NULL, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+	for ( uint32 i = 0; i < sizeof(image); i++ ) {
+		image[i] = (uint8)(i * 7);
+	}
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteEEPROM(device, image, sizeof(image), NULL));
+
+	// Exactly the requested bytes are written, and nothing around them
+	std::memset(arena, 0xAA, sizeof(arena));
+	ASSERT_EQ(
+		FX2_SUCCESS,
+		fx2ReadEEPROMInto(device, arena + 50, sizeof(image), NULL, &bytesDone, NULL));
+	ASSERT_EQ(sizeof(image), bytesDone);
+	ASSERT_EQ(0, std::memcmp(image, arena + 50, sizeof(image)));
+	ASSERT_EQ(0xAA, arena[49]);
+	ASSERT_EQ(0xAA, arena[50 + sizeof(image)]);
+	std::memset(arena, 0xAA, sizeof(arena));
+	ASSERT_EQ(FX2_SUCCESS, fx2ReadEEPROMBulkInto(device, arena, sizeof(image), NULL));
+	ASSERT_EQ(0, std::memcmp(image, arena, sizeof(image)));
+
+	// The Buffer wrappers append after what is already there
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&readBack, 16, 0x00, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufAppendByte(&readBack, 0x55, NULL));
+	ASSERT_EQ(FX2_SUCCESS, fx2ReadEEPROMBulk(device, sizeof(image), &readBack, NULL));
+	ASSERT_EQ(1 + sizeof(image), readBack.length);
+	ASSERT_EQ(0x55, readBack.data[0]);
+	ASSERT_EQ(0, std::memcmp(image, readBack.data + 1, sizeof(image)));
+
+	// A failed read leaves the length alone and the spare capacity full of the fill byte, even if
+	// the failed chunk delivered some bytes (the sim can't fail part-way, so plant them)
+	const uint8 reset = 0x01;
+	const size_t length = readBack.length;
+	ASSERT_EQ(
+		USB_SUCCESS, devControlWrite(device, CMD_READ_WRITE_RAM, 0xE600, 0x0000, &reset, 1, 5000, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufAppendConst(&readBack, 0x00, sizeof(image), NULL));
+	readBack.length = length;
+	std::memset(readBack.data + length, 0xEE, sizeof(image));
+	ASSERT_EQ(FX2_USB_ERR, fx2ReadEEPROMEx(device, sizeof(image), &readBack, NULL, &bytesDone, NULL));
+	ASSERT_EQ(0U, bytesDone);
+	ASSERT_EQ(length, readBack.length);
+	for ( uint32 i = 0; i < sizeof(image); i++ ) {
+		ASSERT_EQ(0x00, readBack.data[length + i]);
+	}
+	std::memset(readBack.data + length, 0xEE, sizeof(image));
+	ASSERT_EQ(FX2_USB_ERR, fx2ReadEEPROMBulk(device, sizeof(image), &readBack, NULL));
+	ASSERT_EQ(length, readBack.length);
+	for ( uint32 i = 0; i < sizeof(image); i++ ) {
+		ASSERT_EQ(0x00, readBack.data[length + i]);
+	}
+	bufDestroy(&readBack);
+	fx2SimDestroy(sim);
+}
+
+TEST(Sim, testWriteRAMSparse) {
+	struct FX2Sim *sim;
+	struct FX2SimStats stats;
+	const char *error = NULL;
+	uint8 image[0x2000], mask[0x2000];
+	for ( uint32 i = 0; i < sizeof(image); i++ ) {
+		image[i] = (uint8)(i * 5 + 1);
+	}
+	std::memset(mask, 0x00, sizeof(mask));
+	std::memset(mask, 0x01, 0x100);
+	std::memset(mask + 0x180, 0x01, 0x80);   // a short gap, uploaded as filler
+	std::memset(mask + 0x1F00, 0x01, 0x40);  // far away
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(NULL, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+
+	// Only the two runs go over the wire, besides the two CPUCS writes
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteRAMMasked(device, image, mask, sizeof(image), NULL));
+	fx2SimGetStats(sim, &stats);
+	ASSERT_EQ(4U, stats.numTransfers);
+	ASSERT_EQ(0x200U + 0x40U + 2U, stats.numBytes);
+	ASSERT_EQ(0, std::memcmp(image, fx2SimRAM(sim), 0x200));
+	ASSERT_EQ(0, std::memcmp(image + 0x1F00, fx2SimRAM(sim) + 0x1F00, 0x40));
+	ASSERT_EQ(0x00, fx2SimRAM(sim)[0x1000]);
+
+	// Segments may come in any order, and each is uploaded from where it lies
+	const struct FX2Segment segments[] = {
+		{0x3000, image + 0x10, 0x20},
+		{0x1000, image + 0x50, 0x30},
+		{0x1040, image + 0x90, 0x10}
+	};
+	fx2SimResetStats(sim);
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteRAMSegments(device, segments, 3, NULL));
+	fx2SimGetStats(sim, &stats);
+	ASSERT_EQ(4U, stats.numTransfers);
+	ASSERT_EQ(0, std::memcmp(image + 0x10, fx2SimRAM(sim) + 0x3000, 0x20));
+	ASSERT_EQ(0, std::memcmp(image + 0x50, fx2SimRAM(sim) + 0x1000, 0x30));
+	ASSERT_EQ(0x00, fx2SimRAM(sim)[0x1030]);
+	ASSERT_EQ(0, std::memcmp(image + 0x90, fx2SimRAM(sim) + 0x1040, 0x10));
+
+	// Overlapping segments are refused before anything is written
+	const struct FX2Segment overlapping[] = {{0x1000, image, 0x20}, {0x1010, image, 0x20}};
+	fx2SimResetStats(sim);
+	ASSERT_EQ(FX2_BUF_ERR, fx2WriteRAMSegments(device, overlapping, 2, &error));
+	ASSERT_STREQ(
+		"fx2WriteRAMSegments(): The segment at 0x1010 overlaps another or extends beyond 64KiB",
+		error);
+	fx2FreeError(error);
+	fx2SimGetStats(sim, &stats);
+	ASSERT_EQ(0U, stats.numTransfers);
+	fx2SimDestroy(sim);
+}
+
+TEST(Sim, testAwaitRenumeration) {
+	struct FX2SimConfig config;
+	struct FX2Sim *sim;
+	uint8 firmware[16] = {0x02}, response[8];
+	fx2SimDefaultConfig(&config);
+	config.firmwareRunning = false;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(&config, &sim, NULL));
+	struct USBDevice *device = fx2SimDevice(sim);
+	ASSERT_EQ(FX2_SUCCESS, fx2StatsEnable(device, NULL));
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteRAM(device, firmware, sizeof(firmware), NULL));
+
+	// The simulation has already renumerated, so its handle is kept and ready to use
+	ASSERT_EQ(FX2_SUCCESS, fx2AwaitRenumeration(&device, "1d50:602b", 1000, NULL));
+	ASSERT_EQ(fx2SimDevice(sim), device);
+	ASSERT_EQ(USB_SUCCESS, devControlRead(device, CMD_CALCULATOR, 7, 2, response, 8, 5000, NULL));
+	struct FX2Stats stats;
+	ASSERT_TRUE(fx2StatsGet(device, &stats));
+	ASSERT_EQ(1U, stats.ops[FX2_STATS_WRITE_RAM].numOps);
+	fx2StatsDisable(device);
+	fx2SimDestroy(sim);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libfx2loader.h>
+
+static uint64 histogramTotal(const struct FX2OpStats *op) {
+	uint64 total = 0;
+	for ( int i = 0; i < FX2_STATS_BUCKETS; i++ ) {
+		total += op->histogram[i];
+	}
+	return total;
+}
+
+TEST(Stats, testPerOperation) {
+	struct FX2Sim *sim;
+	struct FX2Stats stats;
+	uint8 image[1000];
+	bool isMatch;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(NULL, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+	std::memset(image, 0x5A, sizeof(image));
+
+	// Nothing is kept until asked for
+	ASSERT_FALSE(fx2StatsGet(device, &stats));
+	ASSERT_EQ(FX2_SUCCESS, fx2StatsEnable(device, NULL));
+	ASSERT_TRUE(fx2StatsGet(device, &stats));
+	ASSERT_EQ(0U, stats.ops[FX2_STATS_WRITE_EEPROM].numOps);
+
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteEEPROM(device, image, sizeof(image), NULL));
+	ASSERT_TRUE(fx2StatsGet(device, &stats));
+	const struct FX2OpStats *const write = stats.ops + FX2_STATS_WRITE_EEPROM;
+	ASSERT_EQ(1U, write->numOps);
+	ASSERT_EQ(0U, write->numFailed);
+	ASSERT_EQ(1U, write->numTransfers);
+	ASSERT_EQ(sizeof(image), write->numBytes);
+	ASSERT_EQ(write->numTransfers, histogramTotal(write));
+	ASSERT_LE(write->maxTransferNs, write->transferNs);
+	ASSERT_LE(write->transferNs, write->opNs);
+
+	// The verify falls back to reading the EEPROM back, but is still counted as one verify
+	ASSERT_EQ(FX2_SUCCESS, fx2VerifyEEPROM(device, image, sizeof(image), &isMatch, NULL));
+	ASSERT_TRUE(isMatch);
+	ASSERT_TRUE(fx2StatsGet(device, &stats));
+	ASSERT_EQ(1U, stats.ops[FX2_STATS_VERIFY_EEPROM].numOps);
+	ASSERT_EQ(sizeof(image) + 2*4, stats.ops[FX2_STATS_VERIFY_EEPROM].numBytes);  // two config queries
+	ASSERT_EQ(0U, stats.ops[FX2_STATS_READ_EEPROM].numOps);
+
+	// A stalled request outside any operation
+	ASSERT_NE(FX2_SUCCESS, fx2SetEEPROMPageSize(device, 3, NULL));
+	ASSERT_TRUE(fx2StatsGet(device, &stats));
+	ASSERT_EQ(1U, stats.ops[FX2_STATS_OTHER].numErrors);
+
+	fx2StatsReset(device);
+	ASSERT_TRUE(fx2StatsGet(device, &stats));
+	ASSERT_EQ(0U, stats.ops[FX2_STATS_WRITE_EEPROM].numOps);
+	fx2StatsDisable(device);
+	ASSERT_FALSE(fx2StatsGet(device, &stats));
+	fx2SimDestroy(sim);
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <vector>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include <makestuff/libbuffer.h>
+#include <makestuff/libfx2loader.h>
+#include "vendorCommands.h"
+#include "transport.h"
+
+namespace {
+	void countChunk(const struct FX2Progress *, void *context) {
+		++*(uint32 *)context;
+	}
+}
+
+TEST(Tune, testFixed) {
+	struct FX2Sim *sim;
+	struct FX2TransferTuning tuning;
+	std::vector<uint8> image(16384, 0x42);
+	uint32 numChunks = 0;
+	struct FX2Monitor monitor = {countChunk, &numChunks, NULL, 0};
+	struct FX2TransferConfig config = {1024, 2000};
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(NULL, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+
+	// Without a configuration, the defaults
+	ASSERT_FALSE(fx2GetTransferTuning(device, FX2_TRANSFER_EEPROM_WRITE, &tuning));
+	ASSERT_EQ(4096U, tuning.chunkSize);
+	ASSERT_EQ(5000U, tuning.timeout);
+
+	ASSERT_EQ(FX2_SUCCESS, fx2SetTransferConfig(device, &config, NULL));
+	ASSERT_EQ(
+		FX2_SUCCESS,
+		fx2WriteEEPROMEx(device, image.data(), (uint32)image.size(), &monitor, NULL, NULL));
+	ASSERT_EQ(16U, numChunks);
+	ASSERT_EQ(0, std::memcmp(image.data(), fx2SimEEPROM(sim, NULL), image.size()));
+	ASSERT_TRUE(fx2GetTransferTuning(device, FX2_TRANSFER_EEPROM_WRITE, &tuning));
+	ASSERT_EQ(1024U, tuning.chunkSize);
+	ASSERT_EQ(2000U, tuning.timeout);
+
+	// No control transfer exceeds what usbfs accepts, and odd sizes round down
+	config.chunkSize = 12000;
+	ASSERT_EQ(FX2_SUCCESS, fx2SetTransferConfig(device, &config, NULL));
+	ASSERT_TRUE(fx2GetTransferTuning(device, FX2_TRANSFER_RAM, &tuning));
+	ASSERT_EQ(4096U, tuning.chunkSize);
+	ASSERT_TRUE(fx2GetTransferTuning(device, FX2_TRANSFER_EEPROM_READ, &tuning));
+	ASSERT_EQ(4096U, tuning.chunkSize);
+	config.chunkSize = 3000;
+	ASSERT_EQ(FX2_SUCCESS, fx2SetTransferConfig(device, &config, NULL));
+	ASSERT_TRUE(fx2GetTransferTuning(device, FX2_TRANSFER_EEPROM_READ, &tuning));
+	ASSERT_EQ(2048U, tuning.chunkSize);
+
+	fx2ClearTransferConfig(device);
+	ASSERT_FALSE(fx2GetTransferTuning(device, FX2_TRANSFER_EEPROM_READ, &tuning));
+	fx2SimDestroy(sim);
+}
+
+TEST(Tune, testAdaptive) {
+	// Each transfer really costs a millisecond and the bytes are almost free, so the tuner should
+	// try the smaller chunks and settle back on the largest
+	struct FX2SimConfig simConfig;
+	struct FX2Sim *sim;
+	struct FX2TransferTuning tuning;
+	struct Buffer readBack;
+	const struct FX2TransferConfig config = {0, 0};
+	uint32 numChunks = 0;
+	struct FX2Monitor monitor = {countChunk, &numChunks, NULL, 0};
+	fx2SimDefaultConfig(&simConfig);
+	simConfig.eepromSize = 0x20000;
+	simConfig.timing.transferNs = 1000000;
+	simConfig.timing.byteNs = 1;
+	simConfig.timing.i2cClockHz = 1000000000;
+	simConfig.timing.realTime = true;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(&simConfig, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+	ASSERT_EQ(FX2_SUCCESS, fx2SetTransferConfig(device, &config, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&readBack, 1024, 0x00, NULL));
+	ASSERT_EQ(FX2_SUCCESS, fx2ReadEEPROMEx(device, 0x20000, &readBack, &monitor, NULL, NULL));
+	ASSERT_EQ(0x20000U, readBack.length);
+	ASSERT_GT(numChunks, 0x20000U / 4096);  // some chunks were smaller
+	ASSERT_TRUE(fx2GetTransferTuning(device, FX2_TRANSFER_EEPROM_READ, &tuning));
+	ASSERT_EQ(4096U, tuning.chunkSize);
+	ASSERT_GT(tuning.bytesPerSecond, 0.0);
+	ASSERT_GE(tuning.timeout, 1000U);
+	ASSERT_LE(tuning.timeout, 60000U);
+
+	// Writes are tuned separately
+	ASSERT_TRUE(fx2GetTransferTuning(device, FX2_TRANSFER_EEPROM_WRITE, &tuning));
+	ASSERT_EQ(4096U, tuning.chunkSize);
+	ASSERT_EQ(0.0, tuning.bytesPerSecond);
+	bufDestroy(&readBack);
+	fx2ClearTransferConfig(device);
+	fx2SimDestroy(sim);
+}
+
+TEST(Tune, testStepDown) {
+	// A chunk which fails steps the size down from the default, and the tuner only goes back up
+	// once a later probe finds the larger size works again
+	struct FX2SimConfig simConfig;
+	struct FX2Sim *sim;
+	struct FX2TransferTuning tuning;
+	struct Buffer readBack;
+	const struct FX2TransferConfig config = {0, 0};
+	const uint8 reset = 0x01, firmware[16] = {0};
+	fx2SimDefaultConfig(&simConfig);
+	simConfig.eepromSize = 0x20000;
+	simConfig.timing.transferNs = 1000000;
+	simConfig.timing.byteNs = 1;
+	simConfig.timing.i2cClockHz = 1000000000;
+	simConfig.timing.renumerateNs = 0;
+	simConfig.timing.realTime = true;
+	ASSERT_EQ(FX2_SUCCESS, fx2SimCreate(&simConfig, &sim, NULL));
+	struct USBDevice *const device = fx2SimDevice(sim);
+	ASSERT_EQ(FX2_SUCCESS, fx2SetTransferConfig(device, &config, NULL));
+	ASSERT_EQ(BUF_SUCCESS, bufInitialise(&readBack, 1024, 0x00, NULL));
+
+	// With the 8051 in reset the firmware stalls every request
+	ASSERT_EQ(
+		USB_SUCCESS, devControlWrite(device, CMD_READ_WRITE_RAM, 0xE600, 0x0000, &reset, 1, 5000, NULL));
+	ASSERT_EQ(FX2_USB_ERR, fx2ReadEEPROM(device, 0x1000, &readBack, NULL));
+	ASSERT_TRUE(fx2GetTransferTuning(device, FX2_TRANSFER_EEPROM_READ, &tuning));
+	ASSERT_EQ(2048U, tuning.chunkSize);
+
+	// Once the firmware is running again, a long read probes 4096 bytes and returns to it
+	ASSERT_EQ(FX2_SUCCESS, fx2WriteRAM(device, firmware, sizeof(firmware), NULL));
+	ASSERT_EQ(FX2_SUCCESS, fx2ReadEEPROM(device, 0x20000, &readBack, NULL));
+	ASSERT_TRUE(fx2GetTransferTuning(device, FX2_TRANSFER_EEPROM_READ, &tuning));
+	ASSERT_EQ(4096U, tuning.chunkSize);
+	bufDestroy(&readBack);
+	fx2ClearTransferConfig(device);
+	fx2SimDestroy(sim);
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2009-2012 Chris McClelland
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstring>
+#include <gtest/gtest.h>
+#include <makestuff/common.h>
+#include "xfer.h"
+
+TEST(Xfer, testDirtyRuns) {
+	uint8 oldData[300], newData[300];
+	uint32 offset = 0, length;
+	std::memset(oldData, 0xFF, sizeof(oldData));
+	std::memcpy(newData, oldData, sizeof(newData));
+	ASSERT_FALSE(xferNextDirtyRun(newData, oldData, 300, 64, &offset, &length));
+
+	newData[70] = 0x00;   // page 1
+	newData[130] = 0x00;  // page 2, so coalesced with page 1
+	newData[299] = 0x00;  // short final page
+	offset = 0;
+	ASSERT_TRUE(xferNextDirtyRun(newData, oldData, 300, 64, &offset, &length));
+	ASSERT_EQ(64U, offset);
+	ASSERT_EQ(128U, length);
+	offset += length;
+	ASSERT_TRUE(xferNextDirtyRun(newData, oldData, 300, 64, &offset, &length));
+	ASSERT_EQ(256U, offset);
+	ASSERT_EQ(44U, length);
+	offset += length;
+	ASSERT_FALSE(xferNextDirtyRun(newData, oldData, 300, 64, &offset, &length));
+}
+
+TEST(Xfer, testMaskRuns) {
+	uint8 mask[100];
+	uint32 offset = 0, length;
+	std::memset(mask, 0x00, sizeof(mask));
+	ASSERT_FALSE(xferNextMaskRun(mask, 100, 8, &offset, &length));
+
+	std::memset(mask + 2, 0x01, 3);   // [2, 5)
+	std::memset(mask + 13, 0x01, 2);  // [13, 15): an 8-byte gap, so merged
+	std::memset(mask + 24, 0x01, 1);  // [24, 25): a 9-byte gap, so a new run
+	mask[99] = 0x01;
+	offset = 0;
+	ASSERT_TRUE(xferNextMaskRun(mask, 100, 8, &offset, &length));
+	ASSERT_EQ(2U, offset);
+	ASSERT_EQ(13U, length);
+	offset += length;
+	ASSERT_TRUE(xferNextMaskRun(mask, 100, 8, &offset, &length));
+	ASSERT_EQ(24U, offset);
+	ASSERT_EQ(1U, length);
+	offset += length;
+	ASSERT_TRUE(xferNextMaskRun(mask, 100, 8, &offset, &length));
+	ASSERT_EQ(99U, offset);
+	ASSERT_EQ(1U, length);
+	offset += length;
+	ASSERT_FALSE(xferNextMaskRun(mask, 100, 8, &offset, &length));
+}
+
+TEST(Xfer, testSegmentRuns) {
+	const uint8 bytes[16] = {0};
+	const struct FX2Segment segments[] = {
+		{0x0000, bytes, 3},
+		{0x0010, bytes, 0},   // empty, so ignored
+		{0x0100, bytes, 16},  // a long gap
+		{0x0110, bytes, 4},   // adjacent
+		{0x0120, bytes, 2}    // a short gap
+	};
+	struct XferRun run;
+	uint32 next = 0;
+	ASSERT_TRUE(xferNextSegmentRun(segments, 5, 64, &next, &run));
+	ASSERT_EQ(0x0000U, run.address);
+	ASSERT_EQ(3U, run.length);
+	ASSERT_EQ(0U, run.first);
+	ASSERT_TRUE(xferNextSegmentRun(segments, 5, 64, &next, &run));
+	ASSERT_EQ(0x0100U, run.address);
+	ASSERT_EQ(0x22U, run.length);
+	ASSERT_EQ(2U, run.first);
+	ASSERT_EQ(3U, run.count);
+	ASSERT_FALSE(xferNextSegmentRun(segments, 5, 64, &next, &run));
+}